@@ -1,6 +1,7 @@
 #version 450
 
 layout(location = 0) in vec2 fragOffset;
+layout(location = 1) flat in vec4 fragColor;
 layout(location = 3) in float visibility;
 
 layout(location = 0) out vec4 outColor;
@@ -31,12 +32,6 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	int numLights;
 } ubo;
 
-layout(push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main() {
@@ -45,7 +40,7 @@ void main() {
 		discard;
 	}
 	float cosDis = 0.5 * (cos(dis * M_PI) + 1.0);
-	outColor = vec4(push.color.xyz + cosDis, cosDis);
+	outColor = vec4(fragColor.xyz + cosDis, cosDis);
 
 	outColor = mix(ubo.fog.color, outColor, visibility);
 }
\ No newline at end of file
@@ -9,7 +9,12 @@ const vec2 OFFSETS[6] = vec2[](
   vec2(1.0, 1.0)
 );
 
+// one instance per light, position.w is the radius and color.w the intensity
+layout(location = 0) in vec4 lightPosition;
+layout(location = 1) in vec4 lightColor;
+
 layout(location = 0) out vec2 fragOffset;
+layout(location = 1) flat out vec4 fragColor;
 layout(location = 3) out float visibility;
 
 struct Fog {
@@ -39,20 +44,15 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	int numLights;
 } ubo;
 
-layout(push_constant) uniform Push {
-	vec4 position;
-	vec4 color;
-	float radius;
-} push;
-
 const float LIGHT_RADIUS = 0.05;
 
 void main() {
 	
 	fragOffset = OFFSETS[gl_VertexIndex];
+	fragColor = lightColor;
 	
-	vec4 lightInCameraSpace = ubo.view * vec4(push.position.xyz, 1.0);
-	vec4 positionInCameraSpace = lightInCameraSpace + push.radius * vec4(fragOffset, 0.0, 0.0);
+	vec4 lightInCameraSpace = ubo.view * vec4(lightPosition.xyz, 1.0);
+	vec4 positionInCameraSpace = lightInCameraSpace + lightPosition.w * vec4(fragOffset, 0.0, 0.0);
 
 	gl_Position = ubo.projection * positionInCameraSpace;
 
@@ -5,6 +5,10 @@ layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 
+// per instance, from the render system's instance buffer at binding 1
+layout(location = 4) in mat4 instanceModelMatrix;
+layout(location = 8) in mat4 instanceNormalMatrix;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
@@ -40,19 +44,14 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 
 layout(set = 0, binding = 1) uniform sampler2D tex;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-} push;
-
 void main() {
 
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	vec4 positionWorld = instanceModelMatrix * vec4(position, 1.0);
 	vec4 positionRelativeToCamera = ubo.view * positionWorld;
 
 	gl_Position = ubo.projection * (positionRelativeToCamera);
 
-	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	fragNormalWorld = normalize(mat3(instanceNormalMatrix) * normal);
 	fragPosWorld = positionWorld.xyz;
 	fragColor = color;
 
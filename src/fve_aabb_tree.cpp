@@ -0,0 +1,307 @@
+#include "fve_aabb_tree.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace fve {
+
+	FveAabbTree::FveAabbTree(float margin) : margin{ margin } {}
+
+	int32_t FveAabbTree::createProxy(const Aabb& aabb, uint32_t userData) {
+
+		int32_t proxyId = allocateNode();
+		nodes[proxyId].aabb = aabb.expanded(margin);
+		nodes[proxyId].userData = userData;
+		nodes[proxyId].height = 0;
+
+		insertLeaf(proxyId);
+		proxyCount++;
+		return proxyId;
+
+	}
+
+	void FveAabbTree::destroyProxy(int32_t proxyId) {
+
+		assert(nodes[proxyId].isLeaf() && nodes[proxyId].height == 0 && "Not a proxy");
+
+		removeLeaf(proxyId);
+		freeNode(proxyId);
+		proxyCount--;
+
+	}
+
+	bool FveAabbTree::moveProxy(int32_t proxyId, const Aabb& aabb) {
+
+		assert(nodes[proxyId].isLeaf() && nodes[proxyId].height == 0 && "Not a proxy");
+
+		// keep the fat box unless the object left it or shrank well inside it
+		const Aabb& fatAabb = nodes[proxyId].aabb;
+		if (fatAabb.contains(aabb) && aabb.expanded(4.0f * margin).contains(fatAabb)) {
+			return false;
+		}
+
+		removeLeaf(proxyId);
+		nodes[proxyId].aabb = aabb.expanded(margin);
+		insertLeaf(proxyId);
+		return true;
+
+	}
+
+	float FveAabbTree::getAreaRatio() const {
+
+		if (root == NULL_NODE) return 0.0f;
+
+		float totalArea = 0.0f;
+		for (const Node& node : nodes) {
+			if (node.height > 0) totalArea += node.aabb.surfaceArea();
+		}
+
+		float rootArea = nodes[root].aabb.surfaceArea();
+		return rootArea > 0.0f ? totalArea / rootArea : 0.0f;
+
+	}
+
+	void FveAabbTree::validate() const {
+
+		if (root == NULL_NODE) {
+			assert(proxyCount == 0);
+			return;
+		}
+
+		assert(nodes[root].parent == NULL_NODE);
+		[[maybe_unused]] int32_t leaves = validateSubtree(root);
+		assert(static_cast<size_t>(leaves) == proxyCount && "Proxy count does not match the tree");
+
+	}
+
+	int32_t FveAabbTree::validateSubtree(int32_t index) const {
+
+		const Node& node = nodes[index];
+		if (node.isLeaf()) {
+			assert(node.height == 0);
+			return 1;
+		}
+
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		assert(child1.parent == index && child2.parent == index && "Broken parent link");
+		assert(node.height == 1 + std::max(child1.height, child2.height) && "Stale height");
+		assert(node.aabb.contains(child1.aabb) && node.aabb.contains(child2.aabb) && "Node does not bound its children");
+
+		return validateSubtree(node.child1) + validateSubtree(node.child2);
+
+	}
+
+	int32_t FveAabbTree::allocateNode() {
+
+		if (freeList == NULL_NODE) {
+			nodes.emplace_back();
+			return static_cast<int32_t>(nodes.size() - 1);
+		}
+
+		int32_t index = freeList;
+		freeList = nodes[index].parent;
+		nodes[index] = Node{};
+		return index;
+
+	}
+
+	void FveAabbTree::freeNode(int32_t index) {
+		nodes[index].parent = freeList;
+		nodes[index].child1 = NULL_NODE;
+		nodes[index].child2 = NULL_NODE;
+		nodes[index].height = -1;
+		freeList = index;
+	}
+
+	int32_t FveAabbTree::findBestSibling(const Aabb& box) const {
+
+		// greedy SAH descent: stop where pairing with the node is cheaper than any child could be
+		int32_t index = root;
+		while (!nodes[index].isLeaf()) {
+			const Node& node = nodes[index];
+
+			float area = node.aabb.surfaceArea();
+			float combinedArea = Aabb::merge(node.aabb, box).surfaceArea();
+
+			// a new parent for this node and the leaf
+			float cost = 2.0f * combinedArea;
+
+			// every ancestor below here grows by at least this much
+			float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto descendCost = [&](int32_t child) {
+				const Node& childNode = nodes[child];
+				float mergedArea = Aabb::merge(box, childNode.aabb).surfaceArea();
+				if (childNode.isLeaf()) return mergedArea + inheritanceCost;
+				return mergedArea - childNode.aabb.surfaceArea() + inheritanceCost;
+			};
+
+			float cost1 = descendCost(node.child1);
+			float cost2 = descendCost(node.child2);
+
+			if (cost < cost1 && cost < cost2) break;
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+		return index;
+
+	}
+
+	void FveAabbTree::insertLeaf(int32_t leaf) {
+
+		if (root == NULL_NODE) {
+			root = leaf;
+			nodes[root].parent = NULL_NODE;
+			return;
+		}
+
+		int32_t sibling = findBestSibling(nodes[leaf].aabb);
+
+		// may grow the node array, so only indices from here on
+		int32_t newParent = allocateNode();
+		int32_t oldParent = nodes[sibling].parent;
+
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE) {
+			root = newParent;
+		}
+		else if (nodes[oldParent].child1 == sibling) {
+			nodes[oldParent].child1 = newParent;
+		}
+		else {
+			nodes[oldParent].child2 = newParent;
+		}
+
+		refitAncestors(newParent);
+
+	}
+
+	void FveAabbTree::removeLeaf(int32_t leaf) {
+
+		if (leaf == root) {
+			root = NULL_NODE;
+			return;
+		}
+
+		int32_t parent = nodes[leaf].parent;
+		int32_t grandParent = nodes[parent].parent;
+		int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		// the sibling takes the parent's place
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		if (grandParent == NULL_NODE) {
+			root = sibling;
+			return;
+		}
+
+		if (nodes[grandParent].child1 == parent) {
+			nodes[grandParent].child1 = sibling;
+		}
+		else {
+			nodes[grandParent].child2 = sibling;
+		}
+
+		refitAncestors(grandParent);
+
+	}
+
+	void FveAabbTree::refitAncestors(int32_t index) {
+		while (index != NULL_NODE) {
+			refit(index);
+			rotate(index);
+			index = nodes[index].parent;
+		}
+	}
+
+	void FveAabbTree::refit(int32_t index) {
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.aabb = Aabb::merge(child1.aabb, child2.aabb);
+		node.height = 1 + std::max(child1.height, child2.height);
+	}
+
+	void FveAabbTree::rotate(int32_t index) {
+
+		// A with children B and C, grandchildren D, E under B and F, G under C. A swap between a
+		// child and a grandchild, or between two grandchildren, leaves A's box alone but changes the
+		// boxes of B and/or C; take the swap that shrinks their surface area the most
+		const Node& a = nodes[index];
+		if (a.height < 2) return;
+
+		int32_t b = a.child1;
+		int32_t c = a.child2;
+		const Node& nodeB = nodes[b];
+		const Node& nodeC = nodes[c];
+
+		int32_t swapA = NULL_NODE;
+		int32_t swapB = NULL_NODE;
+		float bestGain = 0.0f;
+
+		auto consider = [&](float gain, int32_t first, int32_t second) {
+			if (gain > bestGain) {
+				bestGain = gain;
+				swapA = first;
+				swapB = second;
+			}
+		};
+
+		auto mergedArea = [&](int32_t first, int32_t second) {
+			return Aabb::merge(nodes[first].aabb, nodes[second].aabb).surfaceArea();
+		};
+
+		if (!nodeC.isLeaf()) {
+			float areaC = nodeC.aabb.surfaceArea();
+			consider(areaC - mergedArea(b, nodeC.child2), b, nodeC.child1);
+			consider(areaC - mergedArea(b, nodeC.child1), b, nodeC.child2);
+		}
+
+		if (!nodeB.isLeaf()) {
+			float areaB = nodeB.aabb.surfaceArea();
+			consider(areaB - mergedArea(c, nodeB.child2), c, nodeB.child1);
+			consider(areaB - mergedArea(c, nodeB.child1), c, nodeB.child2);
+		}
+
+		if (!nodeB.isLeaf() && !nodeC.isLeaf()) {
+			float areaBC = nodeB.aabb.surfaceArea() + nodeC.aabb.surfaceArea();
+			int32_t d = nodeB.child1, e = nodeB.child2;
+			int32_t f = nodeC.child1, g = nodeC.child2;
+			consider(areaBC - (mergedArea(f, e) + mergedArea(d, g)), d, f);
+			consider(areaBC - (mergedArea(g, e) + mergedArea(f, d)), d, g);
+		}
+
+		if (swapA == NULL_NODE) return;
+
+		swapNodes(swapA, swapB);
+
+		// grandchildren are untouched, so refitting the two children and A is enough
+		if (!nodes[nodes[index].child1].isLeaf()) refit(nodes[index].child1);
+		if (!nodes[nodes[index].child2].isLeaf()) refit(nodes[index].child2);
+		refit(index);
+
+	}
+
+	void FveAabbTree::swapNodes(int32_t a, int32_t b) {
+
+		int32_t parentA = nodes[a].parent;
+		int32_t parentB = nodes[b].parent;
+
+		if (nodes[parentA].child1 == a) nodes[parentA].child1 = b;
+		else nodes[parentA].child2 = b;
+
+		if (nodes[parentB].child1 == b) nodes[parentB].child1 = a;
+		else nodes[parentB].child2 = a;
+
+		nodes[a].parent = parentB;
+		nodes[b].parent = parentA;
+
+	}
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "fve_bounds.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace fve {
+
+	// Dynamic bounding volume hierarchy over fattened AABBs. Leaves are proxies carrying a user value;
+	// a moved proxy costs nothing while it stays inside its fat box and is reinserted otherwise. New
+	// leaves go next to the sibling that adds the least surface area, and every node on the way back
+	// up is refit and tried against the tree rotation that shrinks its children the most, so the
+	// tree stays close to a fresh SAH build without ever being rebuilt.
+	class FveAabbTree {
+	public:
+		static constexpr int32_t NULL_NODE = -1;
+
+		explicit FveAabbTree(float margin = 0.1f);
+
+		int32_t createProxy(const Aabb& aabb, uint32_t userData);
+		void destroyProxy(int32_t proxyId);
+
+		// returns true if the proxy left its fat box and was reinserted
+		bool moveProxy(int32_t proxyId, const Aabb& aabb);
+
+		uint32_t getUserData(int32_t proxyId) const { return nodes[proxyId].userData; }
+		const Aabb& getFatAabb(int32_t proxyId) const { return nodes[proxyId].aabb; }
+
+		size_t getProxyCount() const { return proxyCount; }
+		int32_t getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+		// summed surface area of all nodes over the root's, lower is a better tree
+		float getAreaRatio() const;
+
+		// asserts the structure and the bounds are consistent
+		void validate() const;
+
+		// f(int32_t proxyId, uint32_t userData) for every proxy whose fat box overlaps, return false to stop
+		template<typename F>
+		void query(const Aabb& box, F&& f) const {
+			traverse([&](const Aabb& nodeBox) { return nodeBox.overlaps(box); }, f);
+		}
+
+		template<typename F>
+		void query(const Sphere& sphere, F&& f) const {
+			traverse([&](const Aabb& nodeBox) { return sphere.overlaps(nodeBox); }, f);
+		}
+
+		// subtrees fully inside the frustum are reported without testing their nodes
+		template<typename F>
+		void query(const Frustum& frustum, F&& f) const {
+			if (root == NULL_NODE) return;
+
+			NodeStack stack;
+			stack.push(root);
+			while (!stack.empty()) {
+				int32_t index = stack.pop();
+				const Node& node = nodes[index];
+
+				Containment containment = frustum.classify(node.aabb);
+				if (containment == Containment::Outside) continue;
+
+				if (containment == Containment::Inside) {
+					if (!reportAll(index, f)) return;
+				}
+				else if (node.isLeaf()) {
+					if (!f(index, node.userData)) return;
+				}
+				else {
+					stack.push(node.child1);
+					stack.push(node.child2);
+				}
+			}
+		}
+
+		// f(int32_t proxyId, uint32_t userData) returns the hit distance along the ray, or a negative value on a miss.
+		// the ray is clipped to the closest hit so far, so nodes behind it are never visited
+		template<typename F>
+		void raycast(const Ray& ray, F&& f) const {
+			if (root == NULL_NODE) return;
+
+			float maxDistance = ray.maxDistance;
+			NodeStack stack;
+			stack.push(root);
+			while (!stack.empty()) {
+				int32_t index = stack.pop();
+				const Node& node = nodes[index];
+
+				if (ray.intersect(node.aabb, maxDistance) < 0.0f) continue;
+
+				if (node.isLeaf()) {
+					float distance = f(index, node.userData);
+					if (distance >= 0.0f && distance < maxDistance) maxDistance = distance;
+				}
+				else {
+					stack.push(node.child1);
+					stack.push(node.child2);
+				}
+			}
+		}
+
+	private:
+		struct Node {
+			Aabb aabb;
+			int32_t parent = NULL_NODE; // next free node while on the free list
+			int32_t child1 = NULL_NODE;
+			int32_t child2 = NULL_NODE;
+			int32_t height = 0; // leaves are 0, free nodes -1
+			uint32_t userData = 0;
+
+			bool isLeaf() const { return child1 == NULL_NODE; }
+		};
+
+		// traversal stack that only touches the heap for very deep trees
+		class NodeStack {
+		public:
+			void push(int32_t index) {
+				if (count < INLINE_CAPACITY) inlineNodes[count] = index;
+				else overflow.push_back(index);
+				count++;
+			}
+
+			int32_t pop() {
+				count--;
+				if (count < INLINE_CAPACITY) return inlineNodes[count];
+				int32_t index = overflow.back();
+				overflow.pop_back();
+				return index;
+			}
+
+			bool empty() const { return count == 0; }
+
+		private:
+			static constexpr size_t INLINE_CAPACITY = 64;
+			int32_t inlineNodes[INLINE_CAPACITY];
+			std::vector<int32_t> overflow;
+			size_t count = 0;
+		};
+
+		template<typename Test, typename F>
+		void traverse(Test&& test, F& f) const {
+			if (root == NULL_NODE) return;
+
+			NodeStack stack;
+			stack.push(root);
+			while (!stack.empty()) {
+				int32_t index = stack.pop();
+				const Node& node = nodes[index];
+				if (!test(node.aabb)) continue;
+
+				if (node.isLeaf()) {
+					if (!f(index, node.userData)) return;
+				}
+				else {
+					stack.push(node.child1);
+					stack.push(node.child2);
+				}
+			}
+		}
+
+		template<typename F>
+		bool reportAll(int32_t subtree, F& f) const {
+			NodeStack stack;
+			stack.push(subtree);
+			while (!stack.empty()) {
+				int32_t index = stack.pop();
+				const Node& node = nodes[index];
+				if (node.isLeaf()) {
+					if (!f(index, node.userData)) return false;
+				}
+				else {
+					stack.push(node.child1);
+					stack.push(node.child2);
+				}
+			}
+			return true;
+		}
+
+		int32_t allocateNode();
+		void freeNode(int32_t index);
+
+		void insertLeaf(int32_t leaf);
+		void removeLeaf(int32_t leaf);
+		int32_t findBestSibling(const Aabb& box) const;
+
+		// refits and rotates every node from index up to the root
+		void refitAncestors(int32_t index);
+		void refit(int32_t index);
+		void rotate(int32_t index);
+
+		// swaps two nodes that are not ancestors of each other
+		void swapNodes(int32_t a, int32_t b);
+
+		int32_t validateSubtree(int32_t index) const;
+
+		std::vector<Node> nodes;
+		int32_t root = NULL_NODE;
+		int32_t freeList = NULL_NODE;
+		size_t proxyCount = 0;
+		float margin;
+	};
+
+}
@@ -0,0 +1,139 @@
+#include "fve_asset_watcher.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace fve {
+
+	// editors tend to write a file in several steps, so wait until a file has been quiet for this long
+	static constexpr auto SETTLE_TIME = std::chrono::milliseconds(150);
+	static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(500);
+
+	FveAssetWatcher::FveAssetWatcher(const std::vector<std::string>& directories, ChangeCallback onChange)
+		: directories{ directories }, onChange{ std::move(onChange) } {
+
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd < 0) {
+			std::cerr << "inotify unavailable, falling back to polling for asset changes" << std::endl;
+		}
+		else {
+			for (const auto& dir : directories) {
+				std::string enginePath = ENGINE_DIR + dir;
+				int wd = inotify_add_watch(inotifyFd, enginePath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+				if (wd < 0) {
+					std::cerr << "Failed to watch asset directory " << enginePath << std::endl;
+					continue;
+				}
+				watchDirectories.emplace(wd, dir);
+			}
+			worker = std::thread(&FveAssetWatcher::watchLoop, this);
+			return;
+		}
+#endif
+
+		worker = std::thread(&FveAssetWatcher::pollLoop, this);
+	}
+
+	FveAssetWatcher::~FveAssetWatcher() {
+		running = false;
+		if (worker.joinable()) worker.join();
+
+#ifdef __linux__
+		if (inotifyFd >= 0) close(inotifyFd);
+#endif
+	}
+
+	void FveAssetWatcher::watchLoop() {
+#ifdef __linux__
+		using clock = std::chrono::steady_clock;
+
+		// changed files waiting for their writes to settle
+		std::unordered_map<std::string, clock::time_point> pending;
+
+		alignas(inotify_event) char buffer[4096];
+
+		while (running) {
+			pollfd pfd{ inotifyFd, POLLIN, 0 };
+			int ready = poll(&pfd, 1, 50);
+
+			if (ready > 0 && (pfd.revents & POLLIN)) {
+				ssize_t length;
+				while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+					for (char* ptr = buffer; ptr < buffer + length; ) {
+						auto* event = reinterpret_cast<inotify_event*>(ptr);
+						ptr += sizeof(inotify_event) + event->len;
+
+						if (event->len == 0 || (event->mask & IN_ISDIR)) continue;
+
+						auto it = watchDirectories.find(event->wd);
+						if (it == watchDirectories.end()) continue;
+
+						pending[it->second + "/" + event->name] = clock::now();
+					}
+				}
+			}
+
+			// report everything that has been quiet long enough
+			auto now = clock::now();
+			for (auto it = pending.begin(); it != pending.end(); ) {
+				if (now - it->second >= SETTLE_TIME) {
+					onChange(it->first);
+					it = pending.erase(it);
+				}
+				else ++it;
+			}
+		}
+#endif
+	}
+
+	void FveAssetWatcher::pollLoop() {
+		namespace fs = std::filesystem;
+
+		std::unordered_map<std::string, fs::file_time_type> lastWriteTimes;
+
+		auto scan = [&](bool report) {
+			for (const auto& dir : directories) {
+				std::error_code ec;
+				for (const auto& entry : fs::directory_iterator(ENGINE_DIR + dir, ec)) {
+					if (!entry.is_regular_file(ec)) continue;
+
+					std::string relativePath = dir + "/" + entry.path().filename().string();
+					auto writeTime = entry.last_write_time(ec);
+					if (ec) continue;
+
+					auto it = lastWriteTimes.find(relativePath);
+					if (it == lastWriteTimes.end()) {
+						lastWriteTimes.emplace(relativePath, writeTime);
+						if (report) onChange(relativePath);
+					}
+					else if (it->second != writeTime) {
+						it->second = writeTime;
+						if (report) onChange(relativePath);
+					}
+				}
+			}
+		};
+
+		// record the initial state without reporting it
+		scan(false);
+
+		while (running) {
+			std::this_thread::sleep_for(POLL_INTERVAL);
+			if (!running) break;
+			scan(true);
+		}
+	}
+
+}
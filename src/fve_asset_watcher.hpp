@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	// Watches asset directories (relative to ENGINE_DIR) on a background thread and reports
+	// each changed file once its write has settled. Uses inotify on Linux and falls back to
+	// polling file modification times everywhere else.
+	class FveAssetWatcher {
+	public:
+		using ChangeCallback = std::function<void(const std::string& relativePath)>;
+
+		FveAssetWatcher(const std::vector<std::string>& directories, ChangeCallback onChange);
+		~FveAssetWatcher();
+
+		FveAssetWatcher(const FveAssetWatcher&) = delete;
+		FveAssetWatcher& operator=(const FveAssetWatcher&) = delete;
+
+	private:
+		void watchLoop();
+		void pollLoop();
+
+		std::vector<std::string> directories;
+		ChangeCallback onChange;
+
+		std::atomic<bool> running{ true };
+		std::thread worker;
+
+#ifdef __linux__
+		int inotifyFd = -1;
+		std::unordered_map<int, std::string> watchDirectories;
+#endif
+	};
+
+}
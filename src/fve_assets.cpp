@@ -1,24 +1,26 @@
 #include "fve_assets.hpp"
+#include "fve_asset_watcher.hpp"
+#include "fve_pipeline.hpp"
 #include "fve_utils.hpp"
 #include "fve_initializers.hpp"
 #include "fve_buffer.hpp"
+#include "fve_constants.hpp"
 
 #include <stdexcept>
 #include <iostream>
-
-#ifndef ENGINE_DIR
-#define ENGINE_DIR "../"
-#endif
+#include <filesystem>
+#include <set>
 
 class FveBuffer;
 
 namespace std {
 
+	// a material is fully described by the handles it binds
 	template<>
 	struct hash<fve::Material> {
 		size_t operator()(fve::Material const& material) const {
 			size_t seed = 0;
-			fve::hashCombine(seed, material.pipeline, material.pipelineLayout);
+			fve::hashCombine(seed, material.pipeline, material.pipelineLayout, material.textureSet);
 			return seed;
 		}
 	};
@@ -26,9 +28,14 @@ namespace std {
 	template<>
 	struct hash<fve::Mesh> {
 		size_t operator()(fve::Mesh const& mesh) const {
-			size_t seed = 0;
-			fve::hashCombine(seed, mesh.vertexBuffer, mesh.indexBuffer);
-			return seed;
+			return static_cast<size_t>(mesh.contentHash);
+		}
+	};
+
+	template<>
+	struct hash<fve::Texture> {
+		size_t operator()(fve::Texture const& texture) const {
+			return static_cast<size_t>(texture.contentHash);
 		}
 	};
 
@@ -47,16 +54,39 @@ namespace fve {
 
 	FveAssets fveAssets;
 
+	template<typename Key>
+	static size_t countAliases(const std::unordered_map<std::string, Key>& aliases, const Key& key) {
+		size_t count = 0;
+		for (auto& kv : aliases) {
+			if (kv.second == key) count++;
+		}
+		return count;
+	}
+
+	static uint64_t meshBytes(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+	}
+
+	FveAssets::ContentKey FveAssets::meshKey(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint64_t contentHash) {
+		return { contentHash, uint64_t(vertices.size()) << 32 | indices.size() };
+	}
+
+	FveAssets::ContentKey FveAssets::textureKey(const ImageData& image, uint64_t contentHash) {
+		return { contentHash, uint64_t(uint32_t(image.width)) << 32 | uint32_t(image.height) };
+	}
+
+	FveAssets::FveAssets() = default;
+
 	FveAssets::~FveAssets() {
 		//
 	}
 
 	Material* FveAssets::createMaterial(VkPipeline pipeline, VkPipelineLayout pipelineLayout, const std::string& matId) {
-		Material mat;
+		// update in place if the material already exists (e.g. its pipeline was rebuilt) so pointers stay valid
+		Material& mat = materials[matId];
 		mat.pipeline = pipeline;
 		mat.pipelineLayout = pipelineLayout;
-		materials.emplace(matId, mat);
-		return &materials[matId];
+		return &mat;
 	}
 
 	Material* FveAssets::getMaterial(const std::string& name) {
@@ -83,7 +113,12 @@ namespace fve {
 		Mesh::Builder builder;
 		builder.loadMesh(filepath);
 
-		return createMesh(device, builder.vertices, builder.indices, meshId);
+		{
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			meshSources.emplace(filepath, meshId);
+		}
+
+		return storeMesh(device, builder.vertices, builder.indices, Mesh::hashContents(builder.vertices, builder.indices), meshId, nullptr);
 
 	}
 
@@ -96,15 +131,60 @@ namespace fve {
 			return existing;
 		}
 
-		//Mesh mesh = Mesh(device, vertices, indices);
-		meshes.try_emplace(meshId, device, vertices, indices);
-		return &meshes[meshId];
+		return storeMesh(device, vertices, indices, Mesh::hashContents(vertices, indices), meshId, nullptr);
 
 	}
 
+	Mesh* FveAssets::storeMesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint64_t contentHash, const std::string& meshId, FveUploadQueue* queue) {
+
+		ContentKey key = meshKey(vertices, indices, contentHash);
+		auto it = meshes.find(key);
+		if (it != meshes.end()) {
+			deduplicationStats.meshAliases++;
+			deduplicationStats.meshBytesSaved += meshBytes(vertices, indices);
+			std::cout << "Mesh " << meshId << " is identical to an already loaded mesh, sharing it" << std::endl;
+		}
+		else {
+			if (queue != nullptr) {
+				it = meshes.try_emplace(key, device, *queue, vertices, indices, getMeshArena(device)).first;
+			}
+			else {
+				it = meshes.try_emplace(key, device, vertices, indices, getMeshArena(device)).first;
+			}
+			it->second.contentHash = contentHash;
+		}
+
+		if (occluderMeshIds.count(meshId) != 0 && it->second.cpuPositions.empty()) {
+			it->second.keepCpuGeometry(vertices, indices);
+		}
+
+		meshAliases[meshId] = key;
+		return &it->second;
+
+	}
+
+	void FveAssets::keepOccluderGeometry(const std::string& meshId) {
+		if (getMesh(meshId) != nullptr) {
+			std::cerr << "Mesh " << meshId << " is already loaded, its triangles are no longer on the CPU" << std::endl;
+		}
+		occluderMeshIds.insert(meshId);
+	}
+
+	FveMeshArena* FveAssets::getMeshArena(FveDevice& device) {
+		if (meshArena == nullptr) {
+			meshArena = std::make_unique<FveMeshArena>(device, MESH_ARENA_VERTICES, MESH_ARENA_INDICES);
+		}
+		return meshArena.get();
+	}
+
 	Mesh* FveAssets::getMesh(const std::string& meshId) {
 
-		auto it = meshes.find(meshId);
+		auto alias = meshAliases.find(meshId);
+		if (alias == meshAliases.end()) {
+			return nullptr;
+		}
+
+		auto it = meshes.find(alias->second);
 		if (it == meshes.end()) {
 			return nullptr;
 		}
@@ -129,6 +209,25 @@ namespace fve {
 
 	}
 
+	FveModel* FveAssets::createModel(FveDevice& device, const std::string& meshId, Material* material, const std::string& modelId) {
+
+		// check if the model already exists
+		FveModel* existing = getModel(modelId);
+		if (existing != nullptr) {
+			std::cerr << "Tried to create a model that already exists! (id: " << modelId << ")" << std::endl;
+			return existing;
+		}
+
+		Mesh* mesh = getMesh(meshId);
+		if (mesh == nullptr) {
+			throw std::runtime_error("Tried to create model " + modelId + " from unknown mesh " + meshId);
+		}
+
+		models.try_emplace(modelId, device, mesh, material, meshId);
+		return &models[modelId];
+
+	}
+
 	FveModel* FveAssets::getModel(const std::string& modelId) {
 
 		auto it = models.find(modelId);
@@ -141,15 +240,52 @@ namespace fve {
 
 	}
 
+	std::string FveAssets::getModelId(const FveModel* model) const {
+
+		for (const auto& [modelId, candidate] : models) {
+			if (&candidate == model) return modelId;
+		}
+		return {};
+
+	}
+
+	std::string FveAssets::getTextureId(TextureHandle handle) const {
+
+		for (const auto& [textureId, candidate] : textureHandles) {
+			if (candidate == handle) return textureId;
+		}
+		return {};
+
+	}
+
 	Texture* FveAssets::getTexture(const std::string& textureId) {
 
-		auto it = textures.find(textureId);
-		if (it == textures.end()) {
+		auto it = textureHandles.find(textureId);
+		if (it == textureHandles.end()) {
 			return nullptr;
 		}
 		else {
-			return &(*it).second;
+			return &textureSlots.get(it->second);
+		}
+
+	}
+
+	Texture* FveAssets::getTexture(TextureHandle handle) {
+
+		if (!textureSlots.contains(handle)) {
+			return nullptr;
+		}
+		return &textureSlots.get(handle);
+
+	}
+
+	TextureHandle FveAssets::getTextureHandle(const std::string& textureId) const {
+
+		auto it = textureHandles.find(textureId);
+		if (it == textureHandles.end()) {
+			return TextureHandle{};
 		}
+		return it->second;
 
 	}
 
@@ -157,17 +293,232 @@ namespace fve {
 
 		// TODO check already exists
 
-		std::string enginePath = ENGINE_DIR + filePath;
+		ImageData image;
+		if (decodeImageFromFile(filePath.c_str(), image)) {
 
-		Texture texture;
-		if (loadImageFromFile(device, enginePath.c_str(), texture.allocatedImage)) {
+			storeTexture(device, image, hashImage(image), textureId, nullptr);
+
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			textureSources.emplace(filePath, textureId);
+		}
+		else throw std::runtime_error("Failed to load texture " + filePath);
+
+	}
+
+	Texture* FveAssets::storeTexture(FveDevice& device, const ImageData& image, uint64_t contentHash, const std::string& textureId, FveUploadQueue* queue) {
+
+		ContentKey key = textureKey(image, contentHash);
+		auto it = textures.find(key);
+		if (it != textures.end()) {
+			deduplicationStats.textureAliases++;
+			deduplicationStats.textureBytesSaved += image.pixels.size();
+			std::cout << "Texture " << textureId << " is identical to an already loaded texture, sharing it" << std::endl;
+		}
+		else {
+			Texture texture;
+			texture.contentHash = contentHash;
+
+			if (queue != nullptr) {
+				queue->keepAlive(recordImageUpload(device, queue->getCommandBuffer(), image, texture.allocatedImage));
+			}
+			else {
+				uploadImage(device, image, texture.allocatedImage);
+			}
 
 			VkImageViewCreateInfo imageinfo = fve_init::imageViewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, texture.allocatedImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
 			vkCreateImageView(device.device(), &imageinfo, nullptr, &texture.imageView);
 
-			textures.emplace(textureId, texture);
+			it = textures.emplace(key, texture).first;
+		}
+
+		textureAliases[textureId] = key;
+
+		auto handle = textureHandles.find(textureId);
+		if (handle == textureHandles.end()) {
+			handle = textureHandles.emplace(textureId, textureSlots.allocate(it->second)).first;
+		}
+		else {
+			textureSlots.get(handle->second) = it->second;
+		}
+		return &textureSlots.get(handle->second);
+
+	}
+
+	void FveAssets::startAsyncLoads(FveDevice& device) {
+
+		// created on first use, the global instance outlives the device otherwise
+		if (uploadQueue == nullptr) {
+			uploadQueue = std::make_unique<FveUploadQueue>(device);
 		}
-		else throw std::runtime_error("Failed to load texture " + filePath);
+
+	}
+
+	std::shared_future<Mesh*> FveAssets::loadMeshAsync(FveDevice& device, const std::string& filepath, const std::string& meshId) {
+
+		// hand back the same future if this mesh is already loading
+		auto pending = meshLoads.find(meshId);
+		if (pending != meshLoads.end()) {
+			return pending->second.future;
+		}
+
+		AsyncLoad<Mesh>& load = meshLoads[meshId];
+		load.future = load.promise.get_future().share();
+
+		// already loaded synchronously
+		Mesh* existing = getMesh(meshId);
+		if (existing != nullptr) {
+			load.promise.set_value(existing);
+			return load.future;
+		}
+
+		startAsyncLoads(device);
+		importsInFlight++;
+
+		fveJobs.async([this, filepath, meshId]() {
+			ImportedAsset imported{ AssetType::Mesh, meshId, filepath };
+			try {
+				imported.mesh.loadMesh(filepath);
+				imported.contentHash = Mesh::hashContents(imported.mesh.vertices, imported.mesh.indices);
+			}
+			catch (...) {
+				imported.error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(importMutex);
+				importedAssets.push_back(std::move(imported));
+			}
+			importReady.notify_one();
+		});
+
+		return load.future;
+
+	}
+
+	std::shared_future<Texture*> FveAssets::loadTextureAsync(FveDevice& device, const std::string& filePath, const std::string& textureId) {
+
+		// hand back the same future if this texture is already loading
+		auto pending = textureLoads.find(textureId);
+		if (pending != textureLoads.end()) {
+			return pending->second.future;
+		}
+
+		AsyncLoad<Texture>& load = textureLoads[textureId];
+		load.future = load.promise.get_future().share();
+
+		// already loaded synchronously
+		Texture* existing = getTexture(textureId);
+		if (existing != nullptr) {
+			load.promise.set_value(existing);
+			return load.future;
+		}
+
+		startAsyncLoads(device);
+		importsInFlight++;
+
+		fveJobs.async([this, filePath, textureId]() {
+			ImportedAsset imported{ AssetType::Texture, textureId, filePath };
+			try {
+				if (!decodeImageFromFile(filePath.c_str(), imported.image)) {
+					throw std::runtime_error("Failed to load texture " + filePath);
+				}
+				imported.contentHash = hashImage(imported.image);
+			}
+			catch (...) {
+				imported.error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(importMutex);
+				importedAssets.push_back(std::move(imported));
+			}
+			importReady.notify_one();
+		});
+
+		return load.future;
+
+	}
+
+	void FveAssets::createAsyncAsset(FveDevice& device, ImportedAsset& imported) {
+
+		const std::string& assetId = imported.assetId;
+
+		if (imported.type == AssetType::Mesh) {
+			auto& load = meshLoads[assetId];
+			if (imported.error) {
+				load.promise.set_exception(imported.error);
+				return;
+			}
+
+			Mesh* mesh = storeMesh(device, imported.mesh.vertices, imported.mesh.indices, imported.contentHash, assetId, uploadQueue.get());
+			std::cout << "Loaded mesh: " << imported.filePath << " -- " << "Vertex count: " << imported.mesh.vertices.size() << std::endl;
+
+			{
+				std::lock_guard<std::mutex> lock(reloadMutex);
+				meshSources.emplace(imported.filePath, assetId);
+			}
+
+			uploadQueue->onComplete([this, mesh, assetId]() {
+				mesh->resident = true;
+				meshLoads[assetId].promise.set_value(mesh);
+			});
+		}
+		else if (imported.type == AssetType::Texture) {
+			auto& load = textureLoads[assetId];
+			if (imported.error) {
+				load.promise.set_exception(imported.error);
+				return;
+			}
+
+			Texture* stored = storeTexture(device, imported.image, imported.contentHash, assetId, uploadQueue.get());
+
+			{
+				std::lock_guard<std::mutex> lock(reloadMutex);
+				textureSources.emplace(imported.filePath, assetId);
+			}
+
+			uploadQueue->onComplete([this, stored, assetId]() {
+				textureLoads[assetId].promise.set_value(stored);
+			});
+		}
+
+	}
+
+	void FveAssets::updateAsyncLoads(FveDevice& device) {
+
+		if (uploadQueue == nullptr) return;
+
+		std::vector<ImportedAsset> ready;
+		{
+			std::lock_guard<std::mutex> lock(importMutex);
+			ready.swap(importedAssets);
+		}
+
+		for (auto& imported : ready) {
+			importsInFlight--;
+			createAsyncAsset(device, imported);
+		}
+
+		// everything recorded this update goes out as one batch
+		uploadQueue->submit();
+		uploadQueue->poll();
+
+	}
+
+	void FveAssets::waitForAsyncLoads(FveDevice& device) {
+
+		if (uploadQueue == nullptr) return;
+
+		while (importsInFlight > 0) {
+			{
+				std::unique_lock<std::mutex> lock(importMutex);
+				importReady.wait(lock, [this]() { return !importedAssets.empty(); });
+			}
+			updateAsyncLoads(device);
+		}
+
+		uploadQueue->submit();
+		uploadQueue->waitIdle();
 
 	}
 
@@ -221,10 +572,308 @@ namespace fve {
 
 	}
 
+	void FveAssets::enableHotReload() {
+
+		if (watcher != nullptr) return;
+
+		// watch every directory we have loaded something from
+		std::set<std::string> directories;
+		{
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			for (auto& kv : meshSources) directories.insert(std::filesystem::path(kv.first).parent_path().generic_string());
+			for (auto& kv : textureSources) directories.insert(std::filesystem::path(kv.first).parent_path().generic_string());
+			for (auto& kv : shaderPipelines) directories.insert(std::filesystem::path(kv.first).parent_path().generic_string());
+		}
+
+		watcher = std::make_unique<FveAssetWatcher>(
+			std::vector<std::string>(directories.begin(), directories.end()),
+			[this](const std::string& filePath) { onAssetFileChanged(filePath); });
+
+		std::cout << "Hot reload enabled for " << directories.size() << " asset directories" << std::endl;
+
+	}
+
+	void FveAssets::onAssetFileChanged(const std::string& filePath) {
+
+		// find out what was loaded from this file
+		std::vector<std::string> meshIds;
+		std::vector<std::string> textureIds;
+		bool isShader;
+		{
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			auto meshRange = meshSources.equal_range(filePath);
+			for (auto it = meshRange.first; it != meshRange.second; ++it) meshIds.push_back(it->second);
+			auto textureRange = textureSources.equal_range(filePath);
+			for (auto it = textureRange.first; it != textureRange.second; ++it) textureIds.push_back(it->second);
+			isShader = shaderPipelines.count(filePath) > 0;
+		}
+
+		std::vector<ImportedAsset> reloads;
+
+		// re-import on this thread; only the GPU upload has to wait for the main thread.
+		// always read the loose file, a mounted pack would still hold the old contents
+		try {
+			if (!meshIds.empty()) {
+				Mesh::Builder builder;
+				builder.loadMeshFromData(fveVfs.readLooseFile(filePath));
+				for (auto& meshId : meshIds) {
+					ImportedAsset reload{ AssetType::Mesh, meshId, filePath };
+					reload.mesh = builder;
+					reloads.push_back(std::move(reload));
+				}
+			}
+
+			if (!textureIds.empty()) {
+				ImageData image;
+				if (!decodeImage(fveVfs.readLooseFile(filePath), image, filePath.c_str())) {
+					throw std::runtime_error("Failed to decode texture " + filePath);
+				}
+				for (auto& textureId : textureIds) {
+					ImportedAsset reload{ AssetType::Texture, textureId, filePath };
+					reload.image = image;
+					reloads.push_back(std::move(reload));
+				}
+			}
+
+			if (isShader) {
+				FveFileData code = fveVfs.readLooseFile(filePath);
+
+				// don't hand a half-written module to the driver
+				const uint32_t spirvMagic = 0x07230203;
+				if (code.size() < 4 || code.size() % 4 != 0 || *reinterpret_cast<const uint32_t*>(code.data()) != spirvMagic) {
+					throw std::runtime_error("Invalid SPIR-V in " + filePath);
+				}
+
+				ImportedAsset reload{ AssetType::Shader, filePath, filePath };
+				reload.code = std::move(code);
+				reloads.push_back(std::move(reload));
+			}
+		}
+		catch (const std::exception& e) {
+			std::cerr << "Hot reload of " << filePath << " failed: " << e.what() << std::endl;
+			return;
+		}
+
+		if (reloads.empty()) return;
+
+		std::lock_guard<std::mutex> lock(reloadMutex);
+		for (auto& reload : reloads) {
+			pendingReloads.push_back(std::move(reload));
+		}
+
+	}
+
+	void FveAssets::processReloads(FveDevice& device) {
+
+		std::vector<ImportedAsset> ready;
+		{
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			if (pendingReloads.empty()) return;
+			ready.swap(pendingReloads);
+		}
+
+		// the old resources may still be in use by frames in flight
+		vkDeviceWaitIdle(device.device());
+
+		for (auto& reload : ready) {
+			switch (reload.type) {
+			case AssetType::Mesh: {
+				if (getMesh(reload.assetId) == nullptr) continue;
+				reloadMesh(device, reload.assetId, reload.mesh);
+				break;
+			}
+			case AssetType::Texture: {
+				if (getTexture(reload.assetId) == nullptr) continue;
+				reloadTexture(device, reload.assetId, reload.image);
+				break;
+			}
+			case AssetType::Shader: {
+				std::vector<FvePipeline*> pipelines;
+				{
+					std::lock_guard<std::mutex> lock(reloadMutex);
+					auto range = shaderPipelines.equal_range(reload.filePath);
+					for (auto it = range.first; it != range.second; ++it) pipelines.push_back(it->second);
+				}
+				for (auto* pipeline : pipelines) {
+					pipeline->reloadShader(reload.filePath, reload.code);
+				}
+				break;
+			}
+			}
+
+			std::cout << "Reloaded " << reload.assetId << " from " << reload.filePath << std::endl;
+
+			for (auto& listener : reloadListeners) {
+				listener(reload.type, reload.assetId);
+			}
+		}
+
+	}
+
+	void FveAssets::reloadMesh(FveDevice& device, const std::string& meshId, const Mesh::Builder& builder) {
+
+		ContentKey& aliasKey = meshAliases.at(meshId);
+		ContentKey oldKey = aliasKey;
+		uint64_t newHash = Mesh::hashContents(builder.vertices, builder.indices);
+		ContentKey newKey = meshKey(builder.vertices, builder.indices, newHash);
+		if (newKey == oldKey) return;
+
+		Mesh* newMesh;
+		auto existing = meshes.find(newKey);
+		if (existing != meshes.end()) {
+			// edited into a copy of something we already have
+			newMesh = &existing->second;
+		}
+		else if (countAliases(meshAliases, oldKey) == 1) {
+			// sole owner, swap the buffers in place so every pointer stays valid
+			auto node = meshes.extract(oldKey);
+			node.mapped().reload(device, builder.vertices, builder.indices);
+			node.mapped().contentHash = newHash;
+			node.key() = newKey;
+			meshes.insert(std::move(node));
+			aliasKey = newKey;
+			return;
+		}
+		else {
+			// the old content is still used by other ids, split this one off
+			newMesh = &meshes.try_emplace(newKey, device, builder.vertices, builder.indices, getMeshArena(device)).first->second;
+			newMesh->contentHash = newHash;
+		}
+
+		if (occluderMeshIds.count(meshId) != 0 && newMesh->cpuPositions.empty()) {
+			newMesh->keepCpuGeometry(builder.vertices, builder.indices);
+		}
+
+		aliasKey = newKey;
+
+		for (auto& kv : models) {
+			if (kv.second.getMeshId() == meshId) kv.second.setMesh(newMesh);
+		}
+
+		releaseUnusedMesh(oldKey);
+
+	}
+
+	void FveAssets::reloadTexture(FveDevice& device, const std::string& textureId, const ImageData& image) {
+
+		ContentKey& aliasKey = textureAliases.at(textureId);
+		ContentKey oldKey = aliasKey;
+		uint64_t newHash = hashImage(image);
+		ContentKey newKey = textureKey(image, newHash);
+		if (newKey == oldKey) return;
+
+		if (textures.count(newKey) == 0 && countAliases(textureAliases, oldKey) == 1) {
+			// sole owner, replace the image in place
+			auto node = textures.extract(oldKey);
+			Texture& texture = node.mapped();
+
+			vkDestroyImageView(device.device(), texture.imageView, nullptr);
+			vmaDestroyImage(fveAllocator, texture.allocatedImage.image, texture.allocatedImage.allocation);
+
+			uploadImage(device, image, texture.allocatedImage);
+			VkImageViewCreateInfo imageinfo = fve_init::imageViewCreateInfo(VK_FORMAT_R8G8B8A8_SRGB, texture.allocatedImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+			vkCreateImageView(device.device(), &imageinfo, nullptr, &texture.imageView);
+			texture.contentHash = newHash;
+
+			node.key() = newKey;
+			textures.insert(std::move(node));
+			aliasKey = newKey;
+			updateTextureSlots(newKey);
+			return;
+		}
+
+		// either shared with other ids or edited into a copy of something we already have;
+		// textures are looked up by id, so repointing the alias is all the retargeting needed
+		storeTexture(device, image, newHash, textureId, nullptr);
+		releaseUnusedTexture(device, oldKey);
+
+	}
+
+	void FveAssets::releaseUnusedMesh(ContentKey key) {
+
+		if (countAliases(meshAliases, key) > 0) return;
+
+		auto it = meshes.find(key);
+		if (it == meshes.end()) return;
+
+		// models built from a bare pointer may still use it
+		for (auto& kv : models) {
+			if (&kv.second.getMesh() == &it->second) return;
+		}
+
+		meshes.erase(it);
+
+	}
+
+	void FveAssets::releaseUnusedTexture(FveDevice& device, ContentKey key) {
+
+		if (countAliases(textureAliases, key) > 0) return;
+
+		auto it = textures.find(key);
+		if (it == textures.end()) return;
+
+		vkDestroyImageView(device.device(), it->second.imageView, nullptr);
+		vmaDestroyImage(fveAllocator, it->second.allocatedImage.image, it->second.allocatedImage.allocation);
+		textures.erase(it);
+
+	}
+
+	void FveAssets::updateTextureSlots(ContentKey key) {
+
+		const Texture& texture = textures.at(key);
+		for (auto& kv : textureAliases) {
+			if (kv.second == key) {
+				textureSlots.get(textureHandles.at(kv.first)) = texture;
+			}
+		}
+
+	}
+
+	void FveAssets::reportDeduplication() const {
+
+		std::cout << "Asset deduplication: "
+			<< meshAliases.size() << " mesh ids on " << meshes.size() << " meshes, "
+			<< deduplicationStats.meshAliases << " duplicates shared (" << deduplicationStats.meshBytesSaved / 1024 << " KiB saved); "
+			<< textureAliases.size() << " texture ids on " << textures.size() << " textures, "
+			<< deduplicationStats.textureAliases << " duplicates shared (" << deduplicationStats.textureBytesSaved / 1024 << " KiB saved)" << std::endl;
+
+	}
+
+	void FveAssets::addReloadListener(ReloadListener listener) {
+		reloadListeners.push_back(std::move(listener));
+	}
+
+	void FveAssets::registerShaderPipeline(const std::string& filePath, FvePipeline* pipeline) {
+		std::lock_guard<std::mutex> lock(reloadMutex);
+		shaderPipelines.emplace(filePath, pipeline);
+	}
+
+	void FveAssets::unregisterShaderPipeline(FvePipeline* pipeline) {
+		std::lock_guard<std::mutex> lock(reloadMutex);
+		for (auto it = shaderPipelines.begin(); it != shaderPipelines.end(); ) {
+			if (it->second == pipeline) it = shaderPipelines.erase(it);
+			else ++it;
+		}
+	}
+
 	void FveAssets::cleanUp(FveDevice& device) {
 
+		// stop watching before anything goes away underneath the watcher thread
+		watcher.reset();
+		reloadListeners.clear();
+
+		// let in-flight loads land so nothing is written to freed memory
+		waitForAsyncLoads(device);
+		uploadQueue.reset();
+		meshLoads.clear();
+		textureLoads.clear();
+
 		std::cout << "Destroying meshes" << std::endl;
 
+		// the arena goes after the meshes, which free their ranges into it
+		meshes.clear();
+		meshArena.reset();
+
 		// find all allocations
 		//std::vector<VmaAllocation> allocations{};
 
@@ -249,7 +898,7 @@ namespace fve {
 			auto& texture = kv.second;
 			vkDestroyImageView(device.device(), texture.imageView, nullptr);
 			vmaDestroyImage(fveAllocator, texture.allocatedImage.image, texture.allocatedImage.allocation);
-			std::cout << "Cleaned up " << kv.first << std::endl;
+			std::cout << "Cleaned up texture " << std::hex << kv.first.hash << std::dec << std::endl;
 
 			//vmaFreeMemory(fveAllocator, texture.allocatedImage.allocation);
 
@@ -1,18 +1,38 @@
 #pragma once
 
 #include "fve_model.hpp"
+#include "fve_mesh_arena.hpp"
 #include "fve_memory.hpp"
 #include "fve_device.hpp"
 #include "fve_textures.hpp"
-
+#include "fve_job_system.hpp"
+#include "fve_upload_queue.hpp"
+#include "fve_utils.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace fve {
 
+	class FvePipeline;
+	class FveAssetWatcher;
+
 	class FveAssets {
 	public:
 
-		FveAssets() = default;
+		enum class AssetType { Mesh, Texture, Shader };
+
+		// called on the main thread after an asset has been swapped in place
+		using ReloadListener = std::function<void(AssetType type, const std::string& assetId)>;
+
+		FveAssets();
 		~FveAssets();
 
 		FveAssets(const FveAssets&) = delete;
@@ -31,30 +51,164 @@ namespace fve {
 
 		Mesh* getMesh(const std::string& name);
 
+		// meshes stored under this id keep their triangles on the CPU for the software occlusion
+		// rasterizer; call before loading the mesh, every other mesh lives on the GPU only
+		void keepOccluderGeometry(const std::string& meshId);
+
 		FveModel* createModel(FveDevice& device, Mesh* mesh, Material* material, const std::string& name);
 
+		// preferred over the mesh pointer overload: the model follows the mesh id across hot reloads
+		FveModel* createModel(FveDevice& device, const std::string& meshId, Material* material, const std::string& name);
+
 		FveModel* getModel(const std::string& name);
 
+		// reverse lookups for saving scenes, linear in the number of models/textures; empty if unknown
+		std::string getModelId(const FveModel* model) const;
+		std::string getTextureId(TextureHandle handle) const;
+
 		Texture* getTexture(const std::string& name);
+		Texture* getTexture(TextureHandle handle);
+		TextureHandle getTextureHandle(const std::string& name) const;
 
 		void loadTexture(FveDevice& device, const std::string& filePath, const std::string& name);
 
+		// parse/decode on fveJobs workers and upload through a fenced queue; the future
+		// becomes ready once the asset is resident on the GPU and can be bound
+		std::shared_future<Mesh*> loadMeshAsync(FveDevice& device, const std::string& filepath, const std::string& name);
+		std::shared_future<Texture*> loadTextureAsync(FveDevice& device, const std::string& filePath, const std::string& name);
+
+		// creates GPU resources for finished imports and retires finished uploads; call once per frame
+		void updateAsyncLoads(FveDevice& device);
+
+		// blocks until every async load started so far is resident
+		void waitForAsyncLoads(FveDevice& device);
+
 		VkSampler* createSampler(FveDevice& device, VkFilter filters, VkSamplerAddressMode addressMode, const std::string& sampelerId);
 
 		VkSampler* createSampler(FveDevice& device, VkFilter filters, const std::string& sampelerId);
 
 		VkSampler* getSampler(const std::string& samplerId);
 
+		// starts watching the source files of everything loaded so far
+		void enableHotReload();
+
+		// swaps in any assets re-imported since the last call; call between frames
+		void processReloads(FveDevice& device);
+
+		void addReloadListener(ReloadListener listener);
+
+		void registerShaderPipeline(const std::string& filePath, FvePipeline* pipeline);
+		void unregisterShaderPipeline(FvePipeline* pipeline);
+
+		// prints how many aliases were folded into existing GPU resources and the memory that saved
+		void reportDeduplication() const;
+
 		void cleanUp(FveDevice& device);
 	private:
+		// CPU side result of importing a file, handed from a worker thread to the main thread
+		struct ImportedAsset {
+			AssetType type;
+			std::string assetId;
+			std::string filePath;
+			Mesh::Builder mesh;
+			ImageData image;
+			FveFileData code;
+			uint64_t contentHash = 0;
+			std::exception_ptr error;
+		};
+
+		struct DeduplicationStats {
+			uint32_t meshAliases = 0;
+			uint32_t textureAliases = 0;
+			uint64_t meshBytesSaved = 0;
+			uint64_t textureBytesSaved = 0;
+		};
+
+		// the content hash alone is not trusted: the shape of the data is part of the key,
+		// mesh vertex and index counts or texture width and height, so differently shaped
+		// assets colliding on the hash stay separate resources
+		struct ContentKey {
+			uint64_t hash;
+			uint64_t shape;
+			bool operator==(const ContentKey& other) const { return hash == other.hash && shape == other.shape; }
+		};
+
+		struct ContentKeyHash {
+			size_t operator()(const ContentKey& key) const {
+				size_t seed = 0;
+				hashCombine(seed, key.hash, key.shape);
+				return seed;
+			}
+		};
+
+		static ContentKey meshKey(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint64_t contentHash);
+		static ContentKey textureKey(const ImageData& image, uint64_t contentHash);
+
+		template<typename T>
+		struct AsyncLoad {
+			std::promise<T*> promise;
+			std::shared_future<T*> future;
+		};
+
+		void startAsyncLoads(FveDevice& device);
+		void createAsyncAsset(FveDevice& device, ImportedAsset& imported);
+
+		// find or create the resource for the content and point the id at it; a null upload queue uploads synchronously
+		Mesh* storeMesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint64_t contentHash, const std::string& meshId, FveUploadQueue* queue);
+		Texture* storeTexture(FveDevice& device, const ImageData& image, uint64_t contentHash, const std::string& textureId, FveUploadQueue* queue);
+
+		// hot reload of a single id, splitting it off resources it shares with other ids
+		void reloadMesh(FveDevice& device, const std::string& meshId, const Mesh::Builder& builder);
+		void reloadTexture(FveDevice& device, const std::string& textureId, const ImageData& image);
+		void releaseUnusedMesh(ContentKey key);
+		void releaseUnusedTexture(FveDevice& device, ContentKey key);
+		void updateTextureSlots(ContentKey key);
+
+		// runs on the watcher thread
+		void onAssetFileChanged(const std::string& filePath);
+
+
+		// created with the first mesh, declared before meshes so it outlives them
+		std::unique_ptr<FveMeshArena> meshArena;
+		FveMeshArena* getMeshArena(FveDevice& device);
+
 		std::unordered_map<std::string, Material> materials;
-		std::unordered_map<std::string, Mesh> meshes;
+		// GPU resources are keyed by content, ids are aliases onto them
+		std::unordered_map<ContentKey, Mesh, ContentKeyHash> meshes;
+		std::unordered_map<std::string, ContentKey> meshAliases;
+		std::unordered_set<std::string> occluderMeshIds;
 
 		std::unordered_map<std::string, FveModel> models;
 
-		std::unordered_map<std::string, Texture> textures;
+		std::unordered_map<ContentKey, Texture, ContentKeyHash> textures;
+		std::unordered_map<std::string, ContentKey> textureAliases;
+		// one slot per texture id holding a copy of its shared Texture, handed out as TextureHandles
+		FvePool<Texture> textureSlots;
+		std::unordered_map<std::string, TextureHandle> textureHandles;
+
+		DeduplicationStats deduplicationStats;
 
 		std::unordered_map<std::string, VkSampler> samplers;
+
+		// hot reload bookkeeping, shared with the watcher thread
+		std::mutex reloadMutex;
+		std::unordered_multimap<std::string, std::string> meshSources;
+		std::unordered_multimap<std::string, std::string> textureSources;
+		std::unordered_multimap<std::string, FvePipeline*> shaderPipelines;
+		std::vector<ImportedAsset> pendingReloads;
+
+		std::vector<ReloadListener> reloadListeners;
+		std::unique_ptr<FveAssetWatcher> watcher;
+
+		// async loading runs on fveJobs; the load maps and upload queue are main thread only
+		std::unique_ptr<FveUploadQueue> uploadQueue;
+		std::unordered_map<std::string, AsyncLoad<Mesh>> meshLoads;
+		std::unordered_map<std::string, AsyncLoad<Texture>> textureLoads;
+		size_t importsInFlight = 0;
+
+		std::mutex importMutex;
+		std::condition_variable importReady;
+		std::vector<ImportedAsset> importedAssets;
 	};
 
 	extern FveAssets fveAssets;
@@ -0,0 +1,131 @@
+#include "fve_bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fve {
+
+	Aabb Aabb::transformed(const glm::mat4& matrix) const {
+
+		// Arvo: project the extents onto every axis of the transformed frame
+		glm::vec3 c = center();
+		glm::vec3 e = extents();
+
+		glm::vec3 newCenter = glm::vec3(matrix[3]) + glm::vec3(matrix[0]) * c.x + glm::vec3(matrix[1]) * c.y + glm::vec3(matrix[2]) * c.z;
+		glm::vec3 newExtents = glm::abs(glm::vec3(matrix[0])) * e.x + glm::abs(glm::vec3(matrix[1])) * e.y + glm::abs(glm::vec3(matrix[2])) * e.z;
+
+		return Aabb{ newCenter - newExtents, newCenter + newExtents };
+
+	}
+
+	bool Sphere::overlaps(const Aabb& box) const {
+		glm::vec3 closest = glm::clamp(center, box.min, box.max);
+		glm::vec3 d = closest - center;
+		return glm::dot(d, d) <= radius * radius;
+	}
+
+	float Ray::intersect(const Aabb& box, float limit) const {
+
+		// slab test; a zero direction component divides to infinity, which the min/max below handle
+		float tMin = 0.0f;
+		float tMax = limit;
+		for (int axis = 0; axis < 3; axis++) {
+			float inverse = 1.0f / direction[axis];
+			float t0 = (box.min[axis] - origin[axis]) * inverse;
+			float t1 = (box.max[axis] - origin[axis]) * inverse;
+			if (t0 > t1) std::swap(t0, t1);
+
+			// parallel to the slab and outside of it
+			if (std::isnan(t0) || std::isnan(t1)) {
+				if (origin[axis] < box.min[axis] || origin[axis] > box.max[axis]) return -1.0f;
+				continue;
+			}
+
+			tMin = std::max(tMin, t0);
+			tMax = std::min(tMax, t1);
+			if (tMin > tMax) return -1.0f;
+		}
+		return tMin;
+
+	}
+
+	Frustum Frustum::fromMatrix(const glm::mat4& m) {
+
+		// rows of the column major matrix
+		glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+		glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+		glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+		glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+		Frustum frustum;
+		frustum.planes[0] = row3 + row0; // left
+		frustum.planes[1] = row3 - row0; // right
+		frustum.planes[2] = row3 + row1; // top or bottom, depending on the y flip
+		frustum.planes[3] = row3 - row1;
+		frustum.planes[4] = row2;        // near, z from zero
+		frustum.planes[5] = row3 - row2; // far
+
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+
+	}
+
+	Containment Frustum::classify(const Aabb& box) const {
+
+		glm::vec3 c = box.center();
+		glm::vec3 e = box.extents();
+
+		Containment result = Containment::Inside;
+		for (const auto& plane : planes) {
+			glm::vec3 normal{ plane };
+			float distance = glm::dot(normal, c) + plane.w;
+			float radius = glm::dot(glm::abs(normal), e);
+
+			if (distance < -radius) return Containment::Outside;
+			if (distance < radius) result = Containment::Intersecting;
+		}
+		return result;
+
+	}
+
+	Aabb Frustum::bounds() const {
+
+		const float limit = std::numeric_limits<float>::max();
+
+		// every corner is where a side, a top or bottom and the near or far plane meet
+		Aabb box;
+		for (int corner = 0; corner < 8; corner++) {
+			const glm::vec4& a = planes[(corner & 1) ? 1 : 0];
+			const glm::vec4& b = planes[(corner & 2) ? 3 : 2];
+			const glm::vec4& c = planes[(corner & 4) ? 5 : 4];
+
+			glm::vec3 bc = glm::cross(glm::vec3(b), glm::vec3(c));
+			float determinant = glm::dot(glm::vec3(a), bc);
+			glm::vec3 point = -(a.w * bc + b.w * glm::cross(glm::vec3(c), glm::vec3(a)) + c.w * glm::cross(glm::vec3(a), glm::vec3(b))) / determinant;
+
+			if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+				return Aabb{ glm::vec3(-limit), glm::vec3(limit) };
+			}
+			box.min = glm::min(box.min, point);
+			box.max = glm::max(box.max, point);
+		}
+		return box;
+
+	}
+
+	Containment Frustum::classify(const Sphere& sphere) const {
+
+		Containment result = Containment::Inside;
+		for (const auto& plane : planes) {
+			float distance = glm::dot(glm::vec3(plane), sphere.center) + plane.w;
+
+			if (distance < -sphere.radius) return Containment::Outside;
+			if (distance < sphere.radius) result = Containment::Intersecting;
+		}
+		return result;
+
+	}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <limits>
+
+namespace fve {
+
+	struct Aabb {
+		glm::vec3 min{ std::numeric_limits<float>::max() };
+		glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+		glm::vec3 center() const { return (min + max) * 0.5f; }
+		glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+		// cost metric of the tree builders
+		float surfaceArea() const {
+			glm::vec3 d = max - min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		bool contains(const Aabb& other) const {
+			return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+				&& other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+		}
+
+		bool overlaps(const Aabb& other) const {
+			return min.x <= other.max.x && other.min.x <= max.x
+				&& min.y <= other.max.y && other.min.y <= max.y
+				&& min.z <= other.max.z && other.min.z <= max.z;
+		}
+
+		Aabb expanded(float margin) const { return Aabb{ min - glm::vec3(margin), max + glm::vec3(margin) }; }
+
+		static Aabb merge(const Aabb& a, const Aabb& b) { return Aabb{ glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+
+		// bounds of this box after an affine transform, tight for the box itself
+		Aabb transformed(const glm::mat4& matrix) const;
+	};
+
+	struct Sphere {
+		glm::vec3 center{};
+		float radius = 0.0f;
+
+		bool overlaps(const Aabb& box) const;
+	};
+
+	struct Ray {
+		glm::vec3 origin{};
+		glm::vec3 direction{ 0.0f, 0.0f, 1.0f }; // normalized
+		float maxDistance = std::numeric_limits<float>::max();
+
+		// distance along the ray where it enters box, negative on a miss
+		float intersect(const Aabb& box, float limit) const;
+	};
+
+	enum class Containment { Outside, Intersecting, Inside };
+
+	// six inward facing planes, xyz the normal and w the distance
+	struct Frustum {
+		std::array<glm::vec4, 6> planes;
+
+		// Gribb/Hartmann extraction from projection * view, for the zero to one depth range
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+		Containment classify(const Aabb& box) const;
+		Containment classify(const Sphere& sphere) const;
+
+		// box around the eight corners, unbounded when the planes don't close (an infinite far plane)
+		Aabb bounds() const;
+	};
+
+}
@@ -1,4 +1,6 @@
-#include "fve_game_object.hpp"
+#include "fve_components.hpp"
+
+#include <glm/gtc/constants.hpp>
 
 namespace fve {
 
@@ -59,13 +61,22 @@ namespace fve {
             }};
     }
 
-    FveGameObject FveGameObject::makePointLight(float lightIntensity, float radius, glm::vec3 color) {
-        FveGameObject gameObj = FveGameObject::createGameObject();
-        gameObj.color = color;
-        gameObj.transform.scale.x = radius;
-        gameObj.pointLight = std::make_unique<PointLightComponent>();
-        gameObj.pointLight->lightIntensity = lightIntensity;
-        return gameObj;
+    TransformComponent interpolateTransform(const TransformComponent& from, const TransformComponent& to, float alpha) {
+        // angles may have wrapped between the steps, blend over the smaller difference
+        glm::vec3 turn = to.rotation - from.rotation;
+        turn -= glm::two_pi<float>() * glm::floor((turn + glm::pi<float>()) / glm::two_pi<float>());
+
+        TransformComponent blended = to;
+        blended.translation = glm::mix(from.translation, to.translation, alpha);
+        blended.rotation = from.rotation + turn * alpha;
+        blended.scale = glm::mix(from.scale, to.scale, alpha);
+        return blended;
+    }
+
+    Entity createPointLight(FveWorld& world, float lightIntensity, float radius, glm::vec3 color) {
+        TransformComponent transform{};
+        transform.scale.x = radius;
+        return world.createEntity(transform, ColorComponent{ color }, PointLightComponent{ lightIntensity }, InterpolationComponent{ transform });
     }
 
 }
\ No newline at end of file
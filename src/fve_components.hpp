@@ -0,0 +1,97 @@
+#pragma once
+
+#include "fve_model.hpp"
+#include "fve_ecs.hpp"
+#include "fve_aabb_tree.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace fve {
+
+	// local transform, relative to the parent if the entity has a ParentComponent
+	struct TransformComponent {
+		glm::vec3 translation{};
+		glm::vec3 scale{1.0f, 1.0f, 1.0f};
+		glm::vec3 rotation{};
+
+		// set whenever the local transform changes, cleared by the transform system once the world matrices are rebuilt.
+		// write through the setters, or call markDirty() after touching the fields directly
+		bool dirty = true;
+
+		void setTranslation(const glm::vec3& value) { translation = value; dirty = true; }
+		void setRotation(const glm::vec3& value) { rotation = value; dirty = true; }
+		void setScale(const glm::vec3& value) { scale = value; dirty = true; }
+		void markDirty() { dirty = true; }
+
+        // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
+        // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
+        // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+		glm::mat4 mat4();
+		glm::mat3 normalMatrix();
+	};
+
+	// cached results of the transform hierarchy, this is what rendering reads
+	struct WorldTransformComponent {
+		glm::mat4 matrix{ 1.0f };
+		glm::mat4 normalMatrix{ 1.0f };
+
+		// frame the matrices were last rebuilt on, so children know to follow
+		uint64_t changedFrame = 0;
+	};
+
+	// the local transform as of the previous fixed simulation step; entities with one are drawn
+	// blended from it towards TransformComponent, so motion stays smooth between steps
+	struct InterpolationComponent {
+		TransformComponent previous{};
+
+		// the world matrices were last built from a blend rather than the current transform
+		bool blended = false;
+	};
+
+	// blends two local transforms, rotations along the shorter way around
+	TransformComponent interpolateTransform(const TransformComponent& from, const TransformComponent& to, float alpha);
+
+	// attaches an entity to another one, use TransformSystem::setParent so the traversal order is rebuilt
+	struct ParentComponent {
+		Entity parent = NULL_ENTITY;
+	};
+
+	struct ColorComponent {
+		glm::vec3 color{};
+	};
+
+	struct ModelComponent {
+		FveModel* model = nullptr;
+	};
+
+	struct PointLightComponent {
+		float lightIntensity = 1.0f;
+	};
+
+	// handle into FveAssets' texture slots, resolve with fveAssets.getTexture(handle)
+	struct TextureComponent {
+		TextureHandle texture;
+	};
+
+	// Tree suits mostly static objects, Grid objects that move every frame
+	enum class SpatialIndex { Tree, Grid };
+
+	// world space bounds and the entity's proxy in its spatial index, maintained by the spatial system.
+	// added automatically with the tree index; add it yourself at creation to pick the grid
+	struct BoundsComponent {
+		SpatialIndex index = SpatialIndex::Tree;
+		Aabb worldBounds;
+		int32_t proxy = FveAabbTree::NULL_NODE;
+		uint64_t syncedFrame = 0;
+
+		// inside the camera frustum this frame, written by the culling system
+		bool visible = true;
+	};
+
+	// marks a model whose triangles are rasterized into the occlusion buffer; pick large, simple, solid meshes
+	struct OccluderComponent {};
+
+	// transform, color and point light with the given intensity, sized by radius
+	Entity createPointLight(FveWorld& world, float lightIntensity = 10.0f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.0f));
+
+}
\ No newline at end of file
@@ -1,8 +1,24 @@
 #pragma once
 
+#include <cstdint>
+
 namespace fve {
 
 	const int WIDTH = 1920;
 	const int HEIGHT = 1080;
 
+	// fixed simulation steps per second, independent of how often frames are drawn
+	const float SIMULATION_RATE = 60.0f;
+	// steps a single frame may catch up on before the rest of the lag is dropped
+	const unsigned int MAX_SIMULATION_STEPS = 4;
+	// frames drawn per second at most, 0 leaves it to the swap chain's present mode
+	const float MAX_FRAME_RATE = 0.0f;
+
+	// loaded instead of the built in scene when it exists, F5 saves the running world over it
+	const char* const SCENE_PATH = "default.fvescene";
+
+	// room in the shared mesh buffers, meshes past it get buffers of their own
+	const uint32_t MESH_ARENA_VERTICES = 1u << 19;
+	const uint32_t MESH_ARENA_INDICES = 1u << 21;
+
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "fve_culling.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FVE_CULL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace fve {
+
+	static bool& visibleAt(const CullOutput& output, size_t index) {
+		return *reinterpret_cast<bool*>(reinterpret_cast<char*>(output.visible) + index * output.stride);
+	}
+
+#ifdef FVE_CULL_SSE2
+
+	namespace {
+
+		// planes splatted once per batch; the box test also needs |normal|
+		struct PlaneLanes {
+			__m128 x[6], y[6], z[6], w[6];
+			__m128 absX[6], absY[6], absZ[6];
+
+			explicit PlaneLanes(const Frustum& frustum) {
+				for (int i = 0; i < 6; i++) {
+					const glm::vec4& plane = frustum.planes[i];
+					x[i] = _mm_set1_ps(plane.x);
+					y[i] = _mm_set1_ps(plane.y);
+					z[i] = _mm_set1_ps(plane.z);
+					w[i] = _mm_set1_ps(plane.w);
+					absX[i] = _mm_set1_ps(std::abs(plane.x));
+					absY[i] = _mm_set1_ps(std::abs(plane.y));
+					absZ[i] = _mm_set1_ps(std::abs(plane.z));
+				}
+			}
+		};
+
+		inline __m128 gather4(const float* base, size_t i, size_t stride) {
+			return _mm_setr_ps(base[i * stride], base[(i + 1) * stride], base[(i + 2) * stride], base[(i + 3) * stride]);
+		}
+
+		// lanes set in the returned mask are visible
+		inline int storeVisible(const CullOutput& output, size_t i, __m128 outside) {
+			int outsideBits = _mm_movemask_ps(outside);
+			int visible = 0;
+			for (int lane = 0; lane < 4; lane++) {
+				bool laneVisible = (outsideBits & (1 << lane)) == 0;
+				visibleAt(output, i + lane) = laneVisible;
+				visible += laneVisible;
+			}
+			return visible;
+		}
+
+	}
+
+#endif
+
+	size_t cullBoxes(const Frustum& frustum, const CullBoxInput& input, size_t count, const CullOutput& output) {
+
+		size_t visible = 0;
+		size_t i = 0;
+
+#ifdef FVE_CULL_SSE2
+		const PlaneLanes planes{ frustum };
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 minX = gather4(input.min + 0, i, input.stride);
+			__m128 minY = gather4(input.min + 1, i, input.stride);
+			__m128 minZ = gather4(input.min + 2, i, input.stride);
+			__m128 maxX = gather4(input.max + 0, i, input.stride);
+			__m128 maxY = gather4(input.max + 1, i, input.stride);
+			__m128 maxZ = gather4(input.max + 2, i, input.stride);
+
+			__m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+			__m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+			__m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+			__m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+			__m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+			__m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+			// outside once the box is entirely behind any plane: distance + projected radius < 0
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], centerX), _mm_mul_ps(planes.y[p], centerY)),
+					_mm_add_ps(_mm_mul_ps(planes.z[p], centerZ), planes.w[p]));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.absX[p], extentX), _mm_mul_ps(planes.absY[p], extentY)),
+					_mm_mul_ps(planes.absZ[p], extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			visible += storeVisible(output, i, outside);
+		}
+#endif
+
+		for (; i < count; i++) {
+			const float* min = input.min + i * input.stride;
+			const float* max = input.max + i * input.stride;
+			Aabb box{ glm::vec3(min[0], min[1], min[2]), glm::vec3(max[0], max[1], max[2]) };
+
+			bool boxVisible = frustum.classify(box) != Containment::Outside;
+			visibleAt(output, i) = boxVisible;
+			visible += boxVisible;
+		}
+
+		return visible;
+
+	}
+
+	size_t cullSpheres(const Frustum& frustum, const CullSphereInput& input, size_t count, const CullOutput& output) {
+
+		size_t visible = 0;
+		size_t i = 0;
+
+#ifdef FVE_CULL_SSE2
+		const PlaneLanes planes{ frustum };
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 centerX = gather4(input.center + 0, i, input.stride);
+			__m128 centerY = gather4(input.center + 1, i, input.stride);
+			__m128 centerZ = gather4(input.center + 2, i, input.stride);
+			__m128 radius = gather4(input.radius, i, input.stride);
+
+			__m128 outside = zero;
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes.x[p], centerX), _mm_mul_ps(planes.y[p], centerY)),
+					_mm_add_ps(_mm_mul_ps(planes.z[p], centerZ), planes.w[p]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			visible += storeVisible(output, i, outside);
+		}
+#endif
+
+		for (; i < count; i++) {
+			const float* center = input.center + i * input.stride;
+			Sphere sphere{ glm::vec3(center[0], center[1], center[2]), input.radius[i * input.stride] };
+
+			bool sphereVisible = frustum.classify(sphere) != Containment::Outside;
+			visibleAt(output, i) = sphereVisible;
+			visible += sphereVisible;
+		}
+
+		return visible;
+
+	}
+
+}
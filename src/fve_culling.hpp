@@ -0,0 +1,36 @@
+#pragma once
+
+#include "fve_bounds.hpp"
+
+#include <cstddef>
+
+namespace fve {
+
+	// Batched frustum tests over strided views, so they can read and write component arrays in place.
+	// Four objects per iteration against all six planes with SSE2 where available, a scalar loop
+	// otherwise; both give the same answers as Frustum::classify.
+
+	// strides are in floats, min/max/center point at the x of a vec3
+	struct CullBoxInput {
+		const float* min;
+		const float* max;
+		size_t stride;
+	};
+
+	struct CullSphereInput {
+		const float* center;
+		const float* radius;
+		size_t stride;
+	};
+
+	// stride in bytes
+	struct CullOutput {
+		bool* visible;
+		size_t stride;
+	};
+
+	// writes whether each object touches the frustum, returns how many do
+	size_t cullBoxes(const Frustum& frustum, const CullBoxInput& input, size_t count, const CullOutput& output);
+	size_t cullSpheres(const Frustum& frustum, const CullSphereInput& input, size_t count, const CullOutput& output);
+
+}
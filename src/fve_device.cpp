@@ -163,6 +163,34 @@ namespace fve {
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+		// GPU driven rendering needs indirect draws with a count buffer, optional so older drivers still run
+		VkPhysicalDeviceVulkan12Features supported12Features{};
+		supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supported12Features;
+		if (properties.apiVersion >= VK_API_VERSION_1_2) {
+			vkGetPhysicalDeviceFeatures2(physicalDevice_, &supportedFeatures);
+		}
+		else {
+			vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures.features);
+		}
+		// the CPU render queue merges its draws into multi draw indirect calls without a count buffer
+		multiDrawIndirectSupported =
+			supportedFeatures.features.multiDrawIndirect &&
+			supportedFeatures.features.drawIndirectFirstInstance;
+		indirectCountSupported = multiDrawIndirectSupported && supported12Features.drawIndirectCount;
+
+		VkPhysicalDeviceVulkan12Features enabled12Features{};
+		enabled12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		if (multiDrawIndirectSupported) {
+			deviceFeatures.multiDrawIndirect = VK_TRUE;
+			deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+		}
+		if (indirectCountSupported) {
+			enabled12Features.drawIndirectCount = VK_TRUE;
+		}
+
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
@@ -170,6 +198,7 @@ namespace fve {
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
+		createInfo.pNext = indirectCountSupported ? &enabled12Features : nullptr;
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
 		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -485,12 +514,12 @@ namespace fve {
 		vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 	}
 
-	void FveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+	void FveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 		VkBufferCopy copyRegion{};
 		copyRegion.srcOffset = 0;  // Optional
-		copyRegion.dstOffset = 0;  // Optional
+		copyRegion.dstOffset = dstOffset;
 		copyRegion.size = size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
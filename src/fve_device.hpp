@@ -63,7 +63,7 @@ namespace fve {
 
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
 		void copyBufferToImage(
 			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -74,6 +74,11 @@ namespace fve {
 			VmaAllocationInfo& allocInfo,
 			VkImage& image);
 
+		// vkCmdDrawIndexedIndirectCount with multi draw and firstInstance, what GPU culling needs
+		bool supportsIndirectCount() const { return indirectCountSupported; }
+		// vkCmdDrawIndexedIndirect with a draw count above one and firstInstance
+		bool supportsMultiDrawIndirect() const { return multiDrawIndirectSupported; }
+
 		VkPhysicalDeviceProperties properties;
 
 	private:
@@ -105,6 +110,9 @@ namespace fve {
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
 
+		bool indirectCountSupported = false;
+		bool multiDrawIndirectSupported = false;
+
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	};
@@ -0,0 +1,223 @@
+#include "fve_ecs.hpp"
+
+#include <stdexcept>
+
+namespace fve {
+
+	namespace ecs_detail {
+		uint32_t nextComponentTypeId() {
+			static uint32_t nextId = 0;
+			if (nextId >= MAX_COMPONENT_TYPES) {
+				throw std::runtime_error("too many component types!");
+			}
+			return nextId++;
+		}
+	}
+
+	FveWorld::FveWorld() {
+		// entities without any components live here
+		auto root = std::make_unique<Archetype>();
+		emptyArchetype = root.get();
+		archetypesByMask.emplace(0, emptyArchetype);
+		archetypes.push_back(std::move(root));
+	}
+
+	FveWorld::~FveWorld() {}
+
+	Entity FveWorld::createEntity() {
+		Entity entity = allocateEntity(emptyArchetype, emptyArchetype->size());
+		emptyArchetype->entities.push_back(entity);
+
+		return entity;
+	}
+
+	Entity FveWorld::allocateEntity(Archetype* archetype, size_t row) {
+
+		uint32_t index;
+		if (freeSlots.size() > MIN_FREE_SLOTS) {
+			index = freeSlots.front();
+			freeSlots.pop_front();
+		}
+		else {
+			if (records.size() > ENTITY_INDEX_MASK) {
+				throw std::runtime_error("too many entities!");
+			}
+			index = static_cast<uint32_t>(records.size());
+			records.emplace_back();
+		}
+
+		EntityRecord& record = records[index];
+		record.archetype = archetype;
+		record.row = row;
+		aliveCount++;
+
+		return makeEntity(index, record.generation);
+
+	}
+
+	FveWorld::EntityBlock FveWorld::createEntities(ComponentMask mask, size_t count) {
+
+		Archetype* archetype;
+		auto existing = archetypesByMask.find(mask);
+		if (existing != archetypesByMask.end()) {
+			archetype = existing->second;
+		}
+		else {
+			auto created = std::make_unique<Archetype>();
+			created->mask = mask;
+			for (uint32_t typeId = 0; typeId < MAX_COMPONENT_TYPES; typeId++) {
+				if ((mask & (ComponentMask{ 1 } << typeId)) == 0) continue;
+				if (columnPrototypes[typeId] == nullptr) {
+					throw std::runtime_error("createEntities with an unregistered component type");
+				}
+				created->columns[typeId] = columnPrototypes[typeId]->cloneEmpty();
+			}
+			archetype = registerArchetype(std::move(created));
+		}
+
+		EntityBlock block{ archetype, archetype->size(), count };
+
+		// one resize per column instead of a push per component
+		size_t size = block.firstRow + count;
+		for (auto& column : archetype->columns) {
+			if (column != nullptr) column->resize(size);
+		}
+		archetype->entities.resize(size);
+		records.reserve(records.size() + count);
+
+		for (size_t i = 0; i < count; i++) {
+			archetype->entities[block.firstRow + i] = allocateEntity(archetype, block.firstRow + i);
+		}
+		if (count > 0) bumpStructureVersions(mask);
+
+		return block;
+
+	}
+
+	void FveWorld::destroyEntity(Entity entity) {
+		assert(isAlive(entity) && "Entity is not alive");
+
+		uint32_t index = entityIndex(entity);
+		EntityRecord& record = records[index];
+		bumpStructureVersions(record.archetype->mask);
+		removeRow(record.archetype, record.row);
+		record.archetype = nullptr;
+		aliveCount--;
+
+		// handles to the old entity no longer match once the generation moves on
+		record.generation++;
+		if (record.generation < MAX_ENTITY_GENERATION) {
+			freeSlots.push_back(index);
+		}
+	}
+
+	bool FveWorld::isAlive(Entity entity) const {
+		uint32_t index = entityIndex(entity);
+		return index < records.size() && records[index].archetype != nullptr && records[index].generation == entityGeneration(entity);
+	}
+
+	Archetype* FveWorld::findOrCreateArchetype(ComponentMask mask, const Archetype* source, uint32_t changedType, std::unique_ptr<ComponentColumn> addedColumn) {
+
+		auto existing = archetypesByMask.find(mask);
+		if (existing != archetypesByMask.end()) {
+			return existing->second;
+		}
+
+		auto archetype = std::make_unique<Archetype>();
+		archetype->mask = mask;
+
+		for (uint32_t typeId = 0; typeId < MAX_COMPONENT_TYPES; typeId++) {
+			if (typeId == changedType) continue;
+			if (source->columns[typeId] != nullptr) {
+				archetype->columns[typeId] = source->columns[typeId]->cloneEmpty();
+			}
+		}
+		if (addedColumn != nullptr) {
+			archetype->columns[changedType] = std::move(addedColumn);
+		}
+
+		return registerArchetype(std::move(archetype));
+
+	}
+
+	Archetype* FveWorld::registerArchetype(std::unique_ptr<Archetype> archetype) {
+
+		Archetype* created = archetype.get();
+		archetypesByMask.emplace(created->mask, created);
+		archetypes.push_back(std::move(archetype));
+
+		// register with every query it satisfies, so queries never rescan the archetype list
+		for (auto& kv : queries) {
+			if (kv.second->matches(created->mask)) {
+				kv.second->archetypes.push_back(created);
+			}
+		}
+
+		return created;
+
+	}
+
+	QueryCache& FveWorld::findOrCreateQuery(ComponentMask include, ComponentMask exclude) {
+
+		// tasks running side by side look queries up, only structural changes must run alone
+		std::lock_guard<std::mutex> lock(queryMutex);
+
+		QueryKey key{ include, exclude };
+		auto existing = queries.find(key);
+		if (existing != queries.end()) {
+			return *existing->second;
+		}
+
+		auto cache = std::make_unique<QueryCache>();
+		cache->include = include;
+		cache->exclude = exclude;
+		for (auto& archetype : archetypes) {
+			if (cache->matches(archetype->mask)) {
+				cache->archetypes.push_back(archetype.get());
+			}
+		}
+
+		QueryCache& created = *cache;
+		queries.emplace(key, std::move(cache));
+		return created;
+
+	}
+
+	void FveWorld::moveEntity(Entity entity, Archetype* target) {
+
+		EntityRecord& record = records[entityIndex(entity)];
+		Archetype* source = record.archetype;
+		size_t row = record.row;
+		bumpStructureVersions(source->mask ^ target->mask);
+
+		for (uint32_t typeId = 0; typeId < MAX_COMPONENT_TYPES; typeId++) {
+			if (source->columns[typeId] != nullptr && target->columns[typeId] != nullptr) {
+				source->columns[typeId]->moveRowTo(row, *target->columns[typeId]);
+			}
+		}
+
+		removeRow(source, row);
+
+		record.archetype = target;
+		record.row = target->size();
+		target->entities.push_back(entity);
+
+	}
+
+	void FveWorld::removeRow(Archetype* archetype, size_t row) {
+
+		for (auto& column : archetype->columns) {
+			if (column != nullptr) column->swapRemove(row);
+		}
+
+		// the last entity was moved into row
+		Entity moved = archetype->entities.back();
+		archetype->entities[row] = moved;
+		archetype->entities.pop_back();
+		if (row < archetype->entities.size()) {
+			records[entityIndex(moved)].row = row;
+		}
+
+	}
+
+}
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fve {
+
+	// An entity is the index of its slot in the world's entity table plus the generation of that slot.
+	// Destroying an entity bumps the generation, so stale handles stop resolving and the slot can be
+	// handed out again. Handles stay 32 bit so they fit the spatial indices' user data.
+	using Entity = uint32_t;
+	constexpr Entity NULL_ENTITY = ~0u;
+
+	constexpr uint32_t ENTITY_INDEX_BITS = 22;
+	constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+	// slots are retired rather than wrapping back to a generation an old handle may still hold
+	constexpr uint32_t MAX_ENTITY_GENERATION = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+	constexpr uint32_t entityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+	constexpr uint32_t entityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+	constexpr Entity makeEntity(uint32_t index, uint32_t generation) { return (generation << ENTITY_INDEX_BITS) | index; }
+
+	// one bit per component type
+	using ComponentMask = uint64_t;
+	constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+
+	namespace ecs_detail {
+		uint32_t nextComponentTypeId();
+	}
+
+	template<typename T>
+	uint32_t componentTypeId() {
+		static const uint32_t id = ecs_detail::nextComponentTypeId();
+		return id;
+	}
+
+	template<typename... Ts>
+	ComponentMask componentMask() {
+		return (ComponentMask{ 0 } | ... | (ComponentMask{ 1 } << componentTypeId<Ts>()));
+	}
+
+	// marks component types a query must not match, e.g. query<ModelComponent>(Exclude<TextureComponent>{})
+	template<typename... Ts>
+	struct Exclude {};
+
+	// type erased, densely packed array holding one component type of an archetype
+	class ComponentColumn {
+	public:
+		virtual ~ComponentColumn() = default;
+
+		// a new, empty column of the same component type
+		virtual std::unique_ptr<ComponentColumn> cloneEmpty() const = 0;
+
+		// appends row to the end of dst, which must be a column of the same type
+		virtual void moveRowTo(size_t row, ComponentColumn& dst) = 0;
+
+		// removes row by moving the last element into it
+		virtual void swapRemove(size_t row) = 0;
+
+		virtual void reserve(size_t capacity) = 0;
+
+		// grows or shrinks to size rows, new rows are default constructed
+		virtual void resize(size_t size) = 0;
+	};
+
+	template<typename T>
+	class TypedColumn : public ComponentColumn {
+	public:
+		std::unique_ptr<ComponentColumn> cloneEmpty() const override {
+			return std::make_unique<TypedColumn<T>>();
+		}
+
+		void moveRowTo(size_t row, ComponentColumn& dst) override {
+			static_cast<TypedColumn<T>&>(dst).data.push_back(std::move(data[row]));
+		}
+
+		void swapRemove(size_t row) override {
+			if (row + 1 != data.size()) {
+				data[row] = std::move(data.back());
+			}
+			data.pop_back();
+		}
+
+		void reserve(size_t capacity) override {
+			data.reserve(capacity);
+		}
+
+		void resize(size_t size) override {
+			data.resize(size);
+		}
+
+		std::vector<T> data;
+	};
+
+	// all entities with exactly the same set of components, stored structure-of-arrays
+	struct Archetype {
+		ComponentMask mask = 0;
+		std::vector<Entity> entities;
+		std::array<std::unique_ptr<ComponentColumn>, MAX_COMPONENT_TYPES> columns{};
+
+		// cached transitions to the archetype with one component type added/removed
+		std::unordered_map<uint32_t, Archetype*> addEdges;
+		std::unordered_map<uint32_t, Archetype*> removeEdges;
+
+		size_t size() const { return entities.size(); }
+
+		template<typename T>
+		std::vector<T>& column() {
+			assert(columns[componentTypeId<T>()] != nullptr && "Archetype does not have this component");
+			return static_cast<TypedColumn<T>*>(columns[componentTypeId<T>()].get())->data;
+		}
+	};
+
+	// archetypes matching an include/exclude mask pair, kept up to date as archetypes are created
+	struct QueryCache {
+		ComponentMask include = 0;
+		ComponentMask exclude = 0;
+		std::vector<Archetype*> archetypes;
+
+		bool matches(ComponentMask mask) const {
+			return (mask & include) == include && (mask & exclude) == 0;
+		}
+	};
+
+	// typed view of a cached query; cheap to copy
+	template<typename... Ts>
+	class FveQuery {
+	public:
+		explicit FveQuery(QueryCache& cache) : cache{ &cache } {}
+
+		// f(Entity, Ts&...) for every matching entity; adding/removing components or entities inside f is not allowed
+		template<typename F>
+		void each(F&& f) {
+			for (Archetype* archetype : cache->archetypes) {
+				size_t count = archetype->size();
+				if (count == 0) continue;
+
+				const Entity* entities = archetype->entities.data();
+				auto columns = std::make_tuple(archetype->column<Ts>().data()...);
+				for (size_t i = 0; i < count; i++) {
+					f(entities[i], std::get<Ts*>(columns)[i]...);
+				}
+			}
+		}
+
+		// f(size_t count, const Entity* entities, Ts*... arrays) once per non-empty archetype, for batch kernels
+		template<typename F>
+		void eachChunk(F&& f) {
+			for (Archetype* archetype : cache->archetypes) {
+				size_t count = archetype->size();
+				if (count == 0) continue;
+
+				f(count, archetype->entities.data(), archetype->column<Ts>().data()...);
+			}
+		}
+
+		size_t count() const {
+			size_t total = 0;
+			for (Archetype* archetype : cache->archetypes) {
+				total += archetype->size();
+			}
+			return total;
+		}
+
+	private:
+		QueryCache* cache;
+	};
+
+	class FveWorld {
+	public:
+		FveWorld();
+		~FveWorld();
+
+		FveWorld(const FveWorld&) = delete;
+		FveWorld& operator=(const FveWorld&) = delete;
+
+		Entity createEntity();
+
+		// creates the entity straight in the archetype of its components, without moving it through the intermediate ones
+		template<typename... Ts>
+		Entity createEntity(Ts&&... components) {
+			Archetype* archetype = findOrCreateArchetype<std::decay_t<Ts>...>();
+
+			Entity entity = allocateEntity(archetype, archetype->size());
+			archetype->entities.push_back(entity);
+			(archetype->column<std::decay_t<Ts>>().push_back(std::forward<Ts>(components)), ...);
+			bumpStructureVersions(archetype->mask);
+
+			return entity;
+		}
+
+		// makes room for count more entities with exactly the components Ts, so spawning them doesn't allocate
+		template<typename... Ts>
+		void reserve(size_t count) {
+			Archetype* archetype = findOrCreateArchetype<Ts...>();
+			size_t capacity = archetype->size() + count;
+
+			for (auto& column : archetype->columns) {
+				if (column != nullptr) column->reserve(capacity);
+			}
+			archetype->entities.reserve(capacity);
+			records.reserve(records.size() + count);
+		}
+		// rows appended in one go by createEntities
+		struct EntityBlock {
+			Archetype* archetype = nullptr;
+			size_t firstRow = 0;
+			size_t count = 0;
+
+			// the block's rows of component T
+			template<typename T>
+			T* column() { return archetype->column<T>().data() + firstRow; }
+
+			const Entity* entities() const { return archetype->entities.data() + firstRow; }
+		};
+
+		// appends count entities with exactly the components in mask, every one of them registered. The rows
+		// are default constructed for the caller to overwrite, a whole column at a time
+		EntityBlock createEntities(ComponentMask mask, size_t count);
+
+		// makes T known by its type id, so archetypes holding it can be created from a mask alone
+		template<typename T>
+		void registerComponent() {
+			uint32_t typeId = componentTypeId<T>();
+			if (columnPrototypes[typeId] == nullptr) {
+				columnPrototypes[typeId] = std::make_unique<TypedColumn<T>>();
+			}
+		}
+
+		void destroyEntity(Entity entity);
+		bool isAlive(Entity entity) const;
+
+		size_t entityCount() const { return aliveCount; }
+
+		// changes whenever an entity gains or loses one of Ts, creation and destruction included, so a
+		// system caching something built from those components can tell when to rebuild it
+		template<typename... Ts>
+		uint64_t structureVersion() const {
+			return (uint64_t{ 0 } + ... + structureVersions[componentTypeId<Ts>()]);
+		}
+
+		// every archetype, empty ones included; for serialization
+		const std::vector<std::unique_ptr<Archetype>>& getArchetypes() const { return archetypes; }
+
+		template<typename T, typename... Args>
+		T& addComponent(Entity entity, Args&&... args) {
+			assert(isAlive(entity) && "Entity is not alive");
+			assert(!hasComponent<T>(entity) && "Entity already has this component");
+
+			uint32_t typeId = componentTypeId<T>();
+			EntityRecord& record = records[entityIndex(entity)];
+			Archetype* source = record.archetype;
+
+			Archetype* target;
+			auto edge = source->addEdges.find(typeId);
+			if (edge != source->addEdges.end()) {
+				target = edge->second;
+			}
+			else {
+				registerComponent<T>();
+				target = findOrCreateArchetype(source->mask | (ComponentMask{ 1 } << typeId), source, typeId, std::make_unique<TypedColumn<T>>());
+				source->addEdges[typeId] = target;
+			}
+
+			moveEntity(entity, target);
+
+			std::vector<T>& column = target->column<T>();
+			if constexpr (std::is_aggregate_v<T>) {
+				column.push_back(T{ std::forward<Args>(args)... });
+			}
+			else {
+				column.emplace_back(std::forward<Args>(args)...);
+			}
+			return column.back();
+		}
+
+		template<typename T>
+		void removeComponent(Entity entity) {
+			assert(hasComponent<T>(entity) && "Entity does not have this component");
+
+			uint32_t typeId = componentTypeId<T>();
+			Archetype* source = records[entityIndex(entity)].archetype;
+
+			Archetype* target;
+			auto edge = source->removeEdges.find(typeId);
+			if (edge != source->removeEdges.end()) {
+				target = edge->second;
+			}
+			else {
+				target = findOrCreateArchetype(source->mask & ~(ComponentMask{ 1 } << typeId), source, typeId, nullptr);
+				source->removeEdges[typeId] = target;
+			}
+
+			moveEntity(entity, target);
+		}
+
+		template<typename T>
+		bool hasComponent(Entity entity) const {
+			return isAlive(entity) && (records[entityIndex(entity)].archetype->mask & componentMask<T>()) != 0;
+		}
+
+		template<typename T>
+		T& getComponent(Entity entity) {
+			assert(hasComponent<T>(entity) && "Entity does not have this component");
+			const EntityRecord& record = records[entityIndex(entity)];
+			return record.archetype->column<T>()[record.row];
+		}
+
+		template<typename T>
+		T* tryGetComponent(Entity entity) {
+			if (!hasComponent<T>(entity)) return nullptr;
+			const EntityRecord& record = records[entityIndex(entity)];
+			return &record.archetype->column<T>()[record.row];
+		}
+
+		// entities with all of Ts; the archetype list is cached, so iteration only touches matching entities
+		template<typename... Ts>
+		FveQuery<Ts...> query() {
+			return FveQuery<Ts...>{ findOrCreateQuery(componentMask<Ts...>(), 0) };
+		}
+
+		// entities with all of Ts and none of Xs
+		template<typename... Ts, typename... Xs>
+		FveQuery<Ts...> query(Exclude<Xs...>) {
+			return FveQuery<Ts...>{ findOrCreateQuery(componentMask<Ts...>(), componentMask<Xs...>()) };
+		}
+
+	private:
+		// a slot of the entity table; archetype is null while the slot is free
+		struct EntityRecord {
+			Archetype* archetype = nullptr;
+			size_t row = 0;
+			uint32_t generation = 0;
+		};
+
+		// free slots are only reused once this many have piled up, oldest first, so a slot's
+		// generation climbs slowly even when entities are spawned and destroyed every frame
+		static constexpr size_t MIN_FREE_SLOTS = 1024;
+
+		struct QueryKey {
+			ComponentMask include;
+			ComponentMask exclude;
+			bool operator==(const QueryKey& other) const { return include == other.include && exclude == other.exclude; }
+		};
+
+		struct QueryKeyHash {
+			size_t operator()(const QueryKey& key) const {
+				return std::hash<ComponentMask>{}(key.include) ^ (std::hash<ComponentMask>{}(key.exclude) * 0x9e3779b97f4a7c15ull);
+			}
+		};
+
+		// source provides the column types; addedColumn is the new type's column when adding, null when removing changedType
+		Archetype* findOrCreateArchetype(ComponentMask mask, const Archetype* source, uint32_t changedType, std::unique_ptr<ComponentColumn> addedColumn);
+
+		// archetype with exactly the components Ts
+		template<typename... Ts>
+		Archetype* findOrCreateArchetype() {
+			ComponentMask mask = componentMask<Ts...>();
+			assert(static_cast<size_t>(std::popcount(mask)) == sizeof...(Ts) && "Component types must be unique");
+
+			auto existing = archetypesByMask.find(mask);
+			if (existing != archetypesByMask.end()) {
+				return existing->second;
+			}
+
+			(registerComponent<Ts>(), ...);
+			auto archetype = std::make_unique<Archetype>();
+			archetype->mask = mask;
+			((archetype->columns[componentTypeId<Ts>()] = std::make_unique<TypedColumn<Ts>>()), ...);
+			return registerArchetype(std::move(archetype));
+		}
+
+		Archetype* registerArchetype(std::unique_ptr<Archetype> archetype);
+		QueryCache& findOrCreateQuery(ComponentMask include, ComponentMask exclude);
+
+		// moves the entity's shared components into target; components target lacks are dropped
+		void moveEntity(Entity entity, Archetype* target);
+		void removeRow(Archetype* archetype, size_t row);
+
+		void bumpStructureVersions(ComponentMask changed) {
+			for (; changed != 0; changed &= changed - 1) {
+				structureVersions[std::countr_zero(changed)]++;
+			}
+		}
+
+		// takes a free slot or appends one, the caller adds the entity to the archetype
+		Entity allocateEntity(Archetype* archetype, size_t row);
+
+		std::vector<EntityRecord> records;
+		std::deque<uint32_t> freeSlots;
+		size_t aliveCount = 0;
+
+		std::vector<std::unique_ptr<Archetype>> archetypes;
+		std::unordered_map<ComponentMask, Archetype*> archetypesByMask;
+		Archetype* emptyArchetype;
+
+		// an empty column of every component type seen so far, indexed by type id
+		std::array<std::unique_ptr<ComponentColumn>, MAX_COMPONENT_TYPES> columnPrototypes{};
+
+		// per component type, counts the entities that gained or lost it
+		std::array<uint64_t, MAX_COMPONENT_TYPES> structureVersions{};
+
+		std::unordered_map<QueryKey, std::unique_ptr<QueryCache>, QueryKeyHash> queries;
+		std::mutex queryMutex;
+	};
+
+}
@@ -0,0 +1,201 @@
+#include "fve_frame_commands.hpp"
+
+#include "fve_job_system.hpp"
+#include "fve_utils.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace fve {
+
+	FveFrameCommands::FveFrameCommands(FveDevice& device, size_t threadCount) : device{ device } {
+
+		// transient, and reset as a whole rather than per buffer
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (Frame& frame : frames) {
+			frame.threads.resize(threadCount);
+			for (ThreadPool& thread : frame.threads) {
+				if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &thread.pool) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create command pool!");
+				}
+			}
+
+			VkCommandPoolCreateInfo retainedPoolInfo = poolInfo;
+			retainedPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			if (vkCreateCommandPool(device.device(), &retainedPoolInfo, nullptr, &frame.retainedPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create command pool!");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = frame.threads[0].pool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &frame.primary) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate command buffers!");
+			}
+		}
+
+	}
+
+	FveFrameCommands::~FveFrameCommands() {
+		// destroying a pool frees its buffers
+		for (Frame& frame : frames) {
+			for (ThreadPool& thread : frame.threads) {
+				vkDestroyCommandPool(device.device(), thread.pool, nullptr);
+			}
+			vkDestroyCommandPool(device.device(), frame.retainedPool, nullptr);
+		}
+	}
+
+	VkCommandBuffer FveFrameCommands::beginFrame(int newFrameIndex) {
+
+		frameIndex = newFrameIndex;
+		Frame& frame = frames[frameIndex];
+		for (ThreadPool& thread : frame.threads) {
+			vkResetCommandPool(device.device(), thread.pool, 0);
+			thread.used = 0;
+		}
+		slots.clear();
+		return frame.primary;
+
+	}
+
+	void FveFrameCommands::beginPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D passExtent) {
+
+		inheritance = VkCommandBufferInheritanceInfo{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = renderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = framebuffer;
+		extent = passExtent;
+		slots.clear();
+
+	}
+
+	uint32_t FveFrameCommands::reserve(uint32_t count) {
+		uint32_t first = static_cast<uint32_t>(slots.size());
+		slots.resize(slots.size() + count, VK_NULL_HANDLE);
+		return first;
+	}
+
+	VkCommandBuffer FveFrameCommands::begin(uint32_t slot) {
+
+		assert(slot < slots.size() && "Recording into a slot that was not reserved");
+		int threadIndex = fveJobs.currentIndex();
+		assert(threadIndex >= 0 && "Secondary command buffers are recorded on the main thread or a job system worker");
+		ThreadPool& thread = frames[frameIndex].threads[threadIndex];
+
+		if (thread.used == thread.secondaries.size()) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = thread.pool;
+			allocInfo.commandBufferCount = 1;
+			VkCommandBuffer allocated;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &allocated) != VK_SUCCESS) {
+				failed.store(true, std::memory_order_relaxed);
+				return VK_NULL_HANDLE;
+			}
+			thread.secondaries.push_back(allocated);
+		}
+		VkCommandBuffer commandBuffer = beginSecondary(thread.secondaries[thread.used++],
+			VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, inheritance);
+		slots[slot] = commandBuffer;
+		return commandBuffer;
+
+	}
+
+	VkCommandBuffer FveFrameCommands::beginRetained(uint32_t slot, FveRetainedCommands& retained, uint64_t key) {
+
+		assert(slot < slots.size() && "Recording into a slot that was not reserved");
+		assert(fveJobs.currentIndex() == 0 && "Retained secondaries are recorded on the main thread");
+
+		// the viewport is baked in and the render pass may have been recreated, never store 0
+		uint64_t fullKey = fnv1a64(&retainedGeneration, sizeof(retainedGeneration), key);
+		fullKey = fnv1a64(&inheritance.renderPass, sizeof(inheritance.renderPass), fullKey);
+		fullKey = fnv1a64(&extent, sizeof(extent), fullKey) | 1;
+
+		VkCommandBuffer& commandBuffer = retained.buffers[frameIndex];
+		if (commandBuffer != VK_NULL_HANDLE && retained.keys[frameIndex] == fullKey) {
+			slots[slot] = commandBuffer;
+			return VK_NULL_HANDLE;
+		}
+
+		if (commandBuffer == VK_NULL_HANDLE) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = frames[frameIndex].retainedPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+				commandBuffer = VK_NULL_HANDLE;
+				throw std::runtime_error("failed to allocate command buffers!");
+			}
+		}
+
+		// replayed with every swap chain image, so the framebuffer is left unknown
+		VkCommandBufferInheritanceInfo retainedInheritance = inheritance;
+		retainedInheritance.framebuffer = VK_NULL_HANDLE;
+		retained.keys[frameIndex] = 0;
+		if (beginSecondary(commandBuffer, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, retainedInheritance) == VK_NULL_HANDLE) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		retained.keys[frameIndex] = fullKey;
+
+		slots[slot] = commandBuffer;
+		return commandBuffer;
+
+	}
+
+	VkCommandBuffer FveFrameCommands::beginSecondary(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags, const VkCommandBufferInheritanceInfo& inheritanceInfo) {
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = flags;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			failed.store(true, std::memory_order_relaxed);
+			return VK_NULL_HANDLE;
+		}
+
+		// dynamic state is not inherited from the primary
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		return commandBuffer;
+
+	}
+
+	void FveFrameCommands::end(VkCommandBuffer commandBuffer) {
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			failed.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	void FveFrameCommands::execute(VkCommandBuffer primary) {
+
+		if (failed.exchange(false)) {
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+
+		// slots nobody recorded into, say a render queue chunk with nothing in it, are left out
+		std::vector<VkCommandBuffer>::iterator last = slots.begin();
+		for (VkCommandBuffer commandBuffer : slots) {
+			if (commandBuffer != VK_NULL_HANDLE) *last++ = commandBuffer;
+		}
+		slots.erase(last, slots.end());
+
+		if (!slots.empty()) {
+			vkCmdExecuteCommands(primary, static_cast<uint32_t>(slots.size()), slots.data());
+		}
+		slots.clear();
+
+	}
+
+}
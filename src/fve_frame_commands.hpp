@@ -0,0 +1,91 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_swap_chain.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace fve {
+
+	// A secondary per frame in flight that is kept across frames and replayed for as long as the
+	// content it was recorded from stays the same. Owned by whoever records it, see beginRetained.
+	struct FveRetainedCommands {
+		std::array<VkCommandBuffer, FveSwapChain::MAX_FRAMES_IN_FLIGHT> buffers{};
+		// what each was recorded with, 0 when it has to be recorded again
+		std::array<uint64_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> keys{};
+	};
+
+	// Command pools per job system thread and frame in flight. A frame's pools are reset wholesale
+	// once its fence has been waited on, so nothing is freed or reset one buffer at a time. The main
+	// thread's pool also holds the frame's primary. Everything inside the swap chain render pass is
+	// recorded into secondaries that inherit it: slots are reserved on the main thread in the order
+	// the primary should execute them, then any job system thread can record into them.
+	class FveFrameCommands {
+	public:
+		FveFrameCommands(FveDevice& device, size_t threadCount);
+		~FveFrameCommands();
+
+		FveFrameCommands(const FveFrameCommands&) = delete;
+		FveFrameCommands& operator=(const FveFrameCommands&) = delete;
+
+		// resets the frame's pools and forgets the last pass's secondaries
+		VkCommandBuffer beginFrame(int frameIndex);
+
+		// what the secondaries of the next pass inherit
+		void beginPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+
+		// count slots after every slot reserved so far in this pass, returns the first; main thread only
+		uint32_t reserve(uint32_t count);
+
+		// begins the slot's secondary from the calling thread's pool with viewport and scissor set, or
+		// returns VK_NULL_HANDLE if that failed; from the main thread or a job system worker
+		VkCommandBuffer begin(uint32_t slot);
+		void end(VkCommandBuffer commandBuffer);
+
+		// Puts retained's secondary for this frame in the slot. If it was recorded with key since the
+		// last invalidation it is replayed as is and VK_NULL_HANDLE is returned, otherwise it is begun
+		// for recording again and ended with end(). Everything that changes while it is replayed has
+		// to reach the GPU through buffers or descriptors. Main thread only, the retained
+		// secondaries of a frame share one pool.
+		VkCommandBuffer beginRetained(uint32_t slot, FveRetainedCommands& retained, uint64_t key);
+
+		// drops every retained secondary, when something they reference was destroyed or rewritten
+		// such as a pipeline, a buffer or a descriptor set
+		void invalidateRetained() { retainedGeneration++; }
+
+		// executes the pass's recorded secondaries in slot order; throws if any failed to record
+		void execute(VkCommandBuffer primary);
+
+	private:
+		struct ThreadPool {
+			VkCommandPool pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> secondaries;
+			// handed out since the last reset
+			size_t used = 0;
+		};
+
+		struct Frame {
+			// one per job system thread, index 0 is the main thread
+			std::vector<ThreadPool> threads;
+			VkCommandBuffer primary = VK_NULL_HANDLE;
+			// never reset as a whole, its buffers are re-recorded one at a time
+			VkCommandPool retainedPool = VK_NULL_HANDLE;
+		};
+
+		VkCommandBuffer beginSecondary(VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags flags, const VkCommandBufferInheritanceInfo& inheritanceInfo);
+
+		FveDevice& device;
+		std::array<Frame, FveSwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+		int frameIndex = 0;
+
+		VkCommandBufferInheritanceInfo inheritance{};
+		VkExtent2D extent{};
+		std::vector<VkCommandBuffer> slots;
+		std::atomic<bool> failed{ false };
+		uint64_t retainedGeneration = 1;
+	};
+
+}
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "fve_camera.hpp"
-#include "fve_game_object.hpp"
+#include "fve_components.hpp"
+#include "fve_frame_commands.hpp"
 
 #include <vulkan/vulkan.h>
 
@@ -39,11 +40,15 @@ namespace fve {
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
+		// how far between the previous and the latest simulation step this frame is drawn
+		float alpha;
 		VkCommandBuffer commandBuffer;
 		FveCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		VkDescriptorSet texturedDescriptorSet;
-		FveGameObject::Map& gameObjects;
+		FveWorld& world;
+		// secondaries of the swap chain render pass, commandBuffer is the primary outside of it
+		FveFrameCommands& commands;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "fve_instance_buffer.hpp"
+
+#include "fve_memory.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace fve {
+
+	FveInstanceBuffer::FveInstanceBuffer(FveDevice& device, uint32_t initialCapacity) : device{ device } {
+		capacities.fill(std::max<uint32_t>(initialCapacity, 1));
+	}
+
+	void FveInstanceBuffer::addVertexInput(PipelineConfigInfo& configInfo) {
+
+		configInfo.bindingDescriptions.push_back({ INSTANCE_BINDING, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+
+		// a mat4 attribute takes one location per column
+		for (uint32_t column = 0; column < 4; column++) {
+			uint32_t offset = column * sizeof(glm::vec4);
+			configInfo.attributeDescriptions.push_back({ 4 + column, INSTANCE_BINDING, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, modelMatrix)) + offset });
+			configInfo.attributeDescriptions.push_back({ 8 + column, INSTANCE_BINDING, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, normalMatrix)) + offset });
+		}
+
+	}
+
+	InstanceData* FveInstanceBuffer::map(int frameIndex, uint32_t count) {
+
+		// this frame's buffer was last read by the GPU before its fence was waited on
+		uint32_t& capacity = capacities[frameIndex];
+		std::unique_ptr<FveBuffer>& buffer = buffers[frameIndex];
+		if (buffer == nullptr || count > capacity) {
+			while (capacity < count) capacity *= 2;
+			buffer = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(InstanceData), capacity,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "instanceBuffer");
+			buffer->map();
+			generations[frameIndex]++;
+		}
+		return static_cast<InstanceData*>(buffer->getMappedMemory());
+
+	}
+
+	void FveInstanceBuffer::flush(int frameIndex, uint32_t count) {
+		if (count > 0) buffers[frameIndex]->flush(count * sizeof(InstanceData));
+	}
+
+	void FveInstanceBuffer::bind(VkCommandBuffer commandBuffer, int frameIndex) const {
+
+		if (buffers[frameIndex] == nullptr) return;
+
+		VkBuffer vertexBuffers[] = { buffers[frameIndex]->getAllocatedBuffer().buffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BINDING, 1, vertexBuffers, offsets);
+
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_buffer.hpp"
+#include "fve_components.hpp"
+#include "fve_pipeline.hpp"
+#include "fve_swap_chain.hpp"
+
+#include <array>
+#include <memory>
+
+namespace fve {
+
+	// per instance vertex data, binding 1 at locations 4-7 (model) and 8-11 (normal matrix)
+	struct InstanceData {
+		glm::mat4 modelMatrix{ 1.0f };
+		glm::mat4 normalMatrix{ 1.0f };
+	};
+
+	// Per-frame, host visible vertex buffer of InstanceData, read through INSTANCE_BINDING. Whoever
+	// fills it lays the instances of each draw out back to back and points the draw's firstInstance
+	// at its slice.
+	class FveInstanceBuffer {
+	public:
+		static constexpr uint32_t INSTANCE_BINDING = 1;
+
+		explicit FveInstanceBuffer(FveDevice& device, uint32_t initialCapacity = 1024);
+
+		FveInstanceBuffer(const FveInstanceBuffer&) = delete;
+		FveInstanceBuffer& operator=(const FveInstanceBuffer&) = delete;
+
+		// appends the instance binding and its attributes to a pipeline's vertex input
+		static void addVertexInput(PipelineConfigInfo& configInfo);
+
+		// room for count instances in the frame's buffer, grown if needed; flush once written
+		InstanceData* map(int frameIndex, uint32_t count);
+		void flush(int frameIndex, uint32_t count);
+
+		// binds the frame's buffer at INSTANCE_BINDING; FveModel::bind leaves it alone
+		void bind(VkCommandBuffer commandBuffer, int frameIndex) const;
+
+		// bumped whenever the frame's buffer is replaced, recorded binds of the old one are stale
+		uint32_t getGeneration(int frameIndex) const { return generations[frameIndex]; }
+
+	private:
+		FveDevice& device;
+
+		std::array<std::unique_ptr<FveBuffer>, FveSwapChain::MAX_FRAMES_IN_FLIGHT> buffers{};
+		std::array<uint32_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> capacities{};
+		std::array<uint32_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> generations{};
+	};
+
+}
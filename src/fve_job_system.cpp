@@ -0,0 +1,426 @@
+#include "fve_job_system.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace fve {
+
+	FveJobSystem fveJobs;
+
+	// Chase-Lev deque with a fixed ring; a full deque makes the pusher run the job itself. Slots are
+	// only reused once top has moved past them, so a thief never reads a slot being overwritten.
+	class FveJobSystem::Deque {
+	public:
+		// owner only
+		bool push(FveJob* job) {
+			int64_t b = bottom.load(std::memory_order_relaxed);
+			int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= CAPACITY) return false;
+
+			slots[b & MASK].store(job, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_release);
+			return true;
+		}
+
+		// owner only, newest first
+		FveJob* pop() {
+			int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_seq_cst);
+
+			if (t > b) {
+				bottom.store(b + 1, std::memory_order_release);
+				return nullptr;
+			}
+
+			FveJob* job = slots[b & MASK].load(std::memory_order_relaxed);
+			if (t == b) {
+				// the last job, race the thieves for it
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+				bottom.store(b + 1, std::memory_order_release);
+			}
+			return job;
+		}
+
+		// any thread, oldest first
+		FveJob* steal() {
+			int64_t t = top.load(std::memory_order_seq_cst);
+			int64_t b = bottom.load(std::memory_order_seq_cst);
+			if (t >= b) return nullptr;
+
+			FveJob* job = slots[t & MASK].load(std::memory_order_relaxed);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+			return job;
+		}
+
+	private:
+		static constexpr int64_t CAPACITY = 4096;
+		static constexpr int64_t MASK = CAPACITY - 1;
+
+		// owner and thieves hammer different ends
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+		alignas(64) std::atomic<FveJob*> slots[CAPACITY]{};
+	};
+
+	// finished jobs are kept per thread for the next ones
+	namespace {
+		struct JobCache {
+			std::vector<FveJob*> free;
+			~JobCache() {
+				for (FveJob* job : free) delete job;
+			}
+		};
+
+		thread_local JobCache jobCache;
+		thread_local const FveJobSystem* workerSystem = nullptr;
+		thread_local int workerIndex = -1;
+		thread_local uint32_t stealSeed = 0;
+	}
+
+	FveJob* FveJobSystem::allocateJob() {
+		if (jobCache.free.empty()) return new FveJob{};
+
+		FveJob* job = jobCache.free.back();
+		jobCache.free.pop_back();
+		return job;
+	}
+
+	void FveJobSystem::releaseJob(FveJob* job) {
+		if (jobCache.free.size() < 1024) jobCache.free.push_back(job);
+		else delete job;
+	}
+
+	FveJobSystem::FveJobSystem(size_t workerCount) : ownerThread{ std::this_thread::get_id() } {
+		if (workerCount == 0) {
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+		}
+
+		deques.reserve(workerCount + 1);
+		for (size_t i = 0; i < workerCount + 1; i++) {
+			deques.push_back(std::make_unique<Deque>());
+		}
+
+		workers.reserve(workerCount);
+		for (size_t i = 0; i < workerCount; i++) {
+			workers.emplace_back(&FveJobSystem::workerLoop, this, static_cast<int>(i + 1));
+		}
+	}
+
+	FveJobSystem::~FveJobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+
+		// workers drain whatever is still queued before exiting
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	int FveJobSystem::currentIndex() const {
+		if (workerSystem == this) return workerIndex;
+		if (std::this_thread::get_id() == ownerThread) return 0;
+		return -1;
+	}
+
+	void FveJobSystem::wakeWorker() {
+		wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+		if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wakeUp.notify_one();
+		}
+	}
+
+	void FveJobSystem::schedule(FveJob* job) {
+		int index = currentIndex();
+		if (index >= 0) {
+			if (!deques[index]->push(job)) {
+				execute(job);
+				return;
+			}
+		}
+		else {
+			std::lock_guard<std::mutex> lock(queueMutex);
+			submitted.push_back(job);
+			submittedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		wakeWorker();
+	}
+
+	void FveJobSystem::scheduleBackground(FveJob* job) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			background.push_back(job);
+			backgroundCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		wakeWorker();
+	}
+
+	void FveJobSystem::defer(FveJobCounter& dependency, FveJob* job) {
+		{
+			// finish() drains the list under the same lock once pending reaches zero
+			std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+			if (dependency.pending.load(std::memory_order_acquire) != 0) {
+				dependency.continuations.push_back(job);
+				return;
+			}
+		}
+		schedule(job);
+	}
+
+	void FveJobSystem::execute(FveJob* job) {
+		FveJobCounter* counter = job->counter;
+		job->invoke(*job);
+		releaseJob(job);
+		if (counter != nullptr) finish(*counter);
+	}
+
+	void FveJobSystem::finish(FveJobCounter& counter) {
+		// keeps waiters from returning, and the counter alive, until the continuations are out
+		counter.finishing.fetch_add(1, std::memory_order_acq_rel);
+		if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			std::vector<FveJob*> ready;
+			{
+				std::lock_guard<std::mutex> lock(counter.continuationMutex);
+				ready.swap(counter.continuations);
+			}
+			for (FveJob* job : ready) schedule(job);
+		}
+		counter.finishing.fetch_sub(1, std::memory_order_release);
+	}
+
+	FveJob* FveJobSystem::findJob(int index, bool allowBackground) {
+
+		if (index >= 0) {
+			if (FveJob* job = deques[index]->pop()) return job;
+		}
+
+		if (submittedCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (!submitted.empty()) {
+				FveJob* job = submitted.front();
+				submitted.pop_front();
+				submittedCount.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		// start at a random victim so thieves spread out
+		if (stealSeed == 0) stealSeed = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+		stealSeed ^= stealSeed << 13;
+		stealSeed ^= stealSeed >> 17;
+		stealSeed ^= stealSeed << 5;
+
+		size_t dequeCount = deques.size();
+		size_t start = stealSeed % dequeCount;
+		for (size_t i = 0; i < dequeCount; i++) {
+			size_t victim = (start + i) % dequeCount;
+			if (static_cast<int>(victim) == index) continue;
+			if (FveJob* job = deques[victim]->steal()) return job;
+		}
+
+		if (allowBackground && backgroundCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (!background.empty()) {
+				FveJob* job = background.front();
+				background.pop_front();
+				backgroundCount.fetch_sub(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		return nullptr;
+
+	}
+
+	void FveJobSystem::wait(FveJobCounter& counter) {
+		int index = currentIndex();
+		while (!counter.isDone()) {
+			if (FveJob* job = findJob(index, false)) execute(job);
+			else std::this_thread::yield();
+		}
+	}
+
+	void FveJobSystem::workerLoop(int index) {
+
+		workerSystem = this;
+		workerIndex = index;
+
+		while (true) {
+			// read before searching, so a push that lands after the search still wakes us
+			uint64_t epoch = wakeEpoch.load(std::memory_order_seq_cst);
+
+			FveJob* job = findJob(index, true);
+			for (int spin = 0; job == nullptr && spin < 64; spin++) {
+				std::this_thread::yield();
+				job = findJob(index, true);
+			}
+			if (job != nullptr) {
+				execute(job);
+				continue;
+			}
+
+			if (stopping.load()) return;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+			wakeUp.wait(lock, [this, epoch]() { return stopping.load() || wakeEpoch.load(std::memory_order_seq_cst) != epoch; });
+			sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+		}
+
+	}
+
+	bool FveJobSystem::validate() {
+
+		bool valid = true;
+		auto check = [&valid](bool condition, const char* name) {
+			if (!condition) {
+				std::cerr << "Job system self test: " << name << " failed" << std::endl;
+				valid = false;
+			}
+		};
+
+		// more workers than most test machines have cores, so stealing and sleeping both happen
+		FveJobSystem jobs{ 7 };
+
+		for (size_t count : { size_t(0), size_t(1), size_t(7), size_t(100003) }) {
+			std::vector<std::atomic<uint32_t>> hits(count);
+			jobs.parallelFor(0, count, 1, [&hits](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) hits[i].fetch_add(1, std::memory_order_relaxed);
+			});
+			bool once = true;
+			for (auto& hit : hits) once = once && hit.load() == 1;
+			check(once, "parallelFor covering every index once");
+		}
+
+		std::atomic<uint64_t> nestedSum{ 0 };
+		jobs.parallelFor(0, 64, 1, [&](size_t begin, size_t end) {
+			for (size_t outer = begin; outer < end; outer++) {
+				jobs.parallelFor(0, 1000, 16, [&](size_t innerBegin, size_t innerEnd) {
+					nestedSum.fetch_add(innerEnd - innerBegin, std::memory_order_relaxed);
+				});
+			}
+		});
+		check(nestedSum.load() == 64000, "nested parallelFor");
+
+		// plain writes in the first batch must be visible to the job that depends on it
+		std::vector<uint64_t> values(256, 0);
+		uint64_t dependentSum = 0;
+		FveJobCounter produced;
+		FveJobCounter consumed;
+		for (size_t i = 0; i < values.size(); i++) {
+			jobs.run(produced, [&values, i]() { values[i] = i; });
+		}
+		jobs.runAfter(produced, consumed, [&]() { dependentSum = std::accumulate(values.begin(), values.end(), uint64_t(0)); });
+		jobs.wait(consumed);
+		check(dependentSum == 255 * 256 / 2, "runAfter seeing its dependency's writes");
+		jobs.wait(produced);
+
+		// a chain where each link only starts once the previous one finished
+		const size_t chainLength = 50;
+		std::vector<std::unique_ptr<FveJobCounter>> links;
+		std::vector<size_t> order;
+		for (size_t i = 0; i < chainLength; i++) {
+			links.push_back(std::make_unique<FveJobCounter>());
+			if (i == 0) jobs.run(*links[i], [&order, i]() { order.push_back(i); });
+			else jobs.runAfter(*links[i - 1], *links[i], [&order, i]() { order.push_back(i); });
+		}
+		jobs.wait(*links.back());
+		for (auto& link : links) jobs.wait(*link);
+		bool ordered = order.size() == chainLength;
+		for (size_t i = 0; ordered && i < chainLength; i++) ordered = order[i] == i;
+		check(ordered, "dependency chain order");
+
+		// one job fanning out past a deque's capacity
+		std::atomic<uint32_t> fanned{ 0 };
+		FveJobCounter fanOut;
+		jobs.run(fanOut, [&]() {
+			for (int i = 0; i < 10000; i++) jobs.run(fanOut, [&fanned]() { fanned.fetch_add(1, std::memory_order_relaxed); });
+		});
+		jobs.wait(fanOut);
+		check(fanned.load() == 10000, "fan out from a worker");
+
+		// threads the system does not know submit through the shared queue
+		std::atomic<uint32_t> foreign{ 0 };
+		std::thread outsider([&]() {
+			FveJobCounter counter;
+			for (int i = 0; i < 1000; i++) jobs.run(counter, [&foreign]() { foreign.fetch_add(1, std::memory_order_relaxed); });
+			jobs.wait(counter);
+		});
+		outsider.join();
+		check(foreign.load() == 1000, "submission from another thread");
+
+		std::future<int> answer = jobs.async([]() { return 42; });
+		check(answer.get() == 42, "async result");
+
+		std::future<void> failing = jobs.async([]() { throw std::runtime_error("expected"); });
+		bool threw = false;
+		try {
+			failing.get();
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "async exception");
+
+		return valid;
+
+	}
+
+	void FveJobSystem::benchmark(size_t count) {
+
+		// enough arithmetic per item that the split overhead is visible but not dominant
+		std::vector<float> results(count);
+		auto work = [&results](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				float x = static_cast<float>(i) * 0.001f;
+				for (int k = 0; k < 32; k++) x = x * 0.999f + std::sqrt(x + static_cast<float>(k));
+				results[i] = x;
+			}
+		};
+
+		const int iterations = 10;
+		size_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::cout << "Job system benchmark, parallelFor over " << count << " items x " << iterations << " iterations" << std::endl;
+
+		double serialMs = 0.0;
+		for (size_t threads = 1; threads <= hardwareThreads; threads++) {
+			double elapsedMs;
+			if (threads == 1) {
+				auto start = std::chrono::steady_clock::now();
+				for (int iteration = 0; iteration < iterations; iteration++) work(0, count);
+				elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+				serialMs = elapsedMs;
+			}
+			else {
+				FveJobSystem jobs{ threads - 1 };
+				jobs.parallelFor(0, count, 256, work);
+
+				auto start = std::chrono::steady_clock::now();
+				for (int iteration = 0; iteration < iterations; iteration++) jobs.parallelFor(0, count, 256, work);
+				elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+			}
+			std::cout << "  " << threads << " threads: " << elapsedMs << " ms, " << serialMs / elapsedMs << "x" << std::endl;
+		}
+
+		// cost of a job that does nothing, spawned and waited on from the creating thread
+		FveJobSystem jobs{};
+		const int emptyJobs = 100000;
+		auto start = std::chrono::steady_clock::now();
+		FveJobCounter counter;
+		for (int i = 0; i < emptyJobs; i++) jobs.run(counter, []() {});
+		jobs.wait(counter);
+		double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / emptyJobs;
+		std::cout << "  empty job, " << jobs.threadCount() << " threads: " << nanoseconds << " ns/job" << std::endl;
+
+	}
+
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fve {
+
+	struct FveJob;
+
+	// Counts the jobs started against it that have not finished yet. Jobs can be deferred until a
+	// counter drains, which is how dependencies are expressed. A counter must outlive its jobs, so
+	// wait on it before it goes out of scope.
+	class FveJobCounter {
+	public:
+		FveJobCounter() = default;
+
+		FveJobCounter(const FveJobCounter&) = delete;
+		FveJobCounter& operator=(const FveJobCounter&) = delete;
+
+		bool isDone() const {
+			return pending.load(std::memory_order_acquire) == 0 && finishing.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		friend class FveJobSystem;
+
+		std::atomic<uint32_t> pending{ 0 };
+		// jobs between their decrement and their last touch of the counter
+		std::atomic<uint32_t> finishing{ 0 };
+
+		// jobs waiting for this counter to drain
+		std::mutex continuationMutex;
+		std::vector<FveJob*> continuations;
+	};
+
+	// A type-erased task; small callables live inline, larger ones on the heap.
+	struct FveJob {
+		void (*invoke)(FveJob& job) = nullptr;
+		FveJobCounter* counter = nullptr;
+		alignas(std::max_align_t) unsigned char storage[64];
+	};
+
+	// Work-stealing job system. Every worker and the thread that created the system own a Chase-Lev
+	// deque: they push and pop at the bottom, idle workers steal from the top of a random victim, so
+	// recently split work stays hot in its cache while the oldest (largest) pieces migrate. Waiting
+	// on a counter runs other jobs instead of blocking. Other threads submit through a shared queue.
+	// Long blocking work such as file loads goes through async(), which only idle workers pick up so
+	// a frame waiting on its own jobs never ends up running one.
+	class FveJobSystem {
+	public:
+		// 0 means one worker per hardware thread, minus one for the creating thread
+		explicit FveJobSystem(size_t workerCount = 0);
+		~FveJobSystem();
+
+		FveJobSystem(const FveJobSystem&) = delete;
+		FveJobSystem& operator=(const FveJobSystem&) = delete;
+
+		// task() must not throw
+		template<typename F>
+		void run(FveJobCounter& counter, F&& task) {
+			schedule(createJob(std::forward<F>(task), &counter));
+		}
+
+		// starts once dependency has drained; counter covers it from now on
+		template<typename F>
+		void runAfter(FveJobCounter& dependency, FveJobCounter& counter, F&& task) {
+			defer(dependency, createJob(std::forward<F>(task), &counter));
+		}
+
+		// runs other jobs until the counter drains
+		void wait(FveJobCounter& counter);
+
+		// body(begin, end) over disjoint ranges covering [begin, end), returns when all are done. Ranges
+		// are split in halves on demand down to a grain of at least minGrain, so stealing workers take
+		// the biggest remaining pieces and small counts run inline without touching the queues.
+		template<typename F>
+		void parallelFor(size_t begin, size_t end, size_t minGrain, F&& body) {
+			if (begin >= end) return;
+
+			size_t count = end - begin;
+			size_t grain = std::max<size_t>(std::max<size_t>(minGrain, 1), count / (threadCount() * 8));
+			if (count <= grain) {
+				body(begin, end);
+				return;
+			}
+
+			FveJobCounter counter;
+			splitRange(counter, begin, end, grain, body);
+			wait(counter);
+		}
+
+		// long or blocking work, never run by a thread waiting on a counter; exceptions reach the future
+		template<typename F>
+		auto async(F&& task) -> std::future<std::invoke_result_t<F>> {
+			using Result = std::invoke_result_t<F>;
+
+			auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+			std::future<Result> future = packaged->get_future();
+			scheduleBackground(createJob([packaged]() { (*packaged)(); }, nullptr));
+			return future;
+		}
+
+		size_t workerCount() const { return workers.size(); }
+
+		// workers plus the creating thread
+		size_t threadCount() const { return workers.size() + 1; }
+
+		// worker index of the calling thread, 0 for the creating thread, -1 for any other; below threadCount()
+		int currentIndex() const;
+
+		// parallelFor coverage, nesting, dependencies, foreign submission and async
+		static bool validate();
+
+		// prints parallelFor speedup and job overhead from one thread up to every hardware thread
+		static void benchmark(size_t count);
+
+	private:
+		class Deque;
+
+		template<typename F>
+		static FveJob* createJob(F&& task, FveJobCounter* counter) {
+			using Task = std::decay_t<F>;
+
+			FveJob* job = allocateJob();
+			job->counter = counter;
+			if constexpr (sizeof(Task) <= sizeof(job->storage) && alignof(Task) <= alignof(std::max_align_t)) {
+				new (job->storage) Task(std::forward<F>(task));
+				job->invoke = [](FveJob& job) {
+					Task* stored = std::launder(reinterpret_cast<Task*>(job.storage));
+					(*stored)();
+					stored->~Task();
+				};
+			}
+			else {
+				new (job->storage) Task*(new Task(std::forward<F>(task)));
+				job->invoke = [](FveJob& job) {
+					Task* stored = *std::launder(reinterpret_cast<Task**>(job.storage));
+					(*stored)();
+					delete stored;
+				};
+			}
+			if (counter != nullptr) counter->pending.fetch_add(1, std::memory_order_relaxed);
+			return job;
+		}
+
+		// keeps half of the range and pushes the other half, until it is down to the grain
+		template<typename F>
+		void splitRange(FveJobCounter& counter, size_t begin, size_t end, size_t grain, F& body) {
+			while (end - begin > grain) {
+				size_t middle = begin + (end - begin) / 2;
+				run(counter, [this, &counter, middle, end, grain, &body]() { splitRange(counter, middle, end, grain, body); });
+				end = middle;
+			}
+			body(begin, end);
+		}
+
+		static FveJob* allocateJob();
+		static void releaseJob(FveJob* job);
+
+		void schedule(FveJob* job);
+		void defer(FveJobCounter& dependency, FveJob* job);
+		void scheduleBackground(FveJob* job);
+		void execute(FveJob* job);
+		void finish(FveJobCounter& counter);
+
+		// own deque, then submitted, then stolen, then background jobs if allowed
+		FveJob* findJob(int index, bool allowBackground);
+		void wakeWorker();
+		void workerLoop(int index);
+
+		// deques[0] belongs to the creating thread, deques[i] to workers[i - 1]
+		std::vector<std::unique_ptr<Deque>> deques;
+		std::vector<std::thread> workers;
+		std::thread::id ownerThread;
+
+		std::mutex queueMutex;
+		std::deque<FveJob*> submitted;
+		std::deque<FveJob*> background;
+		std::atomic<size_t> submittedCount{ 0 };
+		std::atomic<size_t> backgroundCount{ 0 };
+
+		// bumped on every push, sleepers compare against what they saw before their last search
+		std::atomic<uint64_t> wakeEpoch{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wakeUp;
+		std::atomic<bool> stopping{ false };
+	};
+
+	// shared by every engine system
+	extern FveJobSystem fveJobs;
+
+}
@@ -0,0 +1,142 @@
+#include "fve_mesh_arena.hpp"
+
+#include "fve_memory.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace fve {
+
+	FveRangeAllocator::FveRangeAllocator(uint32_t capacity) : capacity{ capacity }, freeCount{ capacity } {
+		if (capacity > 0) freeBlocks.emplace(0, capacity);
+	}
+
+	uint32_t FveRangeAllocator::allocate(uint32_t count) {
+
+		if (count == 0 || count > freeCount) return INVALID;
+
+		for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it) {
+			if (it->second < count) continue;
+
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - count;
+			freeBlocks.erase(it);
+			if (remaining > 0) freeBlocks.emplace(offset + count, remaining);
+			freeCount -= count;
+			return offset;
+		}
+		return INVALID;
+
+	}
+
+	void FveRangeAllocator::free(uint32_t offset, uint32_t count) {
+
+		if (count == 0) return;
+		assert(offset + count <= capacity && "Freeing a range outside the allocator");
+		freeCount += count;
+
+		auto next = freeBlocks.lower_bound(offset);
+		assert((next == freeBlocks.end() || offset + count <= next->first) && "Freeing a range that overlaps a free block");
+
+		// merge with the free block right after
+		uint32_t size = count;
+		if (next != freeBlocks.end() && next->first == offset + count) {
+			size += next->second;
+			next = freeBlocks.erase(next);
+		}
+
+		// and with the one right before
+		if (next != freeBlocks.begin()) {
+			auto previous = std::prev(next);
+			assert(previous->first + previous->second <= offset && "Freeing a range that overlaps a free block");
+			if (previous->first + previous->second == offset) {
+				previous->second += size;
+				return;
+			}
+		}
+
+		freeBlocks.emplace(offset, size);
+
+	}
+
+	bool FveRangeAllocator::validate() {
+
+		const uint32_t capacity = 4096;
+		FveRangeAllocator allocator{ capacity };
+		std::vector<bool> used(capacity, false);
+		std::vector<std::pair<uint32_t, uint32_t>> live;
+		std::mt19937 rng{ 7 };
+
+		for (int step = 0; step < 100000; step++) {
+			if (live.empty() || rng() % 2 == 0) {
+				uint32_t count = 1 + rng() % 64;
+				uint32_t offset = allocator.allocate(count);
+				if (offset == INVALID) continue;
+				for (uint32_t i = offset; i < offset + count; i++) {
+					if (i >= capacity || used[i]) {
+						std::cerr << "Range allocator handed out a used unit at step " << step << std::endl;
+						return false;
+					}
+					used[i] = true;
+				}
+				live.emplace_back(offset, count);
+			}
+			else {
+				size_t pick = rng() % live.size();
+				auto [offset, count] = live[pick];
+				live[pick] = live.back();
+				live.pop_back();
+				allocator.free(offset, count);
+				for (uint32_t i = offset; i < offset + count; i++) used[i] = false;
+			}
+		}
+
+		// with everything freed the blocks must have merged back into one
+		for (auto [offset, count] : live) allocator.free(offset, count);
+		if (allocator.getFreeCount() != capacity || allocator.allocate(capacity) != 0) {
+			std::cerr << "Range allocator did not merge its free blocks back together" << std::endl;
+			return false;
+		}
+		return true;
+
+	}
+
+	FveMeshArena::FveMeshArena(FveDevice& device, uint32_t vertexCapacity, uint32_t indexCapacity)
+		: vertices{ vertexCapacity }, indices{ indexCapacity } {
+
+		vertexBuffer = std::make_unique<FveBuffer>(
+			fveAllocator, device, sizeof(Vertex), vertexCapacity,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY, "meshArenaVertices");
+		indexBuffer = std::make_unique<FveBuffer>(
+			fveAllocator, device, sizeof(uint32_t), indexCapacity,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY, "meshArenaIndices");
+
+	}
+
+	bool FveMeshArena::allocate(uint32_t vertexCount, uint32_t indexCount, Allocation& allocation) {
+
+		uint32_t firstVertex = vertices.allocate(vertexCount);
+		if (firstVertex == FveRangeAllocator::INVALID) return false;
+
+		uint32_t firstIndex = indices.allocate(indexCount);
+		if (firstIndex == FveRangeAllocator::INVALID) {
+			vertices.free(firstVertex, vertexCount);
+			return false;
+		}
+
+		allocation = Allocation{ firstVertex, vertexCount, firstIndex, indexCount };
+		return true;
+
+	}
+
+	void FveMeshArena::free(const Allocation& allocation) {
+		vertices.free(allocation.firstVertex, allocation.vertexCount);
+		indices.free(allocation.firstIndex, allocation.indexCount);
+	}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_buffer.hpp"
+#include "fve_types.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace fve {
+
+	// First fit allocator over a range of [0, capacity) units. Free blocks are kept by offset so
+	// a freed block merges with the free blocks on either side.
+	class FveRangeAllocator {
+	public:
+		static constexpr uint32_t INVALID = ~0u;
+
+		explicit FveRangeAllocator(uint32_t capacity);
+
+		// offset of count free units, INVALID if no block is large enough
+		uint32_t allocate(uint32_t count);
+		void free(uint32_t offset, uint32_t count);
+
+		uint32_t getCapacity() const { return capacity; }
+		uint32_t getFreeCount() const { return freeCount; }
+
+		// random allocations and frees checked against a reference map of used units
+		static bool validate();
+
+	private:
+		uint32_t capacity;
+		uint32_t freeCount;
+		// offset -> size
+		std::map<uint32_t, uint32_t> freeBlocks;
+	};
+
+	// One device local vertex buffer and one index buffer that indexed meshes are suballocated
+	// from. Meshes drawn from the arena only differ in firstIndex and vertexOffset, so a single
+	// bind serves all of them and their draws can be merged into one multi draw indirect call.
+	// Meshes that don't fit keep buffers of their own.
+	class FveMeshArena {
+	public:
+		struct Allocation {
+			uint32_t firstVertex = FveRangeAllocator::INVALID;
+			uint32_t vertexCount = 0;
+			uint32_t firstIndex = FveRangeAllocator::INVALID;
+			uint32_t indexCount = 0;
+		};
+
+		FveMeshArena(FveDevice& device, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+		FveMeshArena(const FveMeshArena&) = delete;
+		FveMeshArena& operator=(const FveMeshArena&) = delete;
+
+		// false if either buffer is out of room, nothing is taken then
+		bool allocate(uint32_t vertexCount, uint32_t indexCount, Allocation& allocation);
+		// the GPU must be done with the range
+		void free(const Allocation& allocation);
+
+		VkBuffer getVertexBuffer() const { return vertexBuffer->getAllocatedBuffer().buffer; }
+		VkBuffer getIndexBuffer() const { return indexBuffer->getAllocatedBuffer().buffer; }
+
+	private:
+		std::unique_ptr<FveBuffer> vertexBuffer;
+		std::unique_ptr<FveBuffer> indexBuffer;
+		FveRangeAllocator vertices;
+		FveRangeAllocator indices;
+	};
+
+}
@@ -12,10 +12,8 @@
 #include <iostream>
 #include <cassert>
 #include <limits>
-
-#ifndef ENGINE_DIR
-#define ENGINE_DIR "../"
-#endif
+#include <istream>
+#include <streambuf>
 
 namespace std {
 
@@ -32,12 +30,41 @@ namespace std {
 
 namespace fve {
 
-	Mesh::Mesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
-		createVertexBuffers(device, vertices);
-		createIndexBuffers(device, indices);
+	// lets tinyobjloader parse straight out of a (possibly mapped) file without copying it
+	struct MemoryStreamBuf : std::streambuf {
+		MemoryStreamBuf(const char* data, size_t size) {
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + size);
+		}
+	};
+
+	Mesh::Mesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveMeshArena* arena) : bounds{ computeBounds(vertices) }, arena{ arena } {
+		createGeometry(device, vertices, indices, nullptr);
+	}
+
+	Mesh::Mesh(FveDevice& device, FveUploadQueue& uploadQueue, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveMeshArena* arena) : bounds{ computeBounds(vertices) }, arena{ arena } {
+		resident = false;
+		createGeometry(device, vertices, indices, &uploadQueue);
+	}
+
+	Mesh::~Mesh() {
+		releaseGeometry();
 	}
 
-	Mesh::~Mesh() {}
+	void Mesh::reload(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		releaseGeometry();
+		bounds = computeBounds(vertices);
+		if (!cpuPositions.empty()) keepCpuGeometry(vertices, indices);
+		createGeometry(device, vertices, indices, nullptr);
+	}
+
+	VkBuffer Mesh::getVertexBuffer() const {
+		return isInArena() ? arena->getVertexBuffer() : vertexBuffer->getAllocatedBuffer().buffer;
+	}
+
+	VkBuffer Mesh::getIndexBuffer() const {
+		return isInArena() ? arena->getIndexBuffer() : indexBuffer->getAllocatedBuffer().buffer;
+	}
 
 	Mesh Mesh::createMeshFromFile(FveDevice& device, const std::string& filepath) {
 
@@ -48,12 +75,37 @@ namespace fve {
 
 	}
 
-	FveModel::FveModel(FveDevice& device, const std::string& meshId, const std::string& materialId) {
+	Aabb Mesh::computeBounds(const std::vector<Vertex>& vertices) {
+		Aabb bounds;
+		for (const Vertex& vertex : vertices) {
+			bounds.min = glm::min(bounds.min, vertex.position);
+			bounds.max = glm::max(bounds.max, vertex.position);
+		}
+		return bounds;
+	}
+
+	void Mesh::keepCpuGeometry(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		cpuPositions.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++) {
+			cpuPositions[i] = vertices[i].position;
+		}
+		cpuIndices = indices;
+	}
+
+	uint64_t Mesh::hashContents(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+		// include the counts so the vertex/index boundary can't shift between two meshes
+		uint64_t counts[2] = { vertices.size(), indices.size() };
+		uint64_t hash = fnv1a64(counts, sizeof(counts));
+		hash = fnv1a64(vertices.data(), vertices.size() * sizeof(Vertex), hash);
+		return fnv1a64(indices.data(), indices.size() * sizeof(uint32_t), hash);
+	}
+
+	FveModel::FveModel(FveDevice& device, const std::string& meshId, const std::string& materialId) : meshId{ meshId } {
 		mesh = fveAssets.getMesh(meshId);
 		material = fveAssets.getMaterial(materialId);
 	}
 
-	FveModel::FveModel(FveDevice& device, Mesh* mesh, Material* material) : mesh { mesh }, material{ material } {}
+	FveModel::FveModel(FveDevice& device, Mesh* mesh, Material* material, const std::string& meshId) : mesh { mesh }, material{ material }, meshId{ meshId } {}
 
 	FveModel::~FveModel() {}
 
@@ -65,7 +117,66 @@ namespace fve {
 		return *material;
 	}
 
-	void Mesh::createVertexBuffers(FveDevice& device, const std::vector<Vertex>& vertices) {
+	void Mesh::createGeometry(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveUploadQueue* uploadQueue) {
+
+		uint32_t newVertexCount = static_cast<uint32_t>(vertices.size());
+		uint32_t newIndexCount = static_cast<uint32_t>(indices.size());
+
+		// unindexed meshes are never drawn indirectly, they keep their own buffer
+		if (arena == nullptr || newIndexCount == 0 || !arena->allocate(newVertexCount, newIndexCount, arenaAllocation)) {
+			firstIndex = 0;
+			vertexOffset = 0;
+			createVertexBuffers(device, vertices, uploadQueue);
+			createIndexBuffers(device, indices, uploadQueue);
+			return;
+		}
+
+		vertexCount = newVertexCount;
+		indexCount = newIndexCount;
+		hasIndexBuffer = true;
+		complexModel = vertexCount > std::numeric_limits<uint16_t>::max();
+		firstIndex = arenaAllocation.firstIndex;
+		vertexOffset = static_cast<int32_t>(arenaAllocation.firstVertex);
+
+		copyToBuffer(device, vertices.data(), sizeof(Vertex), vertexCount, arena->getVertexBuffer(), VkDeviceSize{ arenaAllocation.firstVertex } * sizeof(Vertex), uploadQueue);
+		copyToBuffer(device, indices.data(), sizeof(uint32_t), indexCount, arena->getIndexBuffer(), VkDeviceSize{ arenaAllocation.firstIndex } * sizeof(uint32_t), uploadQueue);
+
+	}
+
+	void Mesh::releaseGeometry() {
+		// callers wait for the GPU first, reloads and releases happen after a device wait idle
+		if (isInArena()) {
+			arena->free(arenaAllocation);
+			arenaAllocation = FveMeshArena::Allocation{};
+		}
+		vertexBuffer.reset();
+		indexBuffer.reset();
+	}
+
+	void Mesh::copyToBuffer(FveDevice& device, const void* data, uint32_t elementSize, uint32_t count, VkBuffer dstBuffer, VkDeviceSize dstOffset, FveUploadQueue* uploadQueue) {
+
+		auto stagingBuffer = std::make_unique<FveBuffer>(
+			fveAllocator,
+			device,
+			elementSize,
+			count,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU
+		);
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer(const_cast<void*>(data));
+
+		VkDeviceSize size = VkDeviceSize{ elementSize } * count;
+		if (uploadQueue != nullptr) {
+			uploadQueue->copyBuffer(std::move(stagingBuffer), dstBuffer, size, dstOffset);
+		}
+		else {
+			device.copyBuffer(stagingBuffer->getAllocatedBuffer().buffer, dstBuffer, size, dstOffset);
+		}
+
+	}
+
+	void Mesh::createVertexBuffers(FveDevice& device, const std::vector<Vertex>& vertices, FveUploadQueue* uploadQueue) {
 		// count the vertices, veryfi we have at least 3
 		vertexCount = static_cast<uint32_t>(vertices.size());
 
@@ -78,18 +189,18 @@ namespace fve {
 		// create a staging buffer
 		uint32_t vertexSize = sizeof(vertices[0]);
 
-		FveBuffer stagingBuffer{
+		auto stagingBuffer = std::make_unique<FveBuffer>(
 			fveAllocator,
 			device,
 			vertexSize,
 			vertexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VMA_MEMORY_USAGE_CPU_TO_GPU
-		};
+		);
 
 		// copy the vertex data into the staging buffer
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer((void*)vertices.data());
 
 		// create a device local buffer on the GPU
 		vertexBuffer = std::make_unique<FveBuffer>(
@@ -103,10 +214,15 @@ namespace fve {
 		);
 
 		// copy the staging buffer contents into the device local buffer
-		device.copyBuffer(stagingBuffer.getAllocatedBuffer().buffer, vertexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		if (uploadQueue != nullptr) {
+			uploadQueue->copyBuffer(std::move(stagingBuffer), vertexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		}
+		else {
+			device.copyBuffer(stagingBuffer->getAllocatedBuffer().buffer, vertexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		}
 	}
 
-	void Mesh::createIndexBuffers(FveDevice& device, const std::vector<uint32_t>& indices) {
+	void Mesh::createIndexBuffers(FveDevice& device, const std::vector<uint32_t>& indices, FveUploadQueue* uploadQueue) {
 		// count the indices, determine if we're using an index buffer for this model
 		indexCount = static_cast<uint32_t>(indices.size());
 		hasIndexBuffer = indexCount > 0;
@@ -120,18 +236,18 @@ namespace fve {
 		uint32_t indexSize = sizeof(indices[0]);
 
 		// create a staging buffer
-		FveBuffer stagingBuffer{
+		auto stagingBuffer = std::make_unique<FveBuffer>(
 			fveAllocator,
 			device,
 			indexSize,
 			indexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VMA_MEMORY_USAGE_CPU_TO_GPU
-		};
+		);
 
 		// copy the index data into the staging buffer
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer((void*)indices.data());
 
 		// create a device local buffer on the GPU
 		indexBuffer = std::make_unique<FveBuffer>(
@@ -145,24 +261,38 @@ namespace fve {
 		);
 
 		// copy the staging buffer contents into the device local buffer
-		device.copyBuffer(stagingBuffer.getAllocatedBuffer().buffer, indexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		if (uploadQueue != nullptr) {
+			uploadQueue->copyBuffer(std::move(stagingBuffer), indexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		}
+		else {
+			device.copyBuffer(stagingBuffer->getAllocatedBuffer().buffer, indexBuffer->getAllocatedBuffer().buffer, bufferSize);
+		}
 	}
 
 	void FveModel::draw(VkCommandBuffer commandBuffer) {
 		if (mesh->hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, 0);
+			vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, mesh->firstIndex, mesh->vertexOffset, 0);
 		}
 		else {
 			vkCmdDraw(commandBuffer, mesh->vertexCount, 1, 0, 0);
 		}
 	}
 
+	void FveModel::drawInstanced(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
+		if (mesh->hasIndexBuffer) {
+			vkCmdDrawIndexed(commandBuffer, mesh->indexCount, instanceCount, mesh->firstIndex, mesh->vertexOffset, firstInstance);
+		}
+		else {
+			vkCmdDraw(commandBuffer, mesh->vertexCount, instanceCount, 0, firstInstance);
+		}
+	}
+
 	void FveModel::bind(VkCommandBuffer commandBuffer) {
-		VkBuffer buffers[] = { mesh->vertexBuffer->getAllocatedBuffer().buffer};
+		VkBuffer buffers[] = { mesh->getVertexBuffer() };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 		if (mesh->hasIndexBuffer) {
-			vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer->getAllocatedBuffer().buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 		}
 	}
 
@@ -186,16 +316,21 @@ namespace fve {
 	}
 
 	void Mesh::Builder::loadMesh(const std::string& filepath) {
+		loadMeshFromData(fveVfs.readFile(filepath));
+	}
+
+	void Mesh::Builder::loadMeshFromData(const FveFileData& fileData) {
 
-		std::string enginePath = ENGINE_DIR + filepath;
+		MemoryStreamBuf streamBuf{ fileData.data(), fileData.size() };
+		std::istream stream{ &streamBuf };
 
 		// prepare what tinyobjloader needs to load an OBJ file
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
 		std::string warn, err;
-		// load the OBJ file with tinyobjloader
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, enginePath.c_str())) {
+		// load the OBJ file with tinyobjloader (material libraries are not used)
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, nullptr)) {
 			throw std::runtime_error(warn + err);
 		}
 
@@ -3,6 +3,10 @@
 #include "fve_device.hpp"
 #include "fve_buffer.hpp"
 #include "fve_types.hpp"
+#include "fve_bounds.hpp"
+#include "fve_vfs.hpp"
+#include "fve_upload_queue.hpp"
+#include "fve_mesh_arena.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -21,11 +25,16 @@ namespace fve {
 			std::vector<uint32_t> indices{};
 
 			void loadMesh(const std::string& filepath);
+			void loadMeshFromData(const FveFileData& fileData);
 		};
 
 		Mesh() = default;
 
-		Mesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		// indexed meshes are placed in arena when it is given and has room, reloads keep to the same arena
+		Mesh(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveMeshArena* arena = nullptr);
+
+		// records the copies into uploadQueue instead of blocking, the mesh is not drawable until the batch retires
+		Mesh(FveDevice& device, FveUploadQueue& uploadQueue, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveMeshArena* arena = nullptr);
 
 		~Mesh();
 
@@ -34,6 +43,20 @@ namespace fve {
 
 		static Mesh createMeshFromFile(FveDevice& device, const std::string& filepath);
 
+		// hash of the vertex and index data, identical meshes hash the same whatever file they came from
+		static uint64_t hashContents(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		static Aabb computeBounds(const std::vector<Vertex>& vertices);
+
+		// replaces the GPU buffers in place so anything pointing at this mesh keeps working
+		void reload(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		// the buffers to bind, the arena's when the mesh lives in it
+		VkBuffer getVertexBuffer() const;
+		VkBuffer getIndexBuffer() const;
+		bool isInArena() const { return arenaAllocation.firstVertex != FveRangeAllocator::INVALID; }
+
+		// null for meshes in the arena
 		std::unique_ptr<FveBuffer> vertexBuffer;
 		uint32_t vertexCount;
 
@@ -41,15 +64,41 @@ namespace fve {
 		bool complexModel = false;
 		std::unique_ptr<FveBuffer> indexBuffer;
 		uint32_t indexCount;
+
+		// where the mesh starts in the bound buffers, only non zero in the arena
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+
+		// false while an asynchronous upload is still in flight
+		bool resident = true;
+
+		uint64_t contentHash = 0;
+
+		// object space bounds of the vertices
+		Aabb bounds;
+
+		// triangles kept on the CPU for the software occlusion rasterizer, empty unless
+		// keepCpuGeometry was called; reloads refresh them once kept
+		std::vector<glm::vec3> cpuPositions;
+		std::vector<uint32_t> cpuIndices;
+		void keepCpuGeometry(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 	private:
-		void createVertexBuffers(FveDevice& device, const std::vector<Vertex>& vertices);
-		void createIndexBuffers(FveDevice& device, const std::vector<uint32_t>& indices);
+		void createGeometry(FveDevice& device, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, FveUploadQueue* uploadQueue);
+		void releaseGeometry();
+		void copyToBuffer(FveDevice& device, const void* data, uint32_t elementSize, uint32_t count, VkBuffer dstBuffer, VkDeviceSize dstOffset, FveUploadQueue* uploadQueue);
+		void createVertexBuffers(FveDevice& device, const std::vector<Vertex>& vertices, FveUploadQueue* uploadQueue = nullptr);
+		void createIndexBuffers(FveDevice& device, const std::vector<uint32_t>& indices, FveUploadQueue* uploadQueue = nullptr);
+
+		FveMeshArena* arena = nullptr;
+		FveMeshArena::Allocation arenaAllocation{};
 	};
 
 	struct Material {
 		VkDescriptorSet textureSet{ VK_NULL_HANDLE }; // no texture by default
 		VkPipeline pipeline;
 		VkPipelineLayout pipelineLayout;
+		// the variant that reads the GPU culling object table, linked by the render system owning both
+		Material* indirect = nullptr;
 	};
 
 	class FveModel {
@@ -58,7 +107,7 @@ namespace fve {
 		FveModel() = default;
 
 		FveModel(FveDevice& device, const std::string& meshId, const std::string& materialId);
-		FveModel(FveDevice& device, Mesh* mesh, Material* material);
+		FveModel(FveDevice& device, Mesh* mesh, Material* material, const std::string& meshId = "");
 
 		~FveModel();
 
@@ -68,12 +117,19 @@ namespace fve {
 		virtual inline Mesh& getMesh() const;
 		virtual inline Material& getMaterial() const;
 
+		// the asset id the mesh was requested by, empty if the model was built from a bare mesh pointer
+		const std::string& getMeshId() const { return meshId; }
+		void setMesh(Mesh* newMesh) { mesh = newMesh; }
+
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
+		// instances firstInstance .. firstInstance + instanceCount of the bound instance buffer
+		void drawInstanced(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance);
 
 	private:
 		Mesh* mesh;
 		Material* material;
+		std::string meshId;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include "fve_occlusion_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FVE_OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace fve {
+
+	FveOcclusionBuffer::FveOcclusionBuffer(uint32_t width, uint32_t height) : width{ width }, height{ height } {
+
+		assert(width % 4 == 0 && "Occlusion buffer width must be a multiple of four");
+
+		bins.resize((height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+
+		uint32_t levelWidth = width;
+		uint32_t levelHeight = height;
+		while (true) {
+			levels.emplace_back(size_t(levelWidth) * levelHeight, 1.0f);
+			levelWidths.push_back(levelWidth);
+			levelHeights.push_back(levelHeight);
+			if (levelWidth == 1 && levelHeight == 1) break;
+			levelWidth = std::max(1u, (levelWidth + 1) / 2);
+			levelHeight = std::max(1u, (levelHeight + 1) / 2);
+		}
+
+	}
+
+	void FveOcclusionBuffer::clear() {
+		triangles.clear();
+		for (auto& bin : bins) bin.clear();
+		std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+	}
+
+	void FveOcclusionBuffer::addOccluder(const glm::mat4& worldViewProjection, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+
+		clipVertices.resize(positions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+			clipVertices[i] = worldViewProjection * glm::vec4(positions[i], 1.0f);
+		}
+
+		size_t vertexCount = indices.empty() ? positions.size() : indices.size();
+		for (size_t i = 0; i + 2 < vertexCount; i += 3) {
+			const glm::vec4& c0 = clipVertices[indices.empty() ? i : indices[i]];
+			const glm::vec4& c1 = clipVertices[indices.empty() ? i + 1 : indices[i + 1]];
+			const glm::vec4& c2 = clipVertices[indices.empty() ? i + 2 : indices[i + 2]];
+
+			// entirely outside one side of the frustum
+			if (c0.x > c0.w && c1.x > c1.w && c2.x > c2.w) continue;
+			if (c0.x < -c0.w && c1.x < -c1.w && c2.x < -c2.w) continue;
+			if (c0.y > c0.w && c1.y > c1.w && c2.y > c2.w) continue;
+			if (c0.y < -c0.w && c1.y < -c1.w && c2.y < -c2.w) continue;
+			if (c0.z > c0.w && c1.z > c1.w && c2.z > c2.w) continue;
+			if (c0.z < 0.0f && c1.z < 0.0f && c2.z < 0.0f) continue;
+
+			if (c0.z >= 0.0f && c1.z >= 0.0f && c2.z >= 0.0f) {
+				setupTriangle(c0, c1, c2);
+				continue;
+			}
+
+			// crosses the near plane (z = 0), clip it to a triangle or a quad
+			glm::vec4 polygon[4];
+			int polygonSize = 0;
+			const glm::vec4* input[3] = { &c0, &c1, &c2 };
+			for (int edge = 0; edge < 3; edge++) {
+				const glm::vec4& a = *input[edge];
+				const glm::vec4& b = *input[(edge + 1) % 3];
+				if (a.z >= 0.0f) polygon[polygonSize++] = a;
+				if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+					float t = a.z / (a.z - b.z);
+					polygon[polygonSize++] = a + (b - a) * t;
+				}
+			}
+
+			for (int v = 1; v + 1 < polygonSize; v++) {
+				setupTriangle(polygon[0], polygon[v], polygon[v + 1]);
+			}
+		}
+
+	}
+
+	void FveOcclusionBuffer::setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2) {
+
+		auto toScreen = [&](const glm::vec4& clip) {
+			float inverseW = 1.0f / clip.w;
+			return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * float(width), (clip.y * inverseW * 0.5f + 0.5f) * float(height), clip.z * inverseW);
+		};
+
+		glm::vec3 p0 = toScreen(v0);
+		glm::vec3 p1 = toScreen(v1);
+		glm::vec3 p2 = toScreen(v2);
+
+		float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+		if (std::abs(area) < 1e-8f) return;
+
+		// occluders are double sided
+		if (area < 0.0f) {
+			std::swap(p1, p2);
+			area = -area;
+		}
+
+		ScreenTriangle triangle;
+
+		const glm::vec3* corners[3] = { &p0, &p1, &p2 };
+		for (int edge = 0; edge < 3; edge++) {
+			const glm::vec3& a = *corners[edge];
+			const glm::vec3& b = *corners[(edge + 1) % 3];
+			triangle.edgeA[edge] = a.y - b.y;
+			triangle.edgeB[edge] = b.x - a.x;
+			triangle.edgeC[edge] = -(triangle.edgeA[edge] * a.x + triangle.edgeB[edge] * a.y);
+		}
+
+		float inverseArea = 1.0f / area;
+		triangle.depthDx = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) * inverseArea;
+		triangle.depthDy = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) * inverseArea;
+
+		// farthest point of the plane within half a pixel of the center, so edge pixels never get a nearer depth than the occluder
+		triangle.depth0 = p0.z - triangle.depthDx * p0.x - triangle.depthDy * p0.y
+			+ 0.5f * (std::abs(triangle.depthDx) + std::abs(triangle.depthDy));
+		triangle.maxDepth = std::max(p0.z, std::max(p1.z, p2.z));
+
+		float minX = std::min(p0.x, std::min(p1.x, p2.x));
+		float maxX = std::max(p0.x, std::max(p1.x, p2.x));
+		float minY = std::min(p0.y, std::min(p1.y, p2.y));
+		float maxY = std::max(p0.y, std::max(p1.y, p2.y));
+
+		triangle.minX = static_cast<int32_t>(std::max(0.0f, std::floor(minX)));
+		triangle.maxX = static_cast<int32_t>(std::min(float(width) - 1.0f, std::floor(maxX)));
+		triangle.minY = static_cast<int32_t>(std::max(0.0f, std::floor(minY)));
+		triangle.maxY = static_cast<int32_t>(std::min(float(height) - 1.0f, std::floor(maxY)));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+
+		uint32_t index = static_cast<uint32_t>(triangles.size());
+		triangles.push_back(triangle);
+		for (uint32_t band = triangle.minY / BAND_HEIGHT; band <= triangle.maxY / BAND_HEIGHT; band++) {
+			bins[band].push_back(index);
+		}
+
+	}
+
+	void FveOcclusionBuffer::rasterize(FveJobSystem* jobs) {
+
+		if (jobs != nullptr && !triangles.empty()) {
+			// bands own disjoint rows, so they need no synchronization
+			jobs->parallelFor(0, bins.size(), 1, [this](size_t begin, size_t end) {
+				for (size_t band = begin; band < end; band++) {
+					rasterizeBand(static_cast<uint32_t>(band));
+				}
+			});
+		}
+		else {
+			for (uint32_t band = 0; band < bins.size(); band++) {
+				rasterizeBand(band);
+			}
+		}
+
+		buildHierarchy();
+
+	}
+
+	void FveOcclusionBuffer::rasterizeBand(uint32_t band) {
+
+		int32_t bandTop = static_cast<int32_t>(band * BAND_HEIGHT);
+		int32_t bandBottom = static_cast<int32_t>(std::min(height, (band + 1) * BAND_HEIGHT));
+
+		for (uint32_t index : bins[band]) {
+			const ScreenTriangle& triangle = triangles[index];
+			int32_t y0 = std::max(triangle.minY, bandTop);
+			int32_t y1 = std::min(triangle.maxY + 1, bandBottom);
+
+#ifdef FVE_OCCLUSION_SSE2
+			if (!forceScalar) {
+				rasterizeRowsSimd(triangle, y0, y1);
+				continue;
+			}
+#endif
+			rasterizeRowsScalar(triangle, y0, y1);
+		}
+
+	}
+
+	void FveOcclusionBuffer::rasterizeRowsScalar(const ScreenTriangle& triangle, int32_t y0, int32_t y1) {
+
+		// same evaluation order as the SIMD path so both produce identical buffers
+		float* depth = levels[0].data();
+		for (int32_t y = y0; y < y1; y++) {
+			float py = float(y) + 0.5f;
+			float row0 = triangle.edgeB[0] * py + triangle.edgeC[0];
+			float row1 = triangle.edgeB[1] * py + triangle.edgeC[1];
+			float row2 = triangle.edgeB[2] * py + triangle.edgeC[2];
+			float rowDepth = triangle.depthDy * py + triangle.depth0;
+
+			for (int32_t x = triangle.minX & ~3; x <= (triangle.maxX | 3); x++) {
+				float px = float(x) + 0.5f;
+				if (triangle.edgeA[0] * px + row0 < 0.0f) continue;
+				if (triangle.edgeA[1] * px + row1 < 0.0f) continue;
+				if (triangle.edgeA[2] * px + row2 < 0.0f) continue;
+
+				float z = std::min(triangle.depthDx * px + rowDepth, triangle.maxDepth);
+				float& stored = depth[size_t(y) * width + x];
+				stored = std::min(stored, z);
+			}
+		}
+
+	}
+
+	void FveOcclusionBuffer::rasterizeRowsSimd(const ScreenTriangle& triangle, int32_t y0, int32_t y1) {
+
+#ifdef FVE_OCCLUSION_SSE2
+		float* depth = levels[0].data();
+
+		const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+		const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+		const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+		const __m128 depthDx = _mm_set1_ps(triangle.depthDx);
+		const __m128 maxDepth = _mm_set1_ps(triangle.maxDepth);
+
+		// width is a multiple of four, so groups starting on a multiple of four never run past a row
+		int32_t xStart = triangle.minX & ~3;
+
+		for (int32_t y = y0; y < y1; y++) {
+			float py = float(y) + 0.5f;
+			__m128 row0 = _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+			__m128 row1 = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+			__m128 row2 = _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+			__m128 rowDepth = _mm_set1_ps(triangle.depthDy * py + triangle.depth0);
+
+			float* row = depth + size_t(y) * width;
+			for (int32_t x = xStart; x <= triangle.maxX; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, px), row0), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, px), row1), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, px), row2), zero));
+				if (_mm_movemask_ps(inside) == 0) continue;
+
+				__m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthDx, px), rowDepth), maxDepth);
+				__m128 stored = _mm_loadu_ps(row + x);
+				__m128 closer = _mm_min_ps(stored, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, stored)));
+			}
+		}
+#else
+		rasterizeRowsScalar(triangle, y0, y1);
+#endif
+
+	}
+
+	void FveOcclusionBuffer::buildHierarchy() {
+
+		for (size_t level = 1; level < levels.size(); level++) {
+			const std::vector<float>& source = levels[level - 1];
+			std::vector<float>& target = levels[level];
+			uint32_t sourceWidth = levelWidths[level - 1];
+			uint32_t sourceHeight = levelHeights[level - 1];
+
+			for (uint32_t y = 0; y < levelHeights[level]; y++) {
+				uint32_t sy0 = y * 2;
+				uint32_t sy1 = std::min(sy0 + 1, sourceHeight - 1);
+				for (uint32_t x = 0; x < levelWidths[level]; x++) {
+					uint32_t sx0 = x * 2;
+					uint32_t sx1 = std::min(sx0 + 1, sourceWidth - 1);
+					float farthest = std::max(
+						std::max(source[size_t(sy0) * sourceWidth + sx0], source[size_t(sy0) * sourceWidth + sx1]),
+						std::max(source[size_t(sy1) * sourceWidth + sx0], source[size_t(sy1) * sourceWidth + sx1]));
+					target[size_t(y) * levelWidths[level] + x] = farthest;
+				}
+			}
+		}
+
+	}
+
+	bool FveOcclusionBuffer::isOccluded(const Aabb& worldBounds, const glm::mat4& viewProjection) const {
+
+		float minX = std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max();
+		float maxX = -std::numeric_limits<float>::max();
+		float maxY = -std::numeric_limits<float>::max();
+		float nearestDepth = std::numeric_limits<float>::max();
+
+		for (int corner = 0; corner < 8; corner++) {
+			glm::vec3 position{
+				(corner & 1) ? worldBounds.max.x : worldBounds.min.x,
+				(corner & 2) ? worldBounds.max.y : worldBounds.min.y,
+				(corner & 4) ? worldBounds.max.z : worldBounds.min.z };
+			glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+
+			// reaching through the near plane, can't be behind anything
+			if (clip.w <= 0.0f || clip.z < 0.0f) return false;
+
+			float inverseW = 1.0f / clip.w;
+			float sx = (clip.x * inverseW * 0.5f + 0.5f) * float(width);
+			float sy = (clip.y * inverseW * 0.5f + 0.5f) * float(height);
+			minX = std::min(minX, sx);
+			maxX = std::max(maxX, sx);
+			minY = std::min(minY, sy);
+			maxY = std::max(maxY, sy);
+			nearestDepth = std::min(nearestDepth, clip.z * inverseW);
+		}
+
+		// off screen is the frustum test's call
+		if (maxX < 0.0f || maxY < 0.0f || minX >= float(width) || minY >= float(height)) return false;
+
+		int32_t x0 = std::clamp(static_cast<int32_t>(std::floor(minX)), 0, int32_t(width) - 1);
+		int32_t x1 = std::clamp(static_cast<int32_t>(std::floor(maxX)), 0, int32_t(width) - 1);
+		int32_t y0 = std::clamp(static_cast<int32_t>(std::floor(minY)), 0, int32_t(height) - 1);
+		int32_t y1 = std::clamp(static_cast<int32_t>(std::floor(maxY)), 0, int32_t(height) - 1);
+
+		// coarsest level where the rectangle spans at most two texels each way
+		size_t level = 0;
+		while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+			level++;
+		}
+
+		const std::vector<float>& depth = levels[level];
+		uint32_t levelWidth = levelWidths[level];
+		for (int32_t y = y0 >> level; y <= (y1 >> level); y++) {
+			for (int32_t x = x0 >> level; x <= (x1 >> level); x++) {
+				if (depth[size_t(y) * levelWidth + x] >= nearestDepth) return false;
+			}
+		}
+		return true;
+
+	}
+
+}
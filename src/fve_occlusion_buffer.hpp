@@ -0,0 +1,75 @@
+#pragma once
+
+#include "fve_bounds.hpp"
+#include "fve_job_system.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace fve {
+
+	// Low resolution software depth buffer for occlusion culling. Occluder triangles are clipped
+	// against the near plane, set up once and binned into horizontal bands; bands are rasterized in
+	// parallel, four pixels at a time with SSE2 where available. Coverage is sampled at pixel centres
+	// like the GPU does, so a pixel an occluder only partly covers counts as covered and an object
+	// hiding in the uncovered part of an edge pixel can be culled; covering only whole pixels would
+	// instead crack every occluder along its internal edges. The depth written is the farthest the
+	// triangle reaches inside the pixel, so it is never nearer than the occluder. A max-depth
+	// pyramid over the result answers occludee tests with a handful of texel reads.
+	// Depth runs zero (near) to one (far) like the swap chain's.
+	class FveOcclusionBuffer {
+	public:
+		// width must be a multiple of four
+		FveOcclusionBuffer(uint32_t width, uint32_t height);
+
+		void clear();
+
+		// clips, projects and bins the triangles of one occluder; indices may be empty for a plain triangle list
+		void addOccluder(const glm::mat4& worldViewProjection, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+		// rasterizes the binned triangles, bands spread over jobs when given, then rebuilds the pyramid
+		void rasterize(FveJobSystem* jobs);
+
+		// true if the box is certainly hidden behind what was rasterized
+		bool isOccluded(const Aabb& worldBounds, const glm::mat4& viewProjection) const;
+
+		// same rasterization without SIMD, to check the fast path against
+		void setForceScalar(bool forceScalar) { this->forceScalar = forceScalar; }
+
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		size_t getTriangleCount() const { return triangles.size(); }
+		const std::vector<float>& getDepth() const { return levels[0]; }
+
+	private:
+		// edge functions A * x + B * y + C, non-negative inside; depth is a plane in screen space
+		struct ScreenTriangle {
+			float edgeA[3], edgeB[3], edgeC[3];
+			float depth0, depthDx, depthDy;
+			float maxDepth;
+			int32_t minX, maxX, minY, maxY;
+		};
+
+		static constexpr uint32_t BAND_HEIGHT = 16;
+
+		void setupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2);
+		void rasterizeBand(uint32_t band);
+		void rasterizeRowsScalar(const ScreenTriangle& triangle, int32_t y0, int32_t y1);
+		void rasterizeRowsSimd(const ScreenTriangle& triangle, int32_t y0, int32_t y1);
+		void buildHierarchy();
+
+		uint32_t width;
+		uint32_t height;
+		bool forceScalar = false;
+
+		std::vector<glm::vec4> clipVertices;
+		std::vector<ScreenTriangle> triangles;
+		std::vector<std::vector<uint32_t>> bins;
+
+		// level 0 is the depth buffer, every further level holds the max of a 2x2 block
+		std::vector<std::vector<float>> levels;
+		std::vector<uint32_t> levelWidths;
+		std::vector<uint32_t> levelHeights;
+	};
+
+}
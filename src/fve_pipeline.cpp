@@ -2,50 +2,84 @@
 #include "fve_model.hpp"
 #include "fve_assets.hpp"
 
-#include <fstream>
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
 
-#ifndef ENGINE_DIR
-#define ENGINE_DIR "../"
-#endif
-
 namespace fve {
 
 	FvePipeline::FvePipeline(FveDevice& device, const std::string& vertFilePath,
-		const std::string& fragFilePath, const PipelineConfigInfo& configInfo, const std::string& materialName) : fveDevice{ device } {
-		createGraphicsPipeline(vertFilePath, fragFilePath, configInfo, materialName);
+		const std::string& fragFilePath, const PipelineConfigInfo& configInfo, const std::string& materialName)
+		: fveDevice{ device }, vertFilePath{ vertFilePath }, fragFilePath{ fragFilePath }, materialName{ materialName } {
+
+		copyConfigInfo(configInfo, this->configInfo);
+
+		auto vertCode = readFile(vertFilePath);
+		auto fragCode = readFile(fragFilePath);
+
+		//std::cout << "Vertex Shader Code Size:   " << vertCode.size() << std::endl;
+		//std::cout << "Fragment Shader Code Size: " << fragCode.size() << std::endl;
+
+		createShaderModule(vertCode, &vertShaderModule);
+		createShaderModule(fragCode, &fragShaderModule);
+
+		createGraphicsPipeline();
+
+		fveAssets.registerShaderPipeline(vertFilePath, this);
+		fveAssets.registerShaderPipeline(fragFilePath, this);
 	}
 
 	FvePipeline::~FvePipeline() {
+		fveAssets.unregisterShaderPipeline(this);
 		vkDestroyShaderModule(fveDevice.device(), vertShaderModule, nullptr);
 		vkDestroyShaderModule(fveDevice.device(), fragShaderModule, nullptr);
 		vkDestroyPipeline(fveDevice.device(), graphicsPipeline, nullptr);
 	}
 
-	std::vector<char> FvePipeline::readFile(const std::string& filepath) {
+	FveFileData FvePipeline::readFile(const std::string& filepath) {
+		return fveVfs.readFile(filepath);
+	}
 
-		std::string enginePath = ENGINE_DIR + filepath;
+	void FvePipeline::copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst) {
+		dst.bindingDescriptions = src.bindingDescriptions;
+		dst.attributeDescriptions = src.attributeDescriptions;
+		dst.viewportInfo = src.viewportInfo;
+		dst.inputAssemblyInfo = src.inputAssemblyInfo;
+		dst.rasterizationInfo = src.rasterizationInfo;
+		dst.multisampleInfo = src.multisampleInfo;
+		dst.colorBlendAttachment = src.colorBlendAttachment;
+		dst.colorBlendInfo = src.colorBlendInfo;
+		dst.depthStencilInfo = src.depthStencilInfo;
+		dst.dynamicStateEnables = src.dynamicStateEnables;
+		dst.dynamicStateInfo = src.dynamicStateInfo;
+		dst.pipelineLayout = src.pipelineLayout;
+		dst.renderPass = src.renderPass;
+		dst.subpass = src.subpass;
+
+		// re-point the internal pointers at the copy
+		dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+		dst.dynamicStateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+	}
 
-		std::ifstream file{ enginePath, std::ios::ate | std::ios::binary };
+	void FvePipeline::reloadShader(const std::string& filePath, const FveFileData& code) {
 
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file " + filepath);
+		if (filePath == vertFilePath) {
+			vkDestroyShaderModule(fveDevice.device(), vertShaderModule, nullptr);
+			createShaderModule(code, &vertShaderModule);
+		}
+		if (filePath == fragFilePath) {
+			vkDestroyShaderModule(fveDevice.device(), fragShaderModule, nullptr);
+			createShaderModule(code, &fragShaderModule);
 		}
 
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-		file.close();
+		vkDestroyPipeline(fveDevice.device(), graphicsPipeline, nullptr);
+		createGraphicsPipeline();
 
-		return buffer;
+		std::cout << "Reloaded pipeline " << materialName << " (" << filePath << ")" << std::endl;
 
 	}
 
-	void FvePipeline::createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo, const std::string& materialName) {
+	void FvePipeline::createGraphicsPipeline() {
 
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -54,15 +88,6 @@ namespace fve {
 			configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-		auto vertCode = readFile(vertFilePath);
-		auto fragCode = readFile(fragFilePath);
-
-		//std::cout << "Vertex Shader Code Size:   " << vertCode.size() << std::endl;
-		//std::cout << "Fragment Shader Code Size: " << fragCode.size() << std::endl;
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
-
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -117,7 +142,7 @@ namespace fve {
 
 	}
 
-	void FvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+	void FvePipeline::createShaderModule(const FveFileData& code, VkShaderModule* shaderModule) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
@@ -132,6 +157,45 @@ namespace fve {
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
+	FveComputePipeline::FveComputePipeline(FveDevice& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout)
+		: fveDevice{ device } {
+
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+		auto compCode = fveVfs.readFile(compFilePath);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = compCode.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+		if (vkCreateShaderModule(fveDevice.device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(fveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+	}
+
+	FveComputePipeline::~FveComputePipeline() {
+		vkDestroyShaderModule(fveDevice.device(), compShaderModule, nullptr);
+		vkDestroyPipeline(fveDevice.device(), computePipeline, nullptr);
+	}
+
+	void FveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
 	void FvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
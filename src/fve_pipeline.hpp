@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fve_device.hpp"
+#include "fve_vfs.hpp"
 
 #include <string>
 #include <vector>
@@ -38,19 +39,46 @@ namespace fve {
 
 		void bind(VkCommandBuffer commandBuffer);
 
+		// rebuilds the pipeline around new SPIR-V for one of its stages; the GPU must be idle
+		void reloadShader(const std::string& filePath, const FveFileData& code);
+
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 		
 	private:
-		static std::vector<char> readFile(const std::string& filepath);
+		static FveFileData readFile(const std::string& filepath);
+		static void copyConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
 		FveDevice& fveDevice;
 		VkPipeline graphicsPipeline;
 		VkShaderModule vertShaderModule;
 		VkShaderModule fragShaderModule;
 
-		void createGraphicsPipeline(const std::string& vertFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo, const std::string& materialName);
+		// kept around so the pipeline can be rebuilt when a shader changes on disk
+		std::string vertFilePath;
+		std::string fragFilePath;
+		std::string materialName;
+		PipelineConfigInfo configInfo;
+
+		void createGraphicsPipeline();
+
+		void createShaderModule(const FveFileData& code, VkShaderModule* shaderModule);
+	};
+
+	// single compute stage pipeline, the layout is owned by whoever dispatches it
+	class FveComputePipeline {
+	public:
+		FveComputePipeline(FveDevice& device, const std::string& compFilePath, VkPipelineLayout pipelineLayout);
+		~FveComputePipeline();
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		FveComputePipeline(const FveComputePipeline&) = delete;
+		FveComputePipeline& operator=(const FveComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		FveDevice& fveDevice;
+		VkPipeline computePipeline;
+		VkShaderModule compShaderModule;
 	};
 
 
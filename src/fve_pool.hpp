@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace fve {
+
+	// index into an FvePool; typed so handles of different pools can't be mixed up
+	template<typename T>
+	struct PoolHandle {
+		static constexpr uint32_t INVALID = ~0u;
+
+		uint32_t index = INVALID;
+
+		bool valid() const { return index != INVALID; }
+		bool operator==(const PoolHandle& other) const { return index == other.index; }
+		bool operator!=(const PoolHandle& other) const { return index != other.index; }
+	};
+
+	// Typed object pool. Objects live in fixed size pages, so growing never moves them and both
+	// pointers and indices stay stable; released slots are recycled through a free list, so a
+	// reserved pool allocates nothing while objects come and go.
+	template<typename T, size_t PAGE_SIZE = 256>
+	class FvePool {
+	public:
+		using Handle = PoolHandle<T>;
+
+		FvePool() = default;
+		~FvePool() { clear(); }
+
+		FvePool(const FvePool&) = delete;
+		FvePool& operator=(const FvePool&) = delete;
+
+		template<typename... Args>
+		Handle allocate(Args&&... args) {
+			uint32_t index;
+			if (!freeList.empty()) {
+				index = freeList.back();
+				freeList.pop_back();
+			}
+			else {
+				if (highWater == pages.size() * PAGE_SIZE) addPage();
+				index = highWater++;
+				alive.push_back(false);
+			}
+
+			new (slot(index)) T{ std::forward<Args>(args)... };
+			alive[index] = true;
+			liveCount++;
+			return Handle{ index };
+		}
+
+		void release(Handle handle) {
+			assert(contains(handle) && "Releasing a handle that is not alive");
+			slot(handle.index)->~T();
+			alive[handle.index] = false;
+			freeList.push_back(handle.index);
+			liveCount--;
+		}
+
+		bool contains(Handle handle) const {
+			return handle.index < highWater && alive[handle.index];
+		}
+
+		T& get(Handle handle) {
+			assert(contains(handle) && "Invalid pool handle");
+			return *slot(handle.index);
+		}
+
+		const T& get(Handle handle) const {
+			assert(contains(handle) && "Invalid pool handle");
+			return *slot(handle.index);
+		}
+
+		// makes room for count live objects without allocating afterwards
+		void reserve(size_t count) {
+			while (pages.size() * PAGE_SIZE < count) addPage();
+			alive.reserve(count);
+			freeList.reserve(count);
+		}
+
+		// f(Handle, T&) for every live object, in index order
+		template<typename F>
+		void each(F&& f) {
+			for (uint32_t index = 0; index < highWater; index++) {
+				if (alive[index]) f(Handle{ index }, *slot(index));
+			}
+		}
+
+		void clear() {
+			for (uint32_t index = 0; index < highWater; index++) {
+				if (alive[index]) slot(index)->~T();
+			}
+			alive.clear();
+			freeList.clear();
+			highWater = 0;
+			liveCount = 0;
+		}
+
+		size_t size() const { return liveCount; }
+
+	private:
+		struct Page {
+			alignas(T) unsigned char storage[PAGE_SIZE * sizeof(T)];
+		};
+
+		T* slot(uint32_t index) {
+			return std::launder(reinterpret_cast<T*>(pages[index / PAGE_SIZE]->storage) + index % PAGE_SIZE);
+		}
+
+		const T* slot(uint32_t index) const {
+			return std::launder(reinterpret_cast<const T*>(pages[index / PAGE_SIZE]->storage) + index % PAGE_SIZE);
+		}
+
+		void addPage() {
+			pages.push_back(std::make_unique<Page>());
+		}
+
+		std::vector<std::unique_ptr<Page>> pages;
+		std::vector<bool> alive;
+		std::vector<uint32_t> freeList;
+		uint32_t highWater = 0;
+		size_t liveCount = 0;
+	};
+
+}
@@ -0,0 +1,408 @@
+#include "fve_render_queue.hpp"
+
+#include "fve_memory.hpp"
+#include "fve_job_system.hpp"
+#include "fve_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace fve {
+
+	static constexpr uint32_t LAYER_BITS = 4;
+	static constexpr uint32_t PIPELINE_BITS = 12;
+	static constexpr uint32_t DESCRIPTOR_SET_BITS = 8;
+	static constexpr uint32_t MESH_BITS = 16;
+	static constexpr uint32_t DEPTH_BITS = 24;
+	static_assert(LAYER_BITS + PIPELINE_BITS + DESCRIPTOR_SET_BITS + MESH_BITS + DEPTH_BITS == 64, "Sort key must fill 64 bits");
+
+	// below this a comparison sort beats eight counting passes
+	static constexpr size_t RADIX_SORT_THRESHOLD = 64;
+
+	// fewer batches than this aren't worth a secondary command buffer and a job of their own
+	static constexpr size_t BATCHES_PER_CHUNK = 128;
+
+	FveRenderQueue::FveRenderQueue(FveDevice& device)
+		: device{ device }, instances{ device },
+		multiDrawIndirect{ device.supportsMultiDrawIndirect() },
+		maxDrawCount{ device.properties.limits.maxDrawIndirectCount } {
+		commandCapacities.fill(256);
+	}
+
+	void FveRenderQueue::extract(FrameInfo& frameInfo) {
+
+		items.clear();
+		models.clear();
+		transforms.clear();
+		descriptorSets.clear();
+		stats = RenderQueueStats{};
+
+		glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+
+		// the state part of the key only changes with the model, and neighbours mostly share one
+		FveModel* lastModel = nullptr;
+		uint64_t stateKey = 0;
+
+		auto addItem = [&](RenderLayer layer, VkDescriptorSet descriptorSet, FveModel* model, const WorldTransformComponent& transform) {
+			if (model != lastModel) {
+				lastModel = model;
+				stateKey = (uint64_t{ static_cast<uint32_t>(layer) } << (PIPELINE_BITS + DESCRIPTOR_SET_BITS + MESH_BITS))
+					| (uint64_t{ idOf(pipelineIds, model->getMaterial().pipeline, PIPELINE_BITS) } << (DESCRIPTOR_SET_BITS + MESH_BITS))
+					| (uint64_t{ idOf(descriptorSetIds, descriptorSet, DESCRIPTOR_SET_BITS) } << MESH_BITS)
+					| idOf(meshIds, &model->getMesh(), MESH_BITS);
+			}
+
+			// the bits of a positive float order like the float, the top 24 keep the exponent and most of the mantissa
+			glm::vec3 offset = glm::vec3(transform.matrix[3]) - cameraPosition;
+			float distanceSquared = glm::dot(offset, offset);
+			uint32_t depthBits;
+			std::memcpy(&depthBits, &distanceSquared, sizeof(depthBits));
+
+			items.push_back(DrawItem{ (stateKey << DEPTH_BITS) | (depthBits >> (32 - DEPTH_BITS)), static_cast<uint32_t>(models.size()) });
+			models.push_back(model);
+			transforms.push_back(&transform);
+			descriptorSets.push_back(descriptorSet);
+		};
+
+		// textured objects are drawn by the textured render system
+		auto simple = frameInfo.world.query<WorldTransformComponent, ModelComponent, BoundsComponent>(Exclude<TextureComponent>{});
+		simple.each([&](Entity, WorldTransformComponent& transform, ModelComponent& model, BoundsComponent& bounds) {
+			// outside the camera frustum, or its mesh is still uploading
+			if (!bounds.visible || model.model == nullptr || !model.model->getMesh().resident) return;
+			addItem(RenderLayer::Simple, frameInfo.globalDescriptorSet, model.model, transform);
+		});
+
+		lastModel = nullptr;
+		auto textured = frameInfo.world.query<WorldTransformComponent, ModelComponent, TextureComponent, BoundsComponent>();
+		textured.each([&](Entity, WorldTransformComponent& transform, ModelComponent& model, TextureComponent&, BoundsComponent& bounds) {
+			if (!bounds.visible || model.model == nullptr || !model.model->getMesh().resident) return;
+			addItem(RenderLayer::Textured, frameInfo.texturedDescriptorSet, model.model, transform);
+		});
+
+		radixSort(items, scratch);
+
+		// runs sharing pipeline, descriptor set and mesh become one instanced draw; ids can wrap, so compare the real state
+		for (auto& layerBatches : batches) layerBatches.clear();
+		uint32_t count = static_cast<uint32_t>(items.size());
+		InstanceData* instanceData = count > 0 ? instances.map(frameInfo.frameIndex, count) : nullptr;
+
+		Batch* batch = nullptr;
+		size_t batchLayer = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			const DrawItem& item = items[i];
+			FveModel* model = models[item.index];
+			Material* material = &model->getMaterial();
+			VkDescriptorSet descriptorSet = descriptorSets[item.index];
+			size_t layer = static_cast<size_t>(item.key >> (64 - LAYER_BITS));
+
+			bool sameBatch = batch != nullptr && batchLayer == layer
+				&& batch->material->pipeline == material->pipeline && batch->descriptorSet == descriptorSet
+				&& &batch->model->getMesh() == &model->getMesh();
+			if (!sameBatch) {
+				batch = &batches[layer].emplace_back(Batch{ material, descriptorSet, model, i, 0, 0 });
+				batchLayer = layer;
+			}
+			batch->instanceCount++;
+
+			InstanceData& data = instanceData[i];
+			data.modelMatrix = transforms[item.index]->matrix;
+			data.normalMatrix = transforms[item.index]->normalMatrix;
+		}
+		instances.flush(frameInfo.frameIndex, count);
+
+		// the commands follow the batches, so a run of batches is a run of commands
+		uint32_t commandCount = 0;
+		for (auto& layerBatches : batches) {
+			for (Batch& layerBatch : layerBatches) layerBatch.command = commandCount++;
+		}
+		if (multiDrawIndirect && commandCount > 0) {
+			VkDrawIndexedIndirectCommand* commands = mapCommands(frameInfo.frameIndex, commandCount);
+			for (const auto& layerBatches : batches) {
+				for (const Batch& layerBatch : layerBatches) {
+					const Mesh& mesh = layerBatch.model->getMesh();
+					commands[layerBatch.command] = VkDrawIndexedIndirectCommand{
+						mesh.indexCount, layerBatch.instanceCount, mesh.firstIndex, mesh.vertexOffset, layerBatch.firstInstance };
+				}
+			}
+			commandBuffers[frameInfo.frameIndex]->flush(commandCount * sizeof(VkDrawIndexedIndirectCommand));
+		}
+
+		// everything a recorded layer depends on besides the per-frame buffers' contents
+		for (size_t layer = 0; layer < batches.size(); layer++) {
+			uint64_t key = fnv1a64(&multiDrawIndirect, sizeof(multiDrawIndirect));
+			for (const Batch& layerBatch : batches[layer]) {
+				const Mesh& mesh = layerBatch.model->getMesh();
+				VkBuffer indexBuffer = mesh.hasIndexBuffer ? mesh.getIndexBuffer() : VK_NULL_HANDLE;
+				// eight draw words keep the struct free of padding, which would hash as garbage
+				struct {
+					VkPipeline pipeline;
+					VkPipelineLayout pipelineLayout;
+					VkDescriptorSet descriptorSet;
+					VkBuffer vertexBuffer;
+					VkBuffer indexBuffer;
+					uint32_t draw[8];
+				} state{ layerBatch.material->pipeline, layerBatch.material->pipelineLayout, layerBatch.descriptorSet, mesh.getVertexBuffer(), indexBuffer,
+					{ mesh.hasIndexBuffer, mesh.vertexCount, mesh.indexCount, mesh.firstIndex, static_cast<uint32_t>(mesh.vertexOffset),
+						layerBatch.firstInstance, layerBatch.instanceCount, layerBatch.command } };
+				key = fnv1a64(&state, sizeof(state), key);
+			}
+			layerKeys[layer] = key;
+		}
+
+		stats.items = count;
+		stats.batches = commandCount;
+
+	}
+
+	void FveRenderQueue::record(FrameInfo& frameInfo, RenderLayer layer) {
+
+		const std::vector<Batch>& layerBatches = batches[static_cast<size_t>(layer)];
+		if (layerBatches.empty()) return;
+
+		auto addRecorded = [this](const RenderQueueStats& recorded) {
+			stats.draws += recorded.draws;
+			stats.pipelineBinds += recorded.pipelineBinds;
+			stats.descriptorBinds += recorded.descriptorBinds;
+			stats.bufferBinds += recorded.bufferBinds;
+		};
+
+		// the same as last frame is taken as static, recorded once and replayed until it changes
+		size_t layerIndex = static_cast<size_t>(layer);
+		bool unchanged = layerKeys[layerIndex] == previousKeys[layerIndex];
+		previousKeys[layerIndex] = layerKeys[layerIndex];
+		if (retained && unchanged) {
+			uint32_t generations[2] = { instances.getGeneration(frameInfo.frameIndex), commandGenerations[frameInfo.frameIndex] };
+			uint64_t key = fnv1a64(generations, sizeof(generations), layerKeys[layerIndex]);
+
+			VkCommandBuffer commandBuffer = frameInfo.commands.beginRetained(frameInfo.commands.reserve(1), retainedCommands[layerIndex], key);
+			if (commandBuffer == VK_NULL_HANDLE) {
+				stats.replays++;
+				return;
+			}
+
+			RenderQueueStats recorded{};
+			recordBatches(commandBuffer, frameInfo.frameIndex, layerBatches, 0, layerBatches.size(), recorded);
+			frameInfo.commands.end(commandBuffer);
+			addRecorded(recorded);
+			stats.secondaries++;
+			return;
+		}
+
+		// contiguous chunks in their own secondaries, reserved in order so the draw order survives
+		size_t chunkCount = std::min(fveJobs.threadCount(), (layerBatches.size() + BATCHES_PER_CHUNK - 1) / BATCHES_PER_CHUNK);
+		uint32_t firstSlot = frameInfo.commands.reserve(static_cast<uint32_t>(chunkCount));
+		chunkStats.assign(chunkCount, RenderQueueStats{});
+
+		fveJobs.parallelFor(0, chunkCount, 1, [&](size_t begin, size_t end) {
+			for (size_t chunk = begin; chunk < end; chunk++) {
+				VkCommandBuffer commandBuffer = frameInfo.commands.begin(firstSlot + static_cast<uint32_t>(chunk));
+				if (commandBuffer == VK_NULL_HANDLE) continue;
+				recordBatches(commandBuffer, frameInfo.frameIndex, layerBatches,
+					layerBatches.size() * chunk / chunkCount, layerBatches.size() * (chunk + 1) / chunkCount, chunkStats[chunk]);
+				frameInfo.commands.end(commandBuffer);
+			}
+		});
+
+		for (const RenderQueueStats& chunk : chunkStats) addRecorded(chunk);
+		stats.secondaries += static_cast<uint32_t>(chunkCount);
+
+	}
+
+	void FveRenderQueue::recordBatches(VkCommandBuffer commandBuffer, int frameIndex, const std::vector<Batch>& layerBatches, size_t first, size_t last, RenderQueueStats& recorded) const {
+
+		// a secondary starts with nothing bound
+		instances.bind(commandBuffer, frameIndex);
+		recorded.bufferBinds++;
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		VkDescriptorSet boundSet = VK_NULL_HANDLE;
+		VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+
+		for (size_t i = first; i < last;) {
+			const Batch& batch = layerBatches[i];
+
+			if (batch.material->pipeline != boundPipeline) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipeline);
+				boundPipeline = batch.material->pipeline;
+				recorded.pipelineBinds++;
+			}
+
+			// a different layout may not keep set 0 compatible, so rebind with it
+			if (batch.descriptorSet != boundSet || batch.material->pipelineLayout != boundLayout) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout, 0, 1, &batch.descriptorSet, 0, nullptr);
+				boundSet = batch.descriptorSet;
+				boundLayout = batch.material->pipelineLayout;
+				recorded.descriptorBinds++;
+			}
+
+			// meshes in the arena share one vertex and index buffer
+			const Mesh& mesh = batch.model->getMesh();
+			if (mesh.getVertexBuffer() != boundVertexBuffer) {
+				batch.model->bind(commandBuffer);
+				boundVertexBuffer = mesh.getVertexBuffer();
+				recorded.bufferBinds++;
+			}
+
+			// the arena neighbours this pipeline and descriptor set draw too
+			size_t end = i + 1;
+			if (multiDrawIndirect && mesh.isInArena()) {
+				while (end < last && end - i < maxDrawCount
+					&& layerBatches[end].material->pipeline == batch.material->pipeline
+					&& layerBatches[end].material->pipelineLayout == batch.material->pipelineLayout
+					&& layerBatches[end].descriptorSet == batch.descriptorSet
+					&& layerBatches[end].model->getMesh().isInArena()) {
+					end++;
+				}
+			}
+
+			if (end - i > 1) {
+				vkCmdDrawIndexedIndirect(commandBuffer,
+					commandBuffers[frameIndex]->getAllocatedBuffer().buffer,
+					batch.command * sizeof(VkDrawIndexedIndirectCommand),
+					static_cast<uint32_t>(end - i), sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else {
+				batch.model->drawInstanced(commandBuffer, batch.instanceCount, batch.firstInstance);
+			}
+			recorded.draws++;
+			i = end;
+		}
+
+	}
+
+	VkDrawIndexedIndirectCommand* FveRenderQueue::mapCommands(int frameIndex, uint32_t count) {
+
+		// this frame's buffer was last read by the GPU before its fence was waited on
+		uint32_t& capacity = commandCapacities[frameIndex];
+		std::unique_ptr<FveBuffer>& buffer = commandBuffers[frameIndex];
+		if (buffer == nullptr || count > capacity) {
+			while (capacity < count) capacity *= 2;
+			buffer = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(VkDrawIndexedIndirectCommand), capacity,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "renderQueueCommands");
+			buffer->map();
+			commandGenerations[frameIndex]++;
+		}
+		return static_cast<VkDrawIndexedIndirectCommand*>(buffer->getMappedMemory());
+
+	}
+
+	void FveRenderQueue::radixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch) {
+
+		size_t count = items.size();
+		if (count <= RADIX_SORT_THRESHOLD) {
+			std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+			return;
+		}
+		scratch.resize(count);
+
+		// the histograms of all eight bytes in one read
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (const DrawItem& item : items) {
+			for (uint32_t byte = 0; byte < 8; byte++) {
+				histograms[byte][(item.key >> (byte * 8)) & 0xff]++;
+			}
+		}
+
+		DrawItem* source = items.data();
+		DrawItem* destination = scratch.data();
+		for (uint32_t byte = 0; byte < 8; byte++) {
+			std::array<uint32_t, 256>& histogram = histograms[byte];
+			uint32_t shift = byte * 8;
+
+			// every key has the same byte here (layer and pipeline mostly do), nothing would move
+			if (histogram[(source[0].key >> shift) & 0xff] == count) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram) {
+				uint32_t size = bucket;
+				bucket = offset;
+				offset += size;
+			}
+			for (size_t i = 0; i < count; i++) {
+				destination[histogram[(source[i].key >> shift) & 0xff]++] = source[i];
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != items.data()) {
+			std::copy(source, source + count, items.data());
+		}
+
+	}
+
+	bool FveRenderQueue::validate() {
+
+		std::mt19937_64 rng{ 42 };
+		bool valid = true;
+
+		for (size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ 63 }, size_t{ 64 }, size_t{ 65 }, size_t{ 1000 }, size_t{ 100000 } }) {
+			for (int shared = 0; shared < 2; shared++) {
+				std::vector<DrawItem> items(count);
+				for (size_t i = 0; i < count; i++) {
+					uint64_t key = rng();
+					// like a real frame: one layer and a handful of pipelines and meshes, only depth varies much
+					if (shared == 1) key = (key & 0x0000000000ffffffull) | ((key % 3) << 24) | (uint64_t{ 1 } << 60);
+					items[i] = DrawItem{ key, static_cast<uint32_t>(i) };
+				}
+
+				std::vector<DrawItem> expected = items;
+				std::stable_sort(expected.begin(), expected.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+				std::vector<DrawItem> scratch;
+				radixSort(items, scratch);
+
+				bool same = std::equal(items.begin(), items.end(), expected.begin(), expected.end(),
+					[](const DrawItem& a, const DrawItem& b) { return a.key == b.key && a.index == b.index; });
+				if (!same) {
+					std::cerr << "Radix sort mismatch for " << count << (shared == 1 ? " shared" : " random") << " keys" << std::endl;
+					valid = false;
+				}
+			}
+		}
+
+		return valid;
+
+	}
+
+	void FveRenderQueue::benchmark(size_t count) {
+
+		using Clock = std::chrono::high_resolution_clock;
+		const int runs = 10;
+
+		// a scene of a few hundred meshes over a couple of pipelines, at random depths
+		std::mt19937_64 rng{ 1234 };
+		std::vector<DrawItem> source(count);
+		for (size_t i = 0; i < count; i++) {
+			uint64_t state = (uint64_t{ rng() % 2 } << 60) | (uint64_t{ rng() % 4 } << 48) | (uint64_t{ rng() % 300 } << 24);
+			source[i] = DrawItem{ state | (rng() & 0xffffff), static_cast<uint32_t>(i) };
+		}
+
+		auto time = [&](auto&& sort) {
+			double best = 1e30;
+			for (int run = 0; run < runs; run++) {
+				std::vector<DrawItem> items = source;
+				auto start = Clock::now();
+				sort(items);
+				best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+			return best;
+		};
+
+		std::vector<DrawItem> scratch;
+		double radix = time([&](std::vector<DrawItem>& items) { radixSort(items, scratch); });
+		double comparison = time([](std::vector<DrawItem>& items) {
+			std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+		});
+
+		std::cout << "Render queue sort, " << count << " draw items, best of " << runs << std::endl;
+		std::cout << "  std::sort  " << comparison << " ms" << std::endl;
+		std::cout << "  radix sort " << radix << " ms (" << comparison / std::max(radix, 1e-6) << "x)" << std::endl;
+
+	}
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_components.hpp"
+#include "fve_frame_info.hpp"
+#include "fve_instance_buffer.hpp"
+#include "fve_buffer.hpp"
+#include "fve_swap_chain.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	// which render system records an item; the most significant part of its sort key
+	enum class RenderLayer : uint32_t { Simple = 0, Textured = 1, Count };
+
+	// what recording the last extracted frame cost
+	struct RenderQueueStats {
+		uint32_t items = 0;
+		// instanced draws, before they are merged into multi draws
+		uint32_t batches = 0;
+		// draw calls recorded
+		uint32_t draws = 0;
+		// recorded in parallel, one per chunk of batches
+		uint32_t secondaries = 0;
+		// layers whose retained secondary was replayed without recording anything
+		uint32_t replays = 0;
+		uint32_t pipelineBinds = 0;
+		uint32_t descriptorBinds = 0;
+		uint32_t bufferBinds = 0;
+	};
+
+	// The visible models of a frame, extracted once into a flat array and sorted by a 64 bit key so
+	// draws sharing state end up next to each other. From the most significant bit the key holds
+	// layer (4) | pipeline (12) | descriptor set (8) | mesh (16) | depth (24), with depth ascending
+	// so opaque objects go front to back. Runs of items sharing the pipeline, descriptor set and mesh
+	// become one instanced draw, and recording only binds what differs from the previous draw.
+	// Where the device has multi draw indirect, neighbouring draws of meshes in the shared arena
+	// under one pipeline and descriptor set are written to an indirect buffer and go out as a
+	// single vkCmdDrawIndexedIndirect.
+	//
+	// In retained mode a layer whose batches came out the same as the frame before is recorded once
+	// into a secondary that is kept and replayed until they change. Transforms still stream through
+	// the instance buffer every frame, so a static camera over moving objects replays too as long as
+	// nothing appears, disappears or swaps mesh.
+	class FveRenderQueue {
+	public:
+		struct DrawItem {
+			uint64_t key;
+			// into the extracted models and transforms
+			uint32_t index;
+		};
+
+		explicit FveRenderQueue(FveDevice& device);
+
+		FveRenderQueue(const FveRenderQueue&) = delete;
+		FveRenderQueue& operator=(const FveRenderQueue&) = delete;
+
+		// collects, keys and sorts this frame's visible models and writes their instance data;
+		// after culling, before any layer is recorded
+		void extract(FrameInfo& frameInfo);
+
+		// records the draws of one layer into secondaries of the frame's render pass, split in chunks
+		// across the job system; on the main thread, in the order the layers should draw
+		void record(FrameInfo& frameInfo, RenderLayer layer);
+
+		// the last extract, and every record since
+		const RenderQueueStats& getStats() const { return stats; }
+
+		void setRetained(bool enabled) { retained = enabled; }
+		bool isRetained() const { return retained; }
+
+		// stable LSD radix sort on key, one pass per byte that isn't the same in every key
+		static void radixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch);
+
+		// radix sort against std::stable_sort on random and mostly shared keys
+		static bool validate();
+
+		// prints radix sort against std::sort for count items
+		static void benchmark(size_t count);
+
+	private:
+		// one instanced draw
+		struct Batch {
+			Material* material;
+			VkDescriptorSet descriptorSet;
+			FveModel* model;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			// its VkDrawIndexedIndirectCommand, the batches of a layer are consecutive
+			uint32_t command;
+		};
+
+		// batches [first, last) of a layer, on any job system thread
+		void recordBatches(VkCommandBuffer commandBuffer, int frameIndex, const std::vector<Batch>& layerBatches, size_t first, size_t last, RenderQueueStats& recorded) const;
+
+		// room for count commands in the frame's indirect buffer, grown like the instance buffer
+		VkDrawIndexedIndirectCommand* mapCommands(int frameIndex, uint32_t count);
+
+		// small, stable ids for the key; past 2^bits objects they wrap, which only costs sort quality
+		template<typename T>
+		static uint32_t idOf(std::unordered_map<T, uint32_t>& ids, T object, uint32_t bits) {
+			auto [entry, inserted] = ids.try_emplace(object, static_cast<uint32_t>(ids.size()));
+			return entry->second & ((1u << bits) - 1);
+		}
+
+		FveDevice& device;
+		FveInstanceBuffer instances;
+
+		bool multiDrawIndirect;
+		uint32_t maxDrawCount;
+		std::array<std::unique_ptr<FveBuffer>, FveSwapChain::MAX_FRAMES_IN_FLIGHT> commandBuffers{};
+		std::array<uint32_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> commandCapacities{};
+
+		// rebuilt every frame, reused to avoid reallocating
+		std::vector<DrawItem> items;
+		std::vector<DrawItem> scratch;
+		std::vector<FveModel*> models;
+		std::vector<const WorldTransformComponent*> transforms;
+		std::vector<VkDescriptorSet> descriptorSets;
+		std::array<std::vector<Batch>, static_cast<size_t>(RenderLayer::Count)> batches;
+		std::vector<RenderQueueStats> chunkStats;
+
+		bool retained = true;
+		// what the batches of each layer were built from, this frame and the one before
+		std::array<uint64_t, static_cast<size_t>(RenderLayer::Count)> layerKeys{};
+		std::array<uint64_t, static_cast<size_t>(RenderLayer::Count)> previousKeys{};
+		std::array<FveRetainedCommands, static_cast<size_t>(RenderLayer::Count)> retainedCommands{};
+		std::array<uint32_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> commandGenerations{};
+
+		std::unordered_map<VkPipeline, uint32_t> pipelineIds;
+		std::unordered_map<VkDescriptorSet, uint32_t> descriptorSetIds;
+		std::unordered_map<Mesh*, uint32_t> meshIds;
+
+		RenderQueueStats stats{};
+	};
+
+}
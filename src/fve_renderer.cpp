@@ -1,5 +1,6 @@
 #include "fve_renderer.hpp"
 #include "fve_memory.hpp"
+#include "fve_job_system.hpp"
 
 #include <iostream>
 #include <stdexcept>
@@ -10,12 +11,12 @@ namespace fve {
 
 	FveRenderer::FveRenderer(FveWindow& window, FveDevice& device) : window { window }, device{ device } {
 		recreateSwapChain();
-		createCommandBuffers();
+		// a pool for every thread that can record a secondary
+		frameCommands = std::make_unique<FveFrameCommands>(device, fveJobs.threadCount());
 	}
 
 	FveRenderer::~FveRenderer() {
 		std::cout << "Destroying renderer" << std::endl;
-		freeCommandBuffers();
 	}
 
 	void FveRenderer::recreateSwapChain() {
@@ -35,32 +36,14 @@ namespace fve {
 			if (!oldSwapChain->compareSwapFormats(*swapChain.get())) {
 				throw std::runtime_error("Swap chain image (or depth) format has changed!");
 			}
+
+			// recorded against the old render pass
+			frameCommands->invalidateRetained();
 		}
 		
 		// TODO
 	}
 
-	void FveRenderer::createCommandBuffers() {
-
-		commandBuffers.resize(FveSwapChain::MAX_FRAMES_IN_FLIGHT);
-
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = device.getCommandPool();
-		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
-
-		if (vkAllocateCommandBuffers(device.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate command buffers!");
-		}
-
-	}
-
-	void FveRenderer::freeCommandBuffers() {
-		vkFreeCommandBuffers(device.device(), device.getCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-		commandBuffers.clear();
-	}
-
 	VkCommandBuffer FveRenderer::beginFrame() {
 		assert(!isFrameStarted && "Can't call beginFrame() while already in progress");
 
@@ -78,6 +61,8 @@ namespace fve {
 		// this frame is now in progress
 		isFrameStarted = true;
 
+		// the fence waited on above covers everything this frame's pools last recorded
+		currentCommandBuffer = frameCommands->beginFrame(currentFrameIndex);
 		auto commandBuffer = getCurrentCommandBuffer();
 
 		VkCommandBufferBeginInfo beginInfo{};
@@ -131,24 +116,16 @@ namespace fve {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-		viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{ {0, 0}, swapChain->getSwapChainExtent() };
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		// the secondaries set viewport and scissor themselves, the primary may only execute them
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		frameCommands->beginPass(renderPassInfo.renderPass, renderPassInfo.framebuffer, renderPassInfo.renderArea.extent);
 	}
 
 	void FveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 		assert(isFrameStarted && "Can't call endSwapChainRenderPass() while frame is not in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
 
+		frameCommands->execute(commandBuffer);
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
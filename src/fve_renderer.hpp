@@ -5,6 +5,7 @@
 #include "fve_window.hpp"
 #include "fve_device.hpp"
 #include "fve_swap_chain.hpp"
+#include "fve_frame_commands.hpp"
 
 #include <cassert>
 #include <memory>
@@ -26,9 +27,12 @@ namespace fve {
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when a frame is not in progress");
-			return commandBuffers[currentFrameIndex];
+			return currentCommandBuffer;
 		}
 
+		// where the render systems get the secondaries the swap chain render pass is recorded into
+		FveFrameCommands& getFrameCommands() const { return *frameCommands; }
+
 		int getFrameIndex() const {
 			assert(isFrameStarted && "Cannot get frame index when a frame is not in progress");
 			return currentFrameIndex;
@@ -38,15 +42,25 @@ namespace fve {
 		VkCommandBuffer beginFrame();
 		void endFrame();
 
+		// the pass takes secondaries only, reserve and record them through getFrameCommands()
 		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
 		float getAspectRatio() const { return swapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return swapChain->getSwapChainExtent(); }
+
+		// depth attachment of the image being rendered, readable once the render pass has ended
+		VkImageView getDepthImageView() const {
+			assert(isFrameStarted && "Cannot get depth image view when a frame is not in progress");
+			return swapChain->getDepthImageView(currentImageIndex);
+		}
+		// executes the pass's secondaries in the order they were reserved, then ends it
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
 	private:
 		FveWindow& window;
 		FveDevice& device;
 		std::unique_ptr<FveSwapChain> swapChain;
-		std::vector<VkCommandBuffer> commandBuffers;
+		std::unique_ptr<FveFrameCommands> frameCommands;
+		VkCommandBuffer currentCommandBuffer = VK_NULL_HANDLE;
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex = 0;
@@ -55,8 +69,6 @@ namespace fve {
 		FveRenderer(const FveRenderer&) = delete;
 		FveRenderer& operator=(const FveRenderer&) = delete;
 
-		void createCommandBuffers();
-		void freeCommandBuffers();
 		void recreateSwapChain();
 	};
 
@@ -0,0 +1,504 @@
+#include "fve_scene.hpp"
+#include "fve_assets.hpp"
+#include "fve_vfs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace fve {
+
+	static const char SCENE_MAGIC[4] = { 'F', 'V', 'E', 'S' };
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// count elements of size bytes starting at offset end by limit, checked without overflowing
+	static bool fitsArray(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit) {
+		return offset <= limit && (size == 0 || count <= (limit - offset) / size);
+	}
+
+	namespace {
+
+		using Component = FveScene::Component;
+
+		// calls f(Component, std::type_identity<T>) for every component a scene can hold
+		template<typename F>
+		void forEachComponent(F&& f) {
+			f(Component::Transform, std::type_identity<TransformComponent>{});
+			f(Component::WorldTransform, std::type_identity<WorldTransformComponent>{});
+			f(Component::Interpolation, std::type_identity<InterpolationComponent>{});
+			f(Component::Parent, std::type_identity<ParentComponent>{});
+			f(Component::Color, std::type_identity<ColorComponent>{});
+			f(Component::Model, std::type_identity<ModelComponent>{});
+			f(Component::PointLight, std::type_identity<PointLightComponent>{});
+			f(Component::Texture, std::type_identity<TextureComponent>{});
+			f(Component::Bounds, std::type_identity<BoundsComponent>{});
+			f(Component::Occluder, std::type_identity<OccluderComponent>{});
+		}
+
+		// what a component is stored as; plain components as themselves, references as 32 bit indices
+		template<typename T> struct Stored { using Type = T; };
+		template<> struct Stored<ParentComponent> { using Type = uint32_t; };
+		template<> struct Stored<ModelComponent> { using Type = uint32_t; };
+		template<> struct Stored<TextureComponent> { using Type = uint32_t; };
+		template<> struct Stored<BoundsComponent> { using Type = uint32_t; };
+
+		template<typename T>
+		constexpr uint32_t storedStride() {
+			return std::is_empty_v<T> ? 0 : static_cast<uint32_t>(sizeof(typename Stored<T>::Type));
+		}
+
+		// assets and entity indices collected while writing
+		struct SaveContext {
+			std::unordered_map<Entity, uint32_t> sceneIndices;
+			std::vector<FveScene::AssetRef> assets;
+			std::string strings;
+			std::unordered_map<std::string, uint32_t> assetIndices[2];
+
+			uint32_t assetIndex(FveScene::AssetType type, const std::string& name) {
+				auto& indices = assetIndices[static_cast<uint32_t>(type)];
+				auto existing = indices.find(name);
+				if (existing != indices.end()) return existing->second;
+
+				uint32_t index = static_cast<uint32_t>(assets.size());
+				assets.push_back(FveScene::AssetRef{ type, static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size()), 0 });
+				strings += name;
+				indices.emplace(name, index);
+				return index;
+			}
+		};
+
+		// assets of the file resolved once, by asset index
+		struct LoadContext {
+			std::vector<FveScene::AssetType> types;
+			std::vector<FveModel*> models;
+			std::vector<TextureHandle> textures;
+
+			size_t checkedAsset(uint32_t index, FveScene::AssetType type) const {
+				if (index >= types.size() || types[index] != type) {
+					throw std::runtime_error("scene component refers to a missing asset");
+				}
+				return index;
+			}
+		};
+
+		// ================ Encoding ================
+
+		template<typename T>
+		void encode(const T* rows, size_t count, SaveContext&, T* out) {
+			static_assert(std::is_trivially_copyable_v<T>, "plain scene components are stored as raw bytes");
+			std::memcpy(out, rows, count * sizeof(T));
+		}
+
+		void encode(const TransformComponent* rows, size_t count, SaveContext&, TransformComponent* out) {
+			std::memcpy(out, rows, count * sizeof(TransformComponent));
+
+			// loaded entities need their world matrices built
+			for (size_t i = 0; i < count; i++) out[i].dirty = true;
+		}
+
+		void encode(const ParentComponent* rows, size_t count, SaveContext& context, uint32_t* out) {
+			for (size_t i = 0; i < count; i++) {
+				auto index = context.sceneIndices.find(rows[i].parent);
+				out[i] = index != context.sceneIndices.end() ? index->second : NULL_ENTITY;
+			}
+		}
+
+		void encode(const ModelComponent* rows, size_t count, SaveContext& context, uint32_t* out) {
+			for (size_t i = 0; i < count; i++) {
+				std::string modelId = fveAssets.getModelId(rows[i].model);
+				if (modelId.empty()) {
+					throw std::runtime_error("can't save a scene with a model that has no asset id");
+				}
+				out[i] = context.assetIndex(FveScene::AssetType::Model, modelId);
+			}
+		}
+
+		void encode(const TextureComponent* rows, size_t count, SaveContext& context, uint32_t* out) {
+			for (size_t i = 0; i < count; i++) {
+				std::string textureId = fveAssets.getTextureId(rows[i].texture);
+				if (textureId.empty()) {
+					throw std::runtime_error("can't save a scene with a texture that has no asset id");
+				}
+				out[i] = context.assetIndex(FveScene::AssetType::Texture, textureId);
+			}
+		}
+
+		// the rest of the bounds is rebuilt by the spatial system
+		void encode(const BoundsComponent* rows, size_t count, SaveContext&, uint32_t* out) {
+			for (size_t i = 0; i < count; i++) out[i] = static_cast<uint32_t>(rows[i].index);
+		}
+
+		// ================ Decoding ================
+
+		template<typename T>
+		void decode(const T* in, size_t count, const LoadContext&, T* rows) {
+			std::memcpy(rows, in, count * sizeof(T));
+		}
+
+		// left as scene indices, turned into entities once every block exists
+		void decode(const uint32_t* in, size_t count, const LoadContext&, ParentComponent* rows) {
+			for (size_t i = 0; i < count; i++) rows[i].parent = in[i];
+		}
+
+		void decode(const uint32_t* in, size_t count, const LoadContext& context, ModelComponent* rows) {
+			for (size_t i = 0; i < count; i++) {
+				rows[i].model = context.models[context.checkedAsset(in[i], FveScene::AssetType::Model)];
+			}
+		}
+
+		void decode(const uint32_t* in, size_t count, const LoadContext& context, TextureComponent* rows) {
+			for (size_t i = 0; i < count; i++) {
+				rows[i].texture = context.textures[context.checkedAsset(in[i], FveScene::AssetType::Texture)];
+			}
+		}
+
+		void decode(const uint32_t* in, size_t count, const LoadContext&, BoundsComponent* rows) {
+			for (size_t i = 0; i < count; i++) {
+				rows[i].index = in[i] == static_cast<uint32_t>(SpatialIndex::Grid) ? SpatialIndex::Grid : SpatialIndex::Tree;
+			}
+		}
+
+	}
+
+	// ================ Saving ================
+
+	std::vector<char> FveScene::serialize(FveWorld& world) {
+
+		struct Block {
+			Archetype* archetype;
+			SceneBlock header;
+			std::vector<char> columns[COMPONENT_COUNT];
+		};
+
+		SaveContext context;
+		std::vector<Block> blocks;
+		uint64_t entityCount = 0;
+
+		// every archetype holding something the format knows becomes a block; other components are runtime only
+		for (const auto& archetype : world.getArchetypes()) {
+			if (archetype->size() == 0) continue;
+
+			uint32_t components = 0;
+			forEachComponent([&](Component component, auto type) {
+				using T = typename decltype(type)::type;
+				if ((archetype->mask & componentMask<T>()) != 0) components |= 1u << static_cast<uint32_t>(component);
+			});
+			if (components == 0) continue;
+
+			Block& block = blocks.emplace_back();
+			block.archetype = archetype.get();
+			block.header = SceneBlock{};
+			block.header.components = components;
+			block.header.entityCount = archetype->size();
+			block.header.firstIndex = entityCount;
+
+			for (size_t row = 0; row < archetype->size(); row++) {
+				context.sceneIndices.emplace(archetype->entities[row], static_cast<uint32_t>(entityCount + row));
+			}
+			entityCount += archetype->size();
+		}
+
+		for (Block& block : blocks) {
+			size_t count = block.archetype->size();
+			forEachComponent([&](Component component, auto type) {
+				using T = typename decltype(type)::type;
+				uint32_t slot = static_cast<uint32_t>(component);
+				if ((block.header.components & (1u << slot)) == 0) return;
+
+				block.header.columns[slot].stride = storedStride<T>();
+				if constexpr (!std::is_empty_v<T>) {
+					std::vector<char>& bytes = block.columns[slot];
+					bytes.resize(count * sizeof(typename Stored<T>::Type));
+					encode(block.archetype->column<T>().data(), count, context, reinterpret_cast<typename Stored<T>::Type*>(bytes.data()));
+				}
+			});
+		}
+
+		// lay the file out: header, assets, blocks, names, then aligned columns
+		SceneHeader header{};
+		std::memcpy(header.magic, SCENE_MAGIC, 4);
+		header.version = SCENE_VERSION;
+		header.assetCount = static_cast<uint32_t>(context.assets.size());
+		header.blockCount = static_cast<uint32_t>(blocks.size());
+		header.entityCount = entityCount;
+		header.assetsOffset = alignUp(sizeof(SceneHeader), alignof(AssetRef));
+		header.blocksOffset = alignUp(header.assetsOffset + context.assets.size() * sizeof(AssetRef), alignof(SceneBlock));
+		header.stringsOffset = header.blocksOffset + blocks.size() * sizeof(SceneBlock);
+
+		uint64_t offset = alignUp(header.stringsOffset + context.strings.size(), SCENE_ALIGNMENT);
+		for (Block& block : blocks) {
+			for (uint32_t slot = 0; slot < COMPONENT_COUNT; slot++) {
+				if ((block.header.components & (1u << slot)) == 0) continue;
+				block.header.columns[slot].offset = offset;
+				offset = alignUp(offset + block.columns[slot].size(), SCENE_ALIGNMENT);
+			}
+		}
+		header.fileSize = offset;
+
+		std::vector<char> file(header.fileSize, 0);
+		std::memcpy(file.data(), &header, sizeof(header));
+		if (!context.assets.empty()) {
+			std::memcpy(file.data() + header.assetsOffset, context.assets.data(), context.assets.size() * sizeof(AssetRef));
+		}
+		for (size_t i = 0; i < blocks.size(); i++) {
+			std::memcpy(file.data() + header.blocksOffset + i * sizeof(SceneBlock), &blocks[i].header, sizeof(SceneBlock));
+		}
+		std::memcpy(file.data() + header.stringsOffset, context.strings.data(), context.strings.size());
+		for (Block& block : blocks) {
+			for (uint32_t slot = 0; slot < COMPONENT_COUNT; slot++) {
+				if (block.columns[slot].empty()) continue;
+				std::memcpy(file.data() + block.header.columns[slot].offset, block.columns[slot].data(), block.columns[slot].size());
+			}
+		}
+
+		return file;
+
+	}
+
+	void FveScene::save(FveWorld& world, const std::string& path) {
+
+		std::vector<char> file = serialize(world);
+
+		std::string enginePath = ENGINE_DIR + path;
+		std::ofstream out{ enginePath, std::ios::binary | std::ios::trunc };
+		if (!out.is_open()) {
+			throw std::runtime_error("failed to create scene " + path);
+		}
+		out.write(file.data(), file.size());
+		if (!out.good()) {
+			throw std::runtime_error("failed to write scene " + path);
+		}
+
+		const SceneHeader* header = reinterpret_cast<const SceneHeader*>(file.data());
+		std::cout << "Wrote scene " << path << ": " << header->entityCount << " entities in " << header->blockCount << " blocks, " << file.size() << " bytes" << std::endl;
+
+	}
+
+	// ================ Loading ================
+
+	size_t FveScene::load(FveWorld& world, const std::string& path) {
+
+		FveFileData data = fveVfs.readFile(path);
+		return load(world, data.data(), data.size());
+
+	}
+
+	size_t FveScene::load(FveWorld& world, const char* data, size_t size) {
+
+		// validate everything we are going to index into
+		if (size < sizeof(SceneHeader)) {
+			throw std::runtime_error("scene file is truncated");
+		}
+		const SceneHeader& header = *reinterpret_cast<const SceneHeader*>(data);
+		if (std::memcmp(header.magic, SCENE_MAGIC, 4) != 0 || header.version != SCENE_VERSION) {
+			throw std::runtime_error("not a scene file, or a different version");
+		}
+		if (header.fileSize > size
+			|| header.assetsOffset % alignof(AssetRef) != 0 || header.blocksOffset % alignof(SceneBlock) != 0
+			|| header.stringsOffset > header.fileSize
+			|| !fitsArray(header.assetsOffset, header.assetCount, sizeof(AssetRef), header.fileSize)
+			|| !fitsArray(header.blocksOffset, header.blockCount, sizeof(SceneBlock), header.stringsOffset)) {
+			throw std::runtime_error("scene file is corrupt");
+		}
+
+		const AssetRef* assets = reinterpret_cast<const AssetRef*>(data + header.assetsOffset);
+		const SceneBlock* blocks = reinterpret_cast<const SceneBlock*>(data + header.blocksOffset);
+		const char* strings = data + header.stringsOffset;
+
+		// one lookup per referenced asset, not per entity
+		LoadContext context;
+		context.types.resize(header.assetCount);
+		context.models.resize(header.assetCount, nullptr);
+		context.textures.resize(header.assetCount);
+		for (uint32_t i = 0; i < header.assetCount; i++) {
+			const AssetRef& asset = assets[i];
+			if (!fitsArray(asset.nameOffset, asset.nameLength, 1, header.fileSize - header.stringsOffset)) {
+				throw std::runtime_error("scene file is corrupt");
+			}
+			std::string name(strings + asset.nameOffset, asset.nameLength);
+
+			context.types[i] = asset.type;
+			if (asset.type == AssetType::Model) {
+				context.models[i] = fveAssets.getModel(name);
+				if (context.models[i] == nullptr) throw std::runtime_error("scene references unknown model " + name);
+			}
+			else if (asset.type == AssetType::Texture) {
+				context.textures[i] = fveAssets.getTextureHandle(name);
+				if (!context.textures[i].valid()) throw std::runtime_error("scene references unknown texture " + name);
+			}
+			else {
+				throw std::runtime_error("scene references an asset of unknown type");
+			}
+		}
+
+		// every block, column and reference is checked before the first entity is created, so a bad
+		// file leaves the world untouched. Tag components take no bytes, so the entity count is bound
+		// by what the world can still hold rather than by the file's size
+		uint64_t nextIndex = 0;
+		for (uint32_t b = 0; b < header.blockCount; b++) {
+			const SceneBlock& block = blocks[b];
+			if ((block.components >> COMPONENT_COUNT) != 0 || block.components == 0 || block.firstIndex != nextIndex
+				|| block.entityCount > header.entityCount - nextIndex) {
+				throw std::runtime_error("scene file is corrupt");
+			}
+			nextIndex += block.entityCount;
+
+			forEachComponent([&](Component component, auto type) {
+				using T = typename decltype(type)::type;
+				uint32_t slot = static_cast<uint32_t>(component);
+				if ((block.components & (1u << slot)) == 0) return;
+
+				const ColumnRef& column = block.columns[slot];
+				if (column.stride != storedStride<T>()) {
+					throw std::runtime_error("scene was saved with a different component layout");
+				}
+				if constexpr (!std::is_empty_v<T>) {
+					if (column.offset % SCENE_ALIGNMENT != 0 || !fitsArray(column.offset, block.entityCount, column.stride, header.fileSize)) {
+						throw std::runtime_error("scene file is corrupt");
+					}
+
+					[[maybe_unused]] const auto* in = reinterpret_cast<const typename Stored<T>::Type*>(data + column.offset);
+					if constexpr (std::is_same_v<T, ParentComponent>) {
+						for (uint64_t i = 0; i < block.entityCount; i++) {
+							if (in[i] != NULL_ENTITY && in[i] >= header.entityCount) throw std::runtime_error("scene file is corrupt");
+						}
+					}
+					else if constexpr (std::is_same_v<T, ModelComponent>) {
+						for (uint64_t i = 0; i < block.entityCount; i++) context.checkedAsset(in[i], AssetType::Model);
+					}
+					else if constexpr (std::is_same_v<T, TextureComponent>) {
+						for (uint64_t i = 0; i < block.entityCount; i++) context.checkedAsset(in[i], AssetType::Texture);
+					}
+				}
+			});
+		}
+		if (nextIndex != header.entityCount || header.entityCount > uint64_t{ ENTITY_INDEX_MASK } + 1 - world.entityCount()) {
+			throw std::runtime_error("scene file is corrupt");
+		}
+
+		forEachComponent([&](Component, auto type) { world.registerComponent<typename decltype(type)::type>(); });
+
+		std::vector<FveWorld::EntityBlock> created;
+		created.reserve(header.blockCount);
+		try {
+			for (uint32_t b = 0; b < header.blockCount; b++) {
+				const SceneBlock& block = blocks[b];
+
+				ComponentMask mask = 0;
+				forEachComponent([&](Component component, auto type) {
+					if ((block.components & (1u << static_cast<uint32_t>(component))) != 0) mask |= componentMask<typename decltype(type)::type>();
+				});
+
+				FveWorld::EntityBlock& rows = created.emplace_back(world.createEntities(mask, block.entityCount));
+
+				// a copy per column; references are mapped element by element
+				forEachComponent([&](Component component, auto type) {
+					using T = typename decltype(type)::type;
+					if constexpr (!std::is_empty_v<T>) {
+						const ColumnRef& column = block.columns[static_cast<uint32_t>(component)];
+						if ((block.components & (1u << static_cast<uint32_t>(component))) == 0) return;
+						decode(reinterpret_cast<const typename Stored<T>::Type*>(data + column.offset), block.entityCount, context, rows.column<T>());
+					}
+				});
+			}
+
+			// parents were loaded as scene indices
+			for (uint32_t b = 0; b < header.blockCount; b++) {
+				if ((blocks[b].components & (1u << static_cast<uint32_t>(Component::Parent))) == 0) continue;
+
+				ParentComponent* parents = created[b].column<ParentComponent>();
+				for (size_t i = 0; i < created[b].count; i++) {
+					uint32_t index = parents[i].parent;
+					if (index == NULL_ENTITY) continue;
+
+					auto owner = std::upper_bound(blocks, blocks + header.blockCount, index,
+						[](uint64_t value, const SceneBlock& block) { return value < block.firstIndex; }) - 1;
+					parents[i].parent = created[owner - blocks].entities()[index - owner->firstIndex];
+				}
+			}
+		}
+		catch (...) {
+			// out of memory most likely, the file itself was checked; take back what was created
+			std::vector<Entity> entities;
+			for (const FveWorld::EntityBlock& rows : created) entities.insert(entities.end(), rows.entities(), rows.entities() + rows.count);
+			for (Entity entity : entities) world.destroyEntity(entity);
+			throw;
+		}
+
+		return header.entityCount;
+
+	}
+
+	// ================ Benchmark ================
+
+	bool FveScene::benchmark(size_t count) {
+
+		using Clock = std::chrono::high_resolution_clock;
+		auto milliseconds = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+		// a level of props with every eighth one attached to the prop before it
+		auto start = Clock::now();
+		FveWorld source;
+		Entity previous = NULL_ENTITY;
+		for (size_t i = 0; i < count; i++) {
+			Entity entity = source.createEntity();
+			auto& transform = source.addComponent<TransformComponent>(entity);
+			transform.translation = { float(i % 1000), float(i / 1000), 0.0f };
+			source.addComponent<WorldTransformComponent>(entity);
+			if (i % 8 == 7) {
+				source.addComponent<ParentComponent>(entity, previous);
+			}
+			else {
+				source.addComponent<ColorComponent>(entity, glm::vec3{ float(i % 3), 0.5f, 1.0f });
+				source.addComponent<BoundsComponent>(entity, SpatialIndex::Grid);
+			}
+			previous = entity;
+		}
+		double createTime = milliseconds(Clock::now() - start);
+
+		start = Clock::now();
+		std::vector<char> file = serialize(source);
+		double saveTime = milliseconds(Clock::now() - start);
+
+		start = Clock::now();
+		FveWorld loaded;
+		size_t loadedCount = load(loaded, file.data(), file.size());
+		double loadTime = milliseconds(Clock::now() - start);
+
+		// same transforms in the same order, and every child attached to an entity at its parent's position
+		auto snapshot = [](FveWorld& world) {
+			std::vector<glm::vec3> values;
+			world.query<TransformComponent>(Exclude<ParentComponent>{}).each([&](Entity, TransformComponent& transform) {
+				values.push_back(transform.translation);
+			});
+			world.query<TransformComponent, ParentComponent>().each([&](Entity, TransformComponent& transform, ParentComponent& parent) {
+				values.push_back(transform.translation);
+				values.push_back(world.getComponent<TransformComponent>(parent.parent).translation);
+			});
+			return values;
+		};
+		bool valid = loadedCount == count && loaded.entityCount() == count && snapshot(source) == snapshot(loaded);
+
+		std::cout << "Scene benchmark, " << count << " entities, " << file.size() << " bytes" << std::endl;
+		std::cout << "  per entity creation " << createTime << " ms" << std::endl;
+		std::cout << "  save                " << saveTime << " ms" << std::endl;
+		std::cout << "  bulk load           " << loadTime << " ms (" << createTime / std::max(loadTime, 1e-6) << "x)" << std::endl;
+		std::cout << "  round trip " << (valid ? "matches" : "MISMATCH") << std::endl;
+		return valid;
+
+	}
+
+}
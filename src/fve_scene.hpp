@@ -0,0 +1,93 @@
+#pragma once
+
+#include "fve_components.hpp"
+#include "fve_ecs.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fve {
+
+	// Binary scene files, one block per archetype holding its component arrays back to back.
+	//
+	// Layout: SceneHeader | AssetRef[assetCount] | SceneBlock[blockCount] | asset names | columns.
+	// Every column starts on a SCENE_ALIGNMENT boundary and holds entityCount elements of its stride.
+	// Plain components are stored as their in-memory bytes, so loading one is a single memcpy into
+	// the archetype. Models and textures are stored as indices into the asset table and resolved by
+	// name once per file; parents are stored as indices into the scene's entities, so nothing in the
+	// file depends on where it is loaded. Runtime state (spatial proxies, cached frames) isn't saved.
+	class FveScene {
+	public:
+		static constexpr uint32_t SCENE_VERSION = 1;
+		static constexpr uint64_t SCENE_ALIGNMENT = 64;
+
+		// the components a scene can hold; never reorder, the values are stored in files
+		enum class Component : uint32_t {
+			Transform = 0,
+			WorldTransform,
+			Interpolation,
+			Parent,
+			Color,
+			Model,
+			PointLight,
+			Texture,
+			Bounds,
+			Occluder,
+			Count
+		};
+		static constexpr uint32_t COMPONENT_COUNT = static_cast<uint32_t>(Component::Count);
+
+		enum class AssetType : uint32_t { Model = 0, Texture = 1 };
+
+		struct SceneHeader {
+			char magic[4];
+			uint32_t version;
+			uint32_t assetCount;
+			uint32_t blockCount;
+			uint64_t entityCount;
+			uint64_t assetsOffset;
+			uint64_t blocksOffset;
+			uint64_t stringsOffset;
+			uint64_t fileSize;
+		};
+
+		struct AssetRef {
+			AssetType type;
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			uint32_t reserved;
+		};
+
+		struct ColumnRef {
+			uint64_t offset;
+			// bytes per element, checked against the running build's layout
+			uint32_t stride;
+			uint32_t reserved;
+		};
+
+		// one archetype; columns[c] is only meaningful when bit c of components is set
+		struct SceneBlock {
+			uint32_t components;
+			uint32_t reserved;
+			uint64_t entityCount;
+			// scene index of the block's first entity, parents refer to these
+			uint64_t firstIndex;
+			ColumnRef columns[COMPONENT_COUNT];
+		};
+
+		// instantiates the scene read through fveVfs into world, one bulk append per block. Models and
+		// textures must already be loaded. Returns the number of entities created; throws
+		// std::runtime_error on a malformed file or an unknown asset
+		static size_t load(FveWorld& world, const std::string& path);
+		static size_t load(FveWorld& world, const char* data, size_t size);
+
+		// every entity holding a scene component, written to path (relative to ENGINE_DIR)
+		static void save(FveWorld& world, const std::string& path);
+		static std::vector<char> serialize(FveWorld& world);
+
+		// prints per-entity creation against a scene round trip of the same world, returns false on a mismatch
+		static bool benchmark(size_t count);
+	};
+
+}
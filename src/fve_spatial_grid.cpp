@@ -0,0 +1,164 @@
+#include "fve_spatial_grid.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace fve {
+
+	FveSpatialGrid::FveSpatialGrid(float cellSize) : cellSize{ cellSize }, inverseCellSize{ 1.0f / cellSize } {}
+
+	int32_t FveSpatialGrid::createProxy(const Aabb& aabb, uint32_t userData) {
+
+		int32_t proxyId;
+		if (freeProxy != NULL_PROXY) {
+			proxyId = freeProxy;
+			freeProxy = static_cast<int32_t>(proxies[proxyId].slot);
+		}
+		else {
+			proxyId = static_cast<int32_t>(proxies.size());
+			proxies.emplace_back();
+		}
+
+		proxies[proxyId].aabb = aabb;
+		proxies[proxyId].userData = userData;
+
+		uint32_t bucket = extentBucket(aabb);
+		proxies[proxyId].extentBucket = bucket;
+		extentCounts[bucket]++;
+		if (extentCounts[bucket] == 1) updateMaxHalfExtent();
+
+		addToCell(proxyId, findOrCreateCell(aabb));
+		proxyCount++;
+		return proxyId;
+
+	}
+
+	void FveSpatialGrid::destroyProxy(int32_t proxyId) {
+
+		assert(proxies[proxyId].cell >= 0 && "Not a live proxy");
+
+		removeFromCell(proxyId);
+		extentCounts[proxies[proxyId].extentBucket]--;
+		if (extentCounts[proxies[proxyId].extentBucket] == 0) updateMaxHalfExtent();
+		proxies[proxyId].cell = -1;
+		proxies[proxyId].slot = static_cast<uint32_t>(freeProxy);
+		freeProxy = proxyId;
+		proxyCount--;
+
+	}
+
+	bool FveSpatialGrid::moveProxy(int32_t proxyId, const Aabb& aabb) {
+
+		Proxy& proxy = proxies[proxyId];
+		assert(proxy.cell >= 0 && "Not a live proxy");
+
+		proxy.aabb = aabb;
+		setExtentBucket(proxy, extentBucket(aabb));
+
+		// most frames an object stays in its cell
+		glm::vec3 center = aabb.center();
+		const Cell& current = cells[proxy.cell];
+		if (cellCoordinate(center.x) == current.x && cellCoordinate(center.y) == current.y && cellCoordinate(center.z) == current.z) {
+			return false;
+		}
+
+		removeFromCell(proxyId);
+		addToCell(proxyId, findOrCreateCell(aabb));
+		return true;
+
+	}
+
+	uint32_t FveSpatialGrid::findOrCreateCell(const Aabb& aabb) {
+
+		glm::vec3 center = aabb.center();
+		int32_t x = cellCoordinate(center.x);
+		int32_t y = cellCoordinate(center.y);
+		int32_t z = cellCoordinate(center.z);
+
+		auto [it, inserted] = cellLookup.try_emplace(cellKey(x, y, z), NULL_CELL);
+		if (!inserted) return it->second;
+
+		uint32_t cellIndex;
+		if (!freeCells.empty()) {
+			cellIndex = freeCells.back();
+			freeCells.pop_back();
+		}
+		else {
+			cellIndex = static_cast<uint32_t>(cells.size());
+			cells.emplace_back();
+		}
+
+		Cell& cell = cells[cellIndex];
+		cell.x = x;
+		cell.y = y;
+		cell.z = z;
+		it->second = cellIndex;
+		return cellIndex;
+
+	}
+
+	uint32_t FveSpatialGrid::extentBucket(const Aabb& aabb) const {
+
+		glm::vec3 extents = aabb.extents();
+		float extent = std::max(extents.x, std::max(extents.y, extents.z)) * inverseCellSize;
+		if (!(extent > 0.0f)) return 0;
+		if (!(extent <= std::numeric_limits<float>::max())) return EXTENT_BUCKETS - 1;
+
+		// extent < 2^exponent
+		int exponent;
+		std::frexp(extent, &exponent);
+		return static_cast<uint32_t>(std::clamp(exponent + EXTENT_BUCKET_BIAS, 0, EXTENT_BUCKETS - 1));
+
+	}
+
+	void FveSpatialGrid::setExtentBucket(Proxy& proxy, uint32_t bucket) {
+
+		if (bucket == proxy.extentBucket) return;
+
+		extentCounts[proxy.extentBucket]--;
+		extentCounts[bucket]++;
+		// the bound only moves when the higher of the two buckets fills or empties
+		bool boundChanged = bucket > proxy.extentBucket ? extentCounts[bucket] == 1 : extentCounts[proxy.extentBucket] == 0;
+		proxy.extentBucket = bucket;
+		if (boundChanged) updateMaxHalfExtent();
+
+	}
+
+	void FveSpatialGrid::updateMaxHalfExtent() {
+
+		maxHalfExtent = 0.0f;
+		for (int32_t bucket = EXTENT_BUCKETS - 1; bucket >= 0; bucket--) {
+			if (extentCounts[bucket] == 0) continue;
+
+			// the last bucket holds everything too large to bound
+			maxHalfExtent = bucket == EXTENT_BUCKETS - 1 ? std::numeric_limits<float>::max() : std::ldexp(cellSize, bucket - EXTENT_BUCKET_BIAS);
+			return;
+		}
+
+	}
+
+	void FveSpatialGrid::addToCell(int32_t proxyId, uint32_t cellIndex) {
+		Cell& cell = cells[cellIndex];
+		proxies[proxyId].cell = static_cast<int32_t>(cellIndex);
+		proxies[proxyId].slot = static_cast<uint32_t>(cell.proxies.size());
+		cell.proxies.push_back(proxyId);
+	}
+
+	void FveSpatialGrid::removeFromCell(int32_t proxyId) {
+
+		Proxy& proxy = proxies[proxyId];
+		Cell& cell = cells[proxy.cell];
+
+		int32_t moved = cell.proxies.back();
+		cell.proxies[proxy.slot] = moved;
+		proxies[moved].slot = proxy.slot;
+		cell.proxies.pop_back();
+
+		if (cell.proxies.empty()) {
+			cellLookup.erase(cellKey(cell.x, cell.y, cell.z));
+			freeCells.push_back(static_cast<uint32_t>(proxy.cell));
+		}
+
+	}
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "fve_bounds.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	// Loose hashed uniform grid for objects that move every frame. An object lives in the one cell
+	// containing its center and cells are only allocated where something is, so reinsertion is a
+	// hash lookup plus a swap-remove and costs the same anywhere in the world. Queries widen their
+	// cell range by a bound on the object half extents, which keeps the cells loose without storing
+	// an object in several of them; the bound is the power of two above the largest current half
+	// extent, so it comes back down when big objects shrink or leave. Cell coordinates are clamped
+	// to 21 bits per axis, objects further out share the border cells, whose loose bounds reach to
+	// infinity. Pick the cell size around the typical object size.
+	class FveSpatialGrid {
+	public:
+		static constexpr int32_t NULL_PROXY = -1;
+
+		explicit FveSpatialGrid(float cellSize = 1.0f);
+
+		int32_t createProxy(const Aabb& aabb, uint32_t userData);
+		void destroyProxy(int32_t proxyId);
+
+		// returns true if the proxy changed cells
+		bool moveProxy(int32_t proxyId, const Aabb& aabb);
+
+		uint32_t getUserData(int32_t proxyId) const { return proxies[proxyId].userData; }
+		const Aabb& getAabb(int32_t proxyId) const { return proxies[proxyId].aabb; }
+
+		size_t getProxyCount() const { return proxyCount; }
+		size_t getCellCount() const { return cellLookup.size(); }
+
+		// f(int32_t proxyId, uint32_t userData) for every proxy whose box overlaps, return false to stop
+		template<typename F>
+		void query(const Aabb& box, F&& f) const {
+			visitCells(box, [&](const Cell& cell) {
+				for (int32_t proxyId : cell.proxies) {
+					const Proxy& proxy = proxies[proxyId];
+					if (proxy.aabb.overlaps(box) && !f(proxyId, proxy.userData)) return false;
+				}
+				return true;
+			});
+		}
+
+		template<typename F>
+		void query(const Sphere& sphere, F&& f) const {
+			Aabb box{ sphere.center - glm::vec3(sphere.radius), sphere.center + glm::vec3(sphere.radius) };
+			visitCells(box, [&](const Cell& cell) {
+				for (int32_t proxyId : cell.proxies) {
+					const Proxy& proxy = proxies[proxyId];
+					if (sphere.overlaps(proxy.aabb) && !f(proxyId, proxy.userData)) return false;
+				}
+				return true;
+			});
+		}
+
+		// only the cells under the frustum's bounding box are visited; cells fully inside the
+		// frustum are reported without testing their proxies
+		template<typename F>
+		void query(const Frustum& frustum, F&& f) const {
+			visitCells(frustum.bounds(), [&](const Cell& cell) {
+				Containment containment = frustum.classify(looseBounds(cell));
+				if (containment == Containment::Outside) return true;
+
+				for (int32_t proxyId : cell.proxies) {
+					const Proxy& proxy = proxies[proxyId];
+					if (containment == Containment::Intersecting && frustum.classify(proxy.aabb) == Containment::Outside) continue;
+					if (!f(proxyId, proxy.userData)) return false;
+				}
+				return true;
+			});
+		}
+
+		// same contract as FveAabbTree::raycast. Walks the ray one cell length at a time, visiting the
+		// cells each stretch can reach, and stops once the stretches are past the closest hit
+		template<typename F>
+		void raycast(const Ray& ray, F&& f) const {
+			float maxDistance = ray.maxDistance;
+			auto visit = [&](const Cell& cell) {
+				if (ray.intersect(looseBounds(cell), maxDistance) < 0.0f) return;
+
+				for (int32_t proxyId : cell.proxies) {
+					const Proxy& proxy = proxies[proxyId];
+					if (ray.intersect(proxy.aabb, maxDistance) < 0.0f) continue;
+
+					float distance = f(proxyId, proxy.userData);
+					if (distance >= 0.0f && distance < maxDistance) maxDistance = distance;
+				}
+			};
+
+			// a ray reaching more cells than are occupied is cheaper to answer from the occupied cells
+			double stretches = std::ceil(double(ray.maxDistance) * inverseCellSize);
+			double reach = 2.0 * double(maxHalfExtent) * inverseCellSize + 2.0;
+			if (stretches * reach * reach * reach > double(cellLookup.size())) {
+				for (const auto& kv : cellLookup) visit(cells[kv.second]);
+				return;
+			}
+
+			// the ranges only ever move along the ray, so a cell left out of the previous range is new
+			int32_t previous[6] = { 1, 0, 1, 0, 1, 0 };
+			for (double stretch = 0.0; stretch < stretches; stretch += 1.0) {
+				float start = float(stretch) * cellSize;
+				if (start > maxDistance) return;
+				float end = std::fmin(start + cellSize, ray.maxDistance);
+
+				glm::vec3 a = ray.origin + ray.direction * start;
+				glm::vec3 b = ray.origin + ray.direction * end;
+				Aabb box = Aabb{ glm::min(a, b), glm::max(a, b) }.expanded(maxHalfExtent);
+				int32_t range[6] = {
+					cellCoordinate(box.min.x), cellCoordinate(box.max.x),
+					cellCoordinate(box.min.y), cellCoordinate(box.max.y),
+					cellCoordinate(box.min.z), cellCoordinate(box.max.z) };
+
+				for (int32_t x = range[0]; x <= range[1]; x++) {
+					for (int32_t y = range[2]; y <= range[3]; y++) {
+						for (int32_t z = range[4]; z <= range[5]; z++) {
+							bool seen = x >= previous[0] && x <= previous[1] && y >= previous[2] && y <= previous[3] && z >= previous[4] && z <= previous[5];
+							if (seen) continue;
+							auto it = cellLookup.find(cellKey(x, y, z));
+							if (it != cellLookup.end()) visit(cells[it->second]);
+						}
+					}
+				}
+				std::copy(range, range + 6, previous);
+			}
+		}
+
+	private:
+		struct Cell {
+			int32_t x = 0, y = 0, z = 0;
+			std::vector<int32_t> proxies;
+		};
+
+		struct Proxy {
+			Aabb aabb;
+			uint32_t userData = 0;
+			int32_t cell = -1;  // -1 while on the free list
+			uint32_t slot = 0;  // position in the cell's proxy list, next free proxy while on the free list
+			uint32_t extentBucket = 0;
+		};
+
+		static constexpr uint32_t NULL_CELL = ~0u;
+
+		// cell coordinates fit 21 bits per axis, so keys never alias
+		static constexpr int32_t MIN_CELL = -(1 << 20);
+		static constexpr int32_t MAX_CELL = (1 << 20) - 1;
+
+		// half extents are counted per power of two of cellSize, 2^-16 and below in the first bucket
+		static constexpr int32_t EXTENT_BUCKETS = 48;
+		static constexpr int32_t EXTENT_BUCKET_BIAS = 16;
+
+		static uint64_t cellKey(int32_t x, int32_t y, int32_t z) {
+			return (uint64_t(uint32_t(x) & 0x1FFFFF) << 42) | (uint64_t(uint32_t(y) & 0x1FFFFF) << 21) | uint64_t(uint32_t(z) & 0x1FFFFF);
+		}
+
+		// far away and non-finite positions land in the border cells
+		int32_t cellCoordinate(float value) const {
+			float coordinate = std::floor(value * inverseCellSize);
+			if (!(coordinate > float(MIN_CELL))) return MIN_CELL;
+			if (coordinate >= float(MAX_CELL)) return MAX_CELL;
+			return static_cast<int32_t>(coordinate);
+		}
+
+		// cell bounds grown by the half extent bound, every proxy of the cell is inside; border cells
+		// also hold everything beyond them
+		Aabb looseBounds(const Cell& cell) const {
+			const float limit = std::numeric_limits<float>::max();
+			if (maxHalfExtent == limit) return Aabb{ glm::vec3(-limit), glm::vec3(limit) };
+
+			glm::vec3 min = glm::vec3(float(cell.x), float(cell.y), float(cell.z)) * cellSize;
+			Aabb bounds{ min - glm::vec3(maxHalfExtent), min + glm::vec3(cellSize + maxHalfExtent) };
+			for (int axis = 0; axis < 3; axis++) {
+				int32_t coordinate = axis == 0 ? cell.x : axis == 1 ? cell.y : cell.z;
+				if (coordinate == MIN_CELL) bounds.min[axis] = -limit;
+				if (coordinate == MAX_CELL) bounds.max[axis] = limit;
+			}
+			return bounds;
+		}
+
+		// visit(const Cell&) for every occupied cell that can hold proxies overlapping box, return false to stop
+		template<typename Visit>
+		void visitCells(const Aabb& box, Visit&& visit) const {
+			Aabb searchBox = box.expanded(maxHalfExtent);
+			int32_t x0 = cellCoordinate(searchBox.min.x), x1 = cellCoordinate(searchBox.max.x);
+			int32_t y0 = cellCoordinate(searchBox.min.y), y1 = cellCoordinate(searchBox.max.y);
+			int32_t z0 = cellCoordinate(searchBox.min.z), z1 = cellCoordinate(searchBox.max.z);
+
+			// a query larger than the occupied area is cheaper to answer from the occupied cells
+			double rangeCells = double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1);
+			if (rangeCells > double(cellLookup.size())) {
+				for (const auto& kv : cellLookup) {
+					const Cell& cell = cells[kv.second];
+					if (cell.x < x0 || cell.x > x1 || cell.y < y0 || cell.y > y1 || cell.z < z0 || cell.z > z1) continue;
+					if (!visit(cell)) return;
+				}
+				return;
+			}
+
+			for (int32_t x = x0; x <= x1; x++) {
+				for (int32_t y = y0; y <= y1; y++) {
+					for (int32_t z = z0; z <= z1; z++) {
+						auto it = cellLookup.find(cellKey(x, y, z));
+						if (it != cellLookup.end() && !visit(cells[it->second])) return;
+					}
+				}
+			}
+		}
+
+		uint32_t findOrCreateCell(const Aabb& aabb);
+		void addToCell(int32_t proxyId, uint32_t cellIndex);
+		void removeFromCell(int32_t proxyId);
+
+		uint32_t extentBucket(const Aabb& aabb) const;
+		void setExtentBucket(Proxy& proxy, uint32_t bucket);
+		void updateMaxHalfExtent();
+
+		float cellSize;
+		float inverseCellSize;
+		// bound of the highest occupied extent bucket
+		float maxHalfExtent = 0.0f;
+		std::array<uint32_t, EXTENT_BUCKETS> extentCounts{};
+
+		std::vector<Proxy> proxies;
+		int32_t freeProxy = NULL_PROXY;
+		size_t proxyCount = 0;
+
+		// emptied cells go on a free list and keep their capacity, so swarms don't churn the heap
+		std::vector<Cell> cells;
+		std::vector<uint32_t> freeCells;
+		std::unordered_map<uint64_t, uint32_t> cellLookup;
+	};
+
+}
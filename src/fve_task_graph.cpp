@@ -0,0 +1,210 @@
+#include "fve_task_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace fve {
+
+	FveTaskGraph::TaskBuilder& FveTaskGraph::TaskBuilder::reads(Resource resource) {
+		graph.tasks[index].resourceReads |= uint64_t{ 1 } << resource;
+		return *this;
+	}
+
+	FveTaskGraph::TaskBuilder& FveTaskGraph::TaskBuilder::writes(Resource resource) {
+		graph.tasks[index].resourceWrites |= uint64_t{ 1 } << resource;
+		return *this;
+	}
+
+	FveTaskGraph::TaskBuilder& FveTaskGraph::TaskBuilder::structural() {
+		graph.tasks[index].structural = true;
+		return *this;
+	}
+
+	void FveTaskGraph::TaskBuilder::run(std::function<void()> function) {
+		graph.tasks[index].function = std::move(function);
+	}
+
+	FveTaskGraph::Resource FveTaskGraph::resource(const std::string& name) {
+		auto existing = std::find(resourceNames.begin(), resourceNames.end(), name);
+		if (existing != resourceNames.end()) {
+			return static_cast<Resource>(existing - resourceNames.begin());
+		}
+
+		if (resourceNames.size() == MAX_RESOURCES) {
+			throw std::runtime_error("Too many task graph resources");
+		}
+		resourceNames.push_back(name);
+		return static_cast<Resource>(resourceNames.size() - 1);
+	}
+
+	FveTaskGraph::TaskBuilder FveTaskGraph::addTask(const std::string& name) {
+		Task& task = tasks.emplace_back();
+		task.name = name;
+		compiled = false;
+		return TaskBuilder{ *this, tasks.size() - 1 };
+	}
+
+	bool FveTaskGraph::conflicts(const Task& earlier, const Task& later) {
+
+		// structural changes move component arrays, so they exclude anything reading the world
+		bool earlierWorld = earlier.structural || earlier.componentReads != 0 || earlier.componentWrites != 0;
+		bool laterWorld = later.structural || later.componentReads != 0 || later.componentWrites != 0;
+		if ((earlier.structural && laterWorld) || (later.structural && earlierWorld)) return true;
+
+		if ((earlier.componentWrites & (later.componentReads | later.componentWrites)) != 0) return true;
+		if ((earlier.componentReads & later.componentWrites) != 0) return true;
+		if ((earlier.resourceWrites & (later.resourceReads | later.resourceWrites)) != 0) return true;
+		if ((earlier.resourceReads & later.resourceWrites) != 0) return true;
+		return false;
+
+	}
+
+	void FveTaskGraph::compile() {
+
+		size_t count = tasks.size();
+
+		// every earlier task a task transitively waits for
+		std::vector<std::vector<bool>> reaches(count, std::vector<bool>(count, false));
+		std::vector<std::vector<size_t>> conflicting(count);
+		for (size_t later = 0; later < count; later++) {
+			for (size_t earlier = 0; earlier < later; earlier++) {
+				if (!conflicts(tasks[earlier], tasks[later])) continue;
+
+				conflicting[later].push_back(earlier);
+				reaches[later][earlier] = true;
+				for (size_t before = 0; before < earlier; before++) {
+					if (reaches[earlier][before]) reaches[later][before] = true;
+				}
+			}
+		}
+
+		// keep only the edges no other dependency already implies
+		for (Task& task : tasks) {
+			task.predecessors.clear();
+			task.successors.clear();
+		}
+		roots.clear();
+		for (size_t later = 0; later < count; later++) {
+			for (size_t earlier : conflicting[later]) {
+				bool implied = std::any_of(conflicting[later].begin(), conflicting[later].end(), [&](size_t other) {
+					return other != earlier && reaches[other][earlier];
+				});
+				if (implied) continue;
+
+				tasks[later].predecessors.push_back(earlier);
+				tasks[earlier].successors.push_back(later);
+			}
+			if (tasks[later].predecessors.empty()) roots.push_back(later);
+		}
+
+		remaining = std::vector<std::atomic<uint32_t>>(count);
+		compiled = true;
+
+	}
+
+	void FveTaskGraph::execute(FveJobSystem& jobs) {
+
+		if (!compiled) compile();
+
+		for (size_t i = 0; i < tasks.size(); i++) {
+			assert(tasks[i].function && "Task graph task was added without run()");
+			remaining[i].store(static_cast<uint32_t>(tasks[i].predecessors.size()), std::memory_order_relaxed);
+		}
+
+		executeStart = std::chrono::steady_clock::now();
+
+		FveJobCounter counter;
+		for (size_t root : roots) {
+			launch(jobs, counter, root);
+		}
+		jobs.wait(counter);
+
+		frameTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - executeStart).count();
+
+	}
+
+	void FveTaskGraph::launch(FveJobSystem& jobs, FveJobCounter& counter, size_t index) {
+
+		jobs.run(counter, [this, &jobs, &counter, index]() {
+			Task& task = tasks[index];
+
+			auto start = std::chrono::steady_clock::now();
+			task.function();
+			auto end = std::chrono::steady_clock::now();
+			task.start = std::chrono::duration<float, std::milli>(start - executeStart).count();
+			task.duration = std::chrono::duration<float, std::milli>(end - start).count();
+
+			// the last predecessor to finish starts the task
+			for (size_t successor : task.successors) {
+				if (remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					launch(jobs, counter, successor);
+				}
+			}
+		});
+
+	}
+
+	void FveTaskGraph::longestPaths(std::vector<size_t>& previous, std::vector<float>& finish) const {
+
+		// tasks only depend on earlier ones, so insertion order is a topological order
+		previous.assign(tasks.size(), std::numeric_limits<size_t>::max());
+		finish.assign(tasks.size(), 0.0f);
+		for (size_t i = 0; i < tasks.size(); i++) {
+			float longest = 0.0f;
+			for (size_t predecessor : tasks[i].predecessors) {
+				if (finish[predecessor] >= longest) {
+					longest = finish[predecessor];
+					previous[i] = predecessor;
+				}
+			}
+			finish[i] = longest + tasks[i].duration;
+		}
+
+	}
+
+	float FveTaskGraph::getCriticalPathTime() const {
+
+		std::vector<size_t> previous;
+		std::vector<float> finish;
+		longestPaths(previous, finish);
+		return finish.empty() ? 0.0f : *std::max_element(finish.begin(), finish.end());
+
+	}
+
+	void FveTaskGraph::dump(std::ostream& out) const {
+
+		std::vector<size_t> previous;
+		std::vector<float> finish;
+		longestPaths(previous, finish);
+
+		size_t last = std::max_element(finish.begin(), finish.end()) - finish.begin();
+		std::vector<size_t> criticalPath;
+		for (size_t i = last; i < tasks.size(); i = previous[i]) {
+			criticalPath.push_back(i);
+		}
+		std::reverse(criticalPath.begin(), criticalPath.end());
+
+		out << std::fixed << std::setprecision(3);
+		out << "Frame graph: " << tasks.size() << " tasks, " << frameTime << " ms wall, critical path " << getCriticalPathTime() << " ms" << std::endl;
+		for (const Task& task : tasks) {
+			out << "  " << std::left << std::setw(20) << task.name << std::right
+				<< " start " << std::setw(8) << task.start << " ms"
+				<< "  took " << std::setw(8) << task.duration << " ms  after:";
+			if (task.predecessors.empty()) out << " -";
+			for (size_t predecessor : task.predecessors) out << " " << tasks[predecessor].name;
+			out << std::endl;
+		}
+
+		out << "  critical path:";
+		for (size_t i = 0; i < criticalPath.size(); i++) {
+			out << (i == 0 ? " " : " -> ") << tasks[criticalPath[i]].name;
+		}
+		out << std::endl;
+		out << std::defaultfloat;
+
+	}
+
+}
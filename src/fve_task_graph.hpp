@@ -0,0 +1,107 @@
+#pragma once
+
+#include "fve_ecs.hpp"
+#include "fve_job_system.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fve {
+
+	// Per-frame systems declared with the components and resources they read and write. Two tasks
+	// conflict when one writes what the other touches, and conflicting tasks keep the order they
+	// were added in; everything else runs concurrently on the job system. Resources stand for state
+	// outside the world such as the uniforms or the camera. Structural tasks add or remove entities
+	// or components, so no other task touching the world runs alongside them. Each run is timed so
+	// the critical path of the last frame can be dumped.
+	class FveTaskGraph {
+	public:
+		using Resource = uint32_t;
+		static constexpr uint32_t MAX_RESOURCES = 64;
+
+		class TaskBuilder {
+		public:
+			TaskBuilder(FveTaskGraph& graph, size_t index) : graph{ graph }, index{ index } {}
+
+			template<typename... Ts>
+			TaskBuilder& reads() {
+				graph.tasks[index].componentReads |= componentMask<Ts...>();
+				return *this;
+			}
+
+			template<typename... Ts>
+			TaskBuilder& writes() {
+				graph.tasks[index].componentWrites |= componentMask<Ts...>();
+				return *this;
+			}
+
+			TaskBuilder& reads(Resource resource);
+			TaskBuilder& writes(Resource resource);
+
+			// adds or removes entities or components
+			TaskBuilder& structural();
+
+			void run(std::function<void()> function);
+
+		private:
+			FveTaskGraph& graph;
+			size_t index;
+		};
+
+		// the same name always maps to the same resource
+		Resource resource(const std::string& name);
+
+		TaskBuilder addTask(const std::string& name);
+
+		// runs every task once, returns when all are done
+		void execute(FveJobSystem& jobs);
+
+		// schedule and timings of the last execute, with its critical path
+		void dump(std::ostream& out) const;
+
+		// longest chain of dependent tasks in the last execute, in milliseconds
+		float getCriticalPathTime() const;
+		float getFrameTime() const { return frameTime; }
+
+	private:
+		struct Task {
+			std::string name;
+			ComponentMask componentReads = 0;
+			ComponentMask componentWrites = 0;
+			uint64_t resourceReads = 0;
+			uint64_t resourceWrites = 0;
+			bool structural = false;
+			std::function<void()> function;
+
+			// direct dependencies only, implied ones are dropped when compiling
+			std::vector<size_t> predecessors;
+			std::vector<size_t> successors;
+
+			// milliseconds from the start of the last execute
+			float start = 0.0f;
+			float duration = 0.0f;
+		};
+
+		static bool conflicts(const Task& earlier, const Task& later);
+
+		void compile();
+		void launch(FveJobSystem& jobs, FveJobCounter& counter, size_t index);
+		// per task, the predecessor on its longest path (or SIZE_MAX) and that path's length
+		void longestPaths(std::vector<size_t>& previous, std::vector<float>& finish) const;
+
+		std::vector<Task> tasks;
+		std::vector<std::string> resourceNames;
+		std::vector<size_t> roots;
+		std::vector<std::atomic<uint32_t>> remaining;
+		bool compiled = false;
+
+		std::chrono::steady_clock::time_point executeStart;
+		float frameTime = 0.0f;
+	};
+
+}
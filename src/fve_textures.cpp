@@ -2,6 +2,7 @@
 #include "fve_assets.hpp"
 #include "fve_device.hpp"
 #include "fve_initializers.hpp"
+#include "fve_utils.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -18,22 +19,81 @@ namespace fve {
 
 	bool loadImageFromFile(FveDevice& device, const char* filePath, AllocatedImage& outImage) {
 
+		ImageData imageData;
+		if (!decodeImageFromFile(filePath, imageData)) {
+			return false;
+		}
+
+		uploadImage(device, imageData, outImage);
+
+		// confirm load success
+		//if (debugMode)
+			std::cout << "Loaded texture " << filePath << std::endl;
+
+		return true;
+
+	}
+
+	bool decodeImageFromFile(const char* filePath, ImageData& outData) {
+
+		if (!fveVfs.exists(filePath)) {
+			if (debugMode) std::cerr << "Failed to load texture: " << filePath << std::endl;
+			return false;
+		}
+
+		return decodeImage(fveVfs.readFile(filePath), outData, filePath);
+
+	}
+
+	bool decodeImage(const FveFileData& fileData, ImageData& outData, const char* debugName) {
+
 		int width, height, channels;
 
-		stbi_uc* pixels = stbi_load(filePath, &width, &height, &channels, STBI_rgb_alpha);
+		stbi_uc* pixels = stbi_load_from_memory(
+			reinterpret_cast<const stbi_uc*>(fileData.data()),
+			static_cast<int>(fileData.size()),
+			&width, &height, &channels, STBI_rgb_alpha);
 
 		if (!pixels) {
-			if (debugMode) std::cerr << "Failed to load texture: " << filePath << std::endl;
+			if (debugMode) std::cerr << "Failed to load texture: " << debugName << std::endl;
 			return false;
 		}
 
-		void* pixelPtr = pixels;
-		VkDeviceSize imageSize = width * height * 4;
+		outData.width = width;
+		outData.height = height;
+		outData.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+		// the pixels now live in outData, so we can free them from stbi
+		stbi_image_free(pixels);
+
+		return true;
+
+	}
+
+	void uploadImage(FveDevice& device, const ImageData& imageData, AllocatedImage& outImage) {
+
+		// begin a command buffer to transfer data into the image
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+
+		auto stagingBuffer = recordImageUpload(device, commandBuffer, imageData, outImage);
+
+		// submit the command buffer
+		device.endSingleTimeCommands(commandBuffer);
+
+	}
+
+	std::unique_ptr<FveBuffer> recordImageUpload(FveDevice& device, VkCommandBuffer commandBuffer, const ImageData& imageData, AllocatedImage& outImage) {
+
+		int width = imageData.width;
+		int height = imageData.height;
+
+		void* pixelPtr = (void*)imageData.pixels.data();
+		VkDeviceSize imageSize = imageData.pixels.size();
 
 		VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
 
 		// create a staging buffer
-		FveBuffer stagingBuffer = FveBuffer(
+		auto stagingBuffer = std::make_unique<FveBuffer>(
 			fveAllocator,
 			device,
 			imageSize,
@@ -43,11 +103,8 @@ namespace fve {
 		);
 
 		// copy the image data into the staging buffer
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer(pixelPtr);
-
-		// image data is now stored in the staging buffer, so we can free it from stbi
-		stbi_image_free(pixels);
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer(pixelPtr);
 
 		// define the image size
 		VkExtent3D imageExtent;
@@ -71,9 +128,6 @@ namespace fve {
 		// create the image on the GPU
 		vmaCreateImage(fveAllocator, &imageInfo, &allocInfo, &newImage.image, &newImage.allocation, nullptr);
 
-		// begin a command buffer to transfer data into the image
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
 		// define the image subresources
 		VkImageSubresourceRange range;
 		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -110,7 +164,7 @@ namespace fve {
 		copyRegion.imageExtent = imageExtent; // the whole image
 
 		//copy the buffer into the image
-		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.getAllocatedBuffer().buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer->getAllocatedBuffer().buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 
 		// create a barrier for the final format transfer
 		VkImageMemoryBarrier imageReadableBarrier = imageTransferBarrier;
@@ -124,17 +178,16 @@ namespace fve {
 		// set the barrier
 		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageReadableBarrier);
 
-		// submit the command buffer
-		device.endSingleTimeCommands(commandBuffer);
-
-		// confirm load success
-		//if (debugMode)
-			std::cout << "Loaded texture " << filePath << std::endl;
-
-		// assign the out image and return
+		// assign the out image, the staging buffer has to live until the commands have executed
 		outImage = newImage;
-		return true;
+		return stagingBuffer;
+
+	}
 
+	uint64_t hashImage(const ImageData& imageData) {
+		int extent[2] = { imageData.width, imageData.height };
+		uint64_t hash = fnv1a64(extent, sizeof(extent));
+		return fnv1a64(imageData.pixels.data(), imageData.pixels.size(), hash);
 	}
 
 }
\ No newline at end of file
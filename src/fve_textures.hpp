@@ -2,9 +2,33 @@
 
 #include "fve_types.hpp"
 #include "fve_device.hpp"
+#include "fve_vfs.hpp"
+#include "fve_buffer.hpp"
+
+#include <memory>
+
+#include <vector>
 
 namespace fve {
 
+	// CPU side of a texture, decoded to RGBA8 and ready to upload
+	struct ImageData {
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> pixels;
+	};
+
 	bool loadImageFromFile(FveDevice& device, const char* filePath, AllocatedImage& outImage);
 
+	// decoding touches no Vulkan state, so it is safe to call from any thread
+	bool decodeImageFromFile(const char* filePath, ImageData& outData);
+	bool decodeImage(const FveFileData& fileData, ImageData& outData, const char* debugName);
+	void uploadImage(FveDevice& device, const ImageData& imageData, AllocatedImage& outImage);
+
+	// records the upload into commandBuffer and hands back the staging buffer it reads from
+	std::unique_ptr<FveBuffer> recordImageUpload(FveDevice& device, VkCommandBuffer commandBuffer, const ImageData& imageData, AllocatedImage& outImage);
+
+	// hash of the decoded pixels, identical images hash the same whatever file they came from
+	uint64_t hashImage(const ImageData& imageData);
+
 }
\ No newline at end of file
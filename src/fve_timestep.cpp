@@ -0,0 +1,41 @@
+#include "fve_timestep.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace fve {
+
+	FveFixedTimestep::FveFixedTimestep(float stepRate, uint32_t maxSteps) : maxSteps{ maxSteps } {
+		setStepRate(stepRate);
+	}
+
+	void FveFixedTimestep::setStepRate(float stepRate) {
+		assert(stepRate > 0.0f && "Simulation rate must be positive");
+
+		// keep the blend position the same across the change
+		double alpha = accumulator / step;
+		step = 1.0 / stepRate;
+		accumulator = alpha * step;
+	}
+
+	uint32_t FveFixedTimestep::advance(float frameTime) {
+
+		accumulator += frameTime;
+
+		uint32_t steps = static_cast<uint32_t>(accumulator / step);
+		if (steps > maxSteps) {
+			// too far behind to catch up, keep only what the capped steps consume plus the partial step
+			double excess = (steps - maxSteps) * step;
+			droppedTime += excess;
+			accumulator -= excess;
+			steps = maxSteps;
+		}
+
+		// rounding can leave a hair below zero
+		accumulator = std::max(0.0, accumulator - steps * step);
+		stepCount += steps;
+		return steps;
+
+	}
+
+}
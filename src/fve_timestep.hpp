@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace fve {
+
+	// Splits variable frame times into fixed simulation steps. Time that doesn't fill a whole step
+	// carries over to the next frame, and the fraction of a step it covers is how far rendering
+	// blends from the previous step's state towards the latest one. A frame that owes more than
+	// maxSteps steps drops the excess instead of simulating it, so one slow frame can't make the
+	// next one slower still.
+	class FveFixedTimestep {
+	public:
+		explicit FveFixedTimestep(float stepRate = 60.0f, uint32_t maxSteps = 4);
+
+		// adds the frame's elapsed seconds, returns how many steps to simulate now
+		uint32_t advance(float frameTime);
+
+		void setStepRate(float stepRate);
+		void setMaxSteps(uint32_t maxSteps) { this->maxSteps = maxSteps; }
+
+		// seconds per step
+		float getStep() const { return static_cast<float>(step); }
+
+		// 0 renders the previous step, 1 the latest one
+		float getAlpha() const { return static_cast<float>(accumulator / step); }
+
+		uint64_t getStepCount() const { return stepCount; }
+		// seconds the step cap threw away
+		double getDroppedTime() const { return droppedTime; }
+
+	private:
+		double step = 1.0;
+		double accumulator = 0.0;
+		uint32_t maxSteps;
+
+		uint64_t stepCount = 0;
+		double droppedTime = 0.0;
+	};
+
+}
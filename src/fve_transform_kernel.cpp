@@ -0,0 +1,127 @@
+#include "fve_transform_kernel.hpp"
+
+#include <cmath>
+
+#if defined(FVE_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace fve {
+
+	namespace transform_kernel {
+
+		void computeScalar(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output) {
+			for (size_t i = 0; i < count; i++) {
+				const float* translation = input.translation + rows[i] * input.stride;
+				const float* rotation = input.rotation + rows[i] * input.stride;
+				const float* scale = input.scale + rows[i] * input.stride;
+				float* matrix = output.matrix + rows[i] * output.stride;
+				float* normal = output.normalMatrix + rows[i] * output.stride;
+
+				const float c3 = std::cos(rotation[2]);
+				const float s3 = std::sin(rotation[2]);
+				const float c2 = std::cos(rotation[0]);
+				const float s2 = std::sin(rotation[0]);
+				const float c1 = std::cos(rotation[1]);
+				const float s1 = std::sin(rotation[1]);
+
+				const float r[9] = {
+					c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1,
+					c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3,
+					c2 * s1, -s2, c1 * c2
+				};
+
+				for (int column = 0; column < 3; column++) {
+					const float inverseScale = 1.0f / scale[column];
+					for (int row = 0; row < 3; row++) {
+						matrix[column * 4 + row] = scale[column] * r[column * 3 + row];
+						normal[column * 4 + row] = inverseScale * r[column * 3 + row];
+					}
+					matrix[column * 4 + 3] = 0.0f;
+					normal[column * 4 + 3] = 0.0f;
+				}
+
+				matrix[12] = translation[0];
+				matrix[13] = translation[1];
+				matrix[14] = translation[2];
+				matrix[15] = 1.0f;
+				normal[12] = 0.0f;
+				normal[13] = 0.0f;
+				normal[14] = 0.0f;
+				normal[15] = 1.0f;
+			}
+		}
+
+	}
+
+#ifdef FVE_X86
+	static bool cpuSupportsSse4() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 19)) != 0;
+#else
+		return __builtin_cpu_supports("sse4.1");
+#endif
+	}
+
+	static bool cpuSupportsAvx2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave) return false;
+
+		// the OS has to save the upper halves of the ymm registers
+		if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#endif
+
+	const char* simdLevelName(SimdLevel level) {
+		switch (level) {
+		case SimdLevel::Avx2: return "AVX2";
+		case SimdLevel::Sse4: return "SSE4.1";
+		default: return "scalar";
+		}
+	}
+
+	SimdLevel detectSimdLevel() {
+		static const SimdLevel level = []() {
+#ifdef FVE_X86
+			if (cpuSupportsAvx2()) return SimdLevel::Avx2;
+			if (cpuSupportsSse4()) return SimdLevel::Sse4;
+#endif
+			return SimdLevel::Scalar;
+		}();
+		return level;
+	}
+
+	TransformKernelFn getTransformKernel(SimdLevel level) {
+
+		// never hand out a kernel above what the CPU can run
+		if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) return nullptr;
+
+		switch (level) {
+#ifdef FVE_X86
+		case SimdLevel::Avx2: return transform_kernel::computeAvx2;
+		case SimdLevel::Sse4: return transform_kernel::computeSse4;
+#endif
+		case SimdLevel::Scalar: return transform_kernel::computeScalar;
+		default: return nullptr;
+		}
+
+	}
+
+	TransformKernelFn getTransformKernel() {
+		static const TransformKernelFn kernel = getTransformKernel(detectSimdLevel());
+		return kernel;
+	}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FVE_X86 1
+#endif
+
+namespace fve {
+
+	// Batched Translate * Ry * Rx * Rz * Scale and inverse-scale normal matrices, the same math as
+	// TransformComponent::mat4()/normalMatrix(). Works on strided views so it can read component
+	// arrays in place; kept free of glm so the per instruction set files only see raw floats.
+
+	// strides are in floats, rows index into every array
+	struct TransformKernelInput {
+		const float* translation;
+		const float* rotation;
+		const float* scale;
+		size_t stride;
+	};
+
+	// column major 4x4 matrices, the normal matrix is the 3x3 one embedded in a 4x4 like glm::mat4(mat3)
+	struct TransformKernelOutput {
+		float* matrix;
+		float* normalMatrix;
+		size_t stride;
+	};
+
+	using TransformKernelFn = void (*)(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output);
+
+	enum class SimdLevel { Scalar, Sse4, Avx2 };
+
+	const char* simdLevelName(SimdLevel level);
+
+	// best level the CPU and OS support, detected once
+	SimdLevel detectSimdLevel();
+
+	// kernel for a specific level, nullptr if this CPU or build can't run it
+	TransformKernelFn getTransformKernel(SimdLevel level);
+
+	// kernel for detectSimdLevel()
+	TransformKernelFn getTransformKernel();
+
+	namespace transform_kernel {
+		void computeScalar(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output);
+#ifdef FVE_X86
+		void computeSse4(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output);
+		void computeAvx2(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output);
+#endif
+	}
+
+}
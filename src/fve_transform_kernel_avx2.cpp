@@ -0,0 +1,71 @@
+#include "fve_transform_kernel.hpp"
+
+#ifdef FVE_X86
+
+#include <immintrin.h>
+
+#include "fve_transform_kernel_impl.hpp"
+
+namespace fve {
+
+	namespace {
+
+		struct Avx2Ops {
+			using V = __m256;
+			using Mask = __m256;
+			static constexpr size_t WIDTH = 8;
+
+			static V set1(float value) { return _mm256_set1_ps(value); }
+			static V add(V a, V b) { return _mm256_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+			static V div(V a, V b) { return _mm256_div_ps(a, b); }
+			static V neg(V a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+			static V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+			static V fnmadd(V a, V b, V c) { return _mm256_fnmadd_ps(a, b, c); }
+			static V round(V a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+			static V floor(V a) { return _mm256_floor_ps(a); }
+
+			static Mask cmpeq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+			static Mask cmpge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static Mask cmple(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+			static Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+			static V select(Mask mask, V whenTrue, V whenFalse) { return _mm256_blendv_ps(whenFalse, whenTrue, mask); }
+
+			static V gather(const float* base, const int32_t* offsets) {
+				__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets));
+				return _mm256_i32gather_ps(base, index, sizeof(float));
+			}
+
+			// transpose each 128 bit half like the SSE path, lanes 0-3 then 4-7
+			static void storeColumn(float* const* dst, size_t offset, V x, V y, V z, V w) {
+				__m128 lx = _mm256_castps256_ps128(x), ly = _mm256_castps256_ps128(y), lz = _mm256_castps256_ps128(z), lw = _mm256_castps256_ps128(w);
+				__m128 hx = _mm256_extractf128_ps(x, 1), hy = _mm256_extractf128_ps(y, 1), hz = _mm256_extractf128_ps(z, 1), hw = _mm256_extractf128_ps(w, 1);
+
+				_MM_TRANSPOSE4_PS(lx, ly, lz, lw);
+				_mm_storeu_ps(dst[0] + offset, lx);
+				_mm_storeu_ps(dst[1] + offset, ly);
+				_mm_storeu_ps(dst[2] + offset, lz);
+				_mm_storeu_ps(dst[3] + offset, lw);
+
+				_MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+				_mm_storeu_ps(dst[4] + offset, hx);
+				_mm_storeu_ps(dst[5] + offset, hy);
+				_mm_storeu_ps(dst[6] + offset, hz);
+				_mm_storeu_ps(dst[7] + offset, hw);
+			}
+		};
+
+	}
+
+	namespace transform_kernel {
+
+		void computeAvx2(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output) {
+			computeTransforms<Avx2Ops>(input, rows, count, output);
+		}
+
+	}
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+// Shared body of the SIMD transform kernels. Only included by the per instruction set translation
+// units, and everything lives in an unnamed namespace so an AVX2 instantiation can never be picked
+// by the linker for the SSE4 path. Don't include library headers with inline templates (<algorithm>
+// and friends) here: their instantiations are not in the unnamed namespace, so an AVX2 compiled copy
+// could be merged into code that runs without AVX2.
+
+#include "fve_transform_kernel.hpp"
+
+namespace fve {
+	namespace {
+
+		// Cody-Waite split of pi/2, accurate for |x| up to a few thousand radians
+		constexpr float HALF_PI_A = 1.5703125f;
+		constexpr float HALF_PI_B = 4.837512969970703125e-4f;
+		constexpr float HALF_PI_C = 7.54978995489188216e-8f;
+		constexpr float TWO_OVER_PI = 0.636619772367581343f;
+
+		// sin and cos of every lane; reduces to [-pi/4, pi/4] and picks the quadrant with selects
+		template<typename Ops>
+		inline void sincos(typename Ops::V x, typename Ops::V& outSin, typename Ops::V& outCos) {
+			using V = typename Ops::V;
+
+			V quadrant = Ops::round(Ops::mul(x, Ops::set1(TWO_OVER_PI)));
+			V r = Ops::fnmadd(quadrant, Ops::set1(HALF_PI_A), x);
+			r = Ops::fnmadd(quadrant, Ops::set1(HALF_PI_B), r);
+			r = Ops::fnmadd(quadrant, Ops::set1(HALF_PI_C), r);
+
+			V r2 = Ops::mul(r, r);
+
+			// minimax polynomials from cephes sinf/cosf
+			V s = Ops::fmadd(r2, Ops::set1(-1.9515295891e-4f), Ops::set1(8.3321608736e-3f));
+			s = Ops::fmadd(s, r2, Ops::set1(-1.6666654611e-1f));
+			s = Ops::fmadd(Ops::mul(s, r2), r, r);
+
+			V c = Ops::fmadd(r2, Ops::set1(2.443315711809948e-5f), Ops::set1(-1.388731625493765e-3f));
+			c = Ops::fmadd(c, r2, Ops::set1(4.166664568298827e-2f));
+			c = Ops::fmadd(Ops::mul(c, r2), r2, Ops::fnmadd(Ops::set1(0.5f), r2, Ops::set1(1.0f)));
+
+			// quadrant mod 4, as a float in {0, 1, 2, 3}
+			V q = Ops::sub(quadrant, Ops::mul(Ops::floor(Ops::mul(quadrant, Ops::set1(0.25f))), Ops::set1(4.0f)));
+
+			// odd quadrants swap sin and cos
+			auto odd = Ops::cmpeq(Ops::sub(q, Ops::mul(Ops::floor(Ops::mul(q, Ops::set1(0.5f))), Ops::set1(2.0f))), Ops::set1(1.0f));
+			V sinValue = Ops::select(odd, c, s);
+			V cosValue = Ops::select(odd, s, c);
+
+			// sin is negative in quadrants 2 and 3, cos in 1 and 2
+			auto negateSin = Ops::cmpge(q, Ops::set1(2.0f));
+			auto negateCos = Ops::maskAnd(Ops::cmpge(q, Ops::set1(1.0f)), Ops::cmple(q, Ops::set1(2.0f)));
+
+			outSin = Ops::select(negateSin, Ops::neg(sinValue), sinValue);
+			outCos = Ops::select(negateCos, Ops::neg(cosValue), cosValue);
+		}
+
+		template<typename Ops>
+		void computeTransforms(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output) {
+			using V = typename Ops::V;
+			constexpr size_t W = Ops::WIDTH;
+
+			const V zero = Ops::set1(0.0f);
+			const V one = Ops::set1(1.0f);
+
+			for (size_t base = 0; base < count; base += W) {
+
+				// the tail repeats the last row, duplicate lanes just store the same result twice
+				int32_t inputOffsets[W];
+				float* matrices[W];
+				float* normals[W];
+				for (size_t lane = 0; lane < W; lane++) {
+					size_t row = rows[base + lane < count ? base + lane : count - 1];
+					inputOffsets[lane] = static_cast<int32_t>(row * input.stride);
+					matrices[lane] = output.matrix + row * output.stride;
+					normals[lane] = output.normalMatrix + row * output.stride;
+				}
+
+				V tx = Ops::gather(input.translation + 0, inputOffsets);
+				V ty = Ops::gather(input.translation + 1, inputOffsets);
+				V tz = Ops::gather(input.translation + 2, inputOffsets);
+				V rx = Ops::gather(input.rotation + 0, inputOffsets);
+				V ry = Ops::gather(input.rotation + 1, inputOffsets);
+				V rz = Ops::gather(input.rotation + 2, inputOffsets);
+				V sx = Ops::gather(input.scale + 0, inputOffsets);
+				V sy = Ops::gather(input.scale + 1, inputOffsets);
+				V sz = Ops::gather(input.scale + 2, inputOffsets);
+
+				V s1, c1, s2, c2, s3, c3;
+				sincos<Ops>(ry, s1, c1);
+				sincos<Ops>(rx, s2, c2);
+				sincos<Ops>(rz, s3, c3);
+
+				// rotation part of Ry * Rx * Rz, column major
+				V s1s2 = Ops::mul(s1, s2);
+				V c1s2 = Ops::mul(c1, s2);
+				V r00 = Ops::fmadd(s1s2, s3, Ops::mul(c1, c3));
+				V r01 = Ops::mul(c2, s3);
+				V r02 = Ops::fnmadd(c3, s1, Ops::mul(c1s2, s3));
+				V r10 = Ops::fnmadd(c1, s3, Ops::mul(s1s2, c3));
+				V r11 = Ops::mul(c2, c3);
+				V r12 = Ops::fmadd(c1s2, c3, Ops::mul(s1, s3));
+				V r20 = Ops::mul(c2, s1);
+				V r21 = Ops::neg(s2);
+				V r22 = Ops::mul(c1, c2);
+
+				Ops::storeColumn(matrices, 0, Ops::mul(sx, r00), Ops::mul(sx, r01), Ops::mul(sx, r02), zero);
+				Ops::storeColumn(matrices, 4, Ops::mul(sy, r10), Ops::mul(sy, r11), Ops::mul(sy, r12), zero);
+				Ops::storeColumn(matrices, 8, Ops::mul(sz, r20), Ops::mul(sz, r21), Ops::mul(sz, r22), zero);
+				Ops::storeColumn(matrices, 12, tx, ty, tz, one);
+
+				V ix = Ops::div(one, sx);
+				V iy = Ops::div(one, sy);
+				V iz = Ops::div(one, sz);
+
+				Ops::storeColumn(normals, 0, Ops::mul(ix, r00), Ops::mul(ix, r01), Ops::mul(ix, r02), zero);
+				Ops::storeColumn(normals, 4, Ops::mul(iy, r10), Ops::mul(iy, r11), Ops::mul(iy, r12), zero);
+				Ops::storeColumn(normals, 8, Ops::mul(iz, r20), Ops::mul(iz, r21), Ops::mul(iz, r22), zero);
+				Ops::storeColumn(normals, 12, zero, zero, zero, one);
+			}
+		}
+
+	}
+}
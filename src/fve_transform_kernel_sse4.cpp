@@ -0,0 +1,61 @@
+#include "fve_transform_kernel.hpp"
+
+#ifdef FVE_X86
+
+#include <smmintrin.h>
+
+#include "fve_transform_kernel_impl.hpp"
+
+namespace fve {
+
+	namespace {
+
+		struct Sse4Ops {
+			using V = __m128;
+			using Mask = __m128;
+			static constexpr size_t WIDTH = 4;
+
+			static V set1(float value) { return _mm_set1_ps(value); }
+			static V add(V a, V b) { return _mm_add_ps(a, b); }
+			static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+			static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+			static V div(V a, V b) { return _mm_div_ps(a, b); }
+			static V neg(V a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+			static V fmadd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static V fnmadd(V a, V b, V c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+			static V round(V a) { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+			static V floor(V a) { return _mm_floor_ps(a); }
+
+			static Mask cmpeq(V a, V b) { return _mm_cmpeq_ps(a, b); }
+			static Mask cmpge(V a, V b) { return _mm_cmpge_ps(a, b); }
+			static Mask cmple(V a, V b) { return _mm_cmple_ps(a, b); }
+			static Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+			static V select(Mask mask, V whenTrue, V whenFalse) { return _mm_blendv_ps(whenFalse, whenTrue, mask); }
+
+			static V gather(const float* base, const int32_t* offsets) {
+				return _mm_setr_ps(base[offsets[0]], base[offsets[1]], base[offsets[2]], base[offsets[3]]);
+			}
+
+			// lanes hold one matrix column each for four entities; transpose so every entity gets a contiguous column
+			static void storeColumn(float* const* dst, size_t offset, V x, V y, V z, V w) {
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				_mm_storeu_ps(dst[0] + offset, x);
+				_mm_storeu_ps(dst[1] + offset, y);
+				_mm_storeu_ps(dst[2] + offset, z);
+				_mm_storeu_ps(dst[3] + offset, w);
+			}
+		};
+
+	}
+
+	namespace transform_kernel {
+
+		void computeSse4(const TransformKernelInput& input, const uint32_t* rows, size_t count, const TransformKernelOutput& output) {
+			computeTransforms<Sse4Ops>(input, rows, count, output);
+		}
+
+	}
+
+}
+
+#endif
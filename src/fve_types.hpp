@@ -1,5 +1,7 @@
 #pragma once
 
+#include "fve_pool.hpp"
+
 #include <vma/vk_mem_alloc.h>
 #include <glm/glm.hpp>
 
@@ -31,8 +33,12 @@ namespace fve {
 	struct Texture {
 		AllocatedImage allocatedImage;
 		VkImageView imageView;
+		uint64_t contentHash = 0;
 	};
 
+	// slot of a texture id in FveAssets; stays valid across reloads of that id
+	using TextureHandle = PoolHandle<Texture>;
+
 	struct Vertex {
 		glm::vec3 position{};
 		glm::vec3 color{};
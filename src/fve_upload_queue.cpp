@@ -0,0 +1,114 @@
+#include "fve_upload_queue.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace fve {
+
+	FveUploadQueue::FveUploadQueue(FveDevice& device) : device{ device } {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload command pool!");
+		}
+	}
+
+	FveUploadQueue::~FveUploadQueue() {
+		submit();
+		waitIdle();
+		vkDestroyCommandPool(device.device(), commandPool, nullptr);
+	}
+
+	VkCommandBuffer FveUploadQueue::getCommandBuffer() {
+		if (openBatch != nullptr) return openBatch->commandBuffer;
+
+		openBatch = std::make_unique<Batch>();
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		vkAllocateCommandBuffers(device.device(), &allocInfo, &openBatch->commandBuffer);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(openBatch->commandBuffer, &beginInfo);
+
+		return openBatch->commandBuffer;
+	}
+
+	void FveUploadQueue::copyBuffer(std::unique_ptr<FveBuffer> stagingBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(getCommandBuffer(), stagingBuffer->getAllocatedBuffer().buffer, dstBuffer, 1, &copyRegion);
+
+		keepAlive(std::move(stagingBuffer));
+	}
+
+	void FveUploadQueue::keepAlive(std::unique_ptr<FveBuffer> stagingBuffer) {
+		getCommandBuffer();
+		openBatch->stagingBuffers.push_back(std::move(stagingBuffer));
+	}
+
+	void FveUploadQueue::onComplete(std::function<void()> callback) {
+		getCommandBuffer();
+		openBatch->callbacks.push_back(std::move(callback));
+	}
+
+	void FveUploadQueue::submit() {
+		if (openBatch == nullptr) return;
+
+		vkEndCommandBuffer(openBatch->commandBuffer);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		vkCreateFence(device.device(), &fenceInfo, nullptr, &openBatch->fence);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &openBatch->commandBuffer;
+
+		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, openBatch->fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+
+		inFlight.push_back(std::move(openBatch));
+	}
+
+	void FveUploadQueue::poll() {
+		for (auto it = inFlight.begin(); it != inFlight.end(); ) {
+			if (vkGetFenceStatus(device.device(), (*it)->fence) == VK_SUCCESS) {
+				retire(**it);
+				it = inFlight.erase(it);
+			}
+			else ++it;
+		}
+	}
+
+	void FveUploadQueue::waitIdle() {
+		for (auto& batch : inFlight) {
+			vkWaitForFences(device.device(), 1, &batch->fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			retire(*batch);
+		}
+		inFlight.clear();
+	}
+
+	void FveUploadQueue::retire(Batch& batch) {
+		vkDestroyFence(device.device(), batch.fence, nullptr);
+		vkFreeCommandBuffers(device.device(), commandPool, 1, &batch.commandBuffer);
+		batch.stagingBuffers.clear();
+
+		for (auto& callback : batch.callbacks) {
+			callback();
+		}
+	}
+
+}
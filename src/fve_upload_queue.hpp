@@ -0,0 +1,59 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_buffer.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace fve {
+
+	// Batches transfer commands into one command buffer and submits them behind a fence, so
+	// uploads never stall the CPU. Staging buffers are kept alive and completion callbacks are
+	// run from poll() once the GPU has finished with a batch. Main thread only: it submits to
+	// the graphics queue.
+	class FveUploadQueue {
+	public:
+		FveUploadQueue(FveDevice& device);
+		~FveUploadQueue();
+
+		FveUploadQueue(const FveUploadQueue&) = delete;
+		FveUploadQueue& operator=(const FveUploadQueue&) = delete;
+
+		// command buffer of the open batch, starting a new batch if needed
+		VkCommandBuffer getCommandBuffer();
+
+		void copyBuffer(std::unique_ptr<FveBuffer> stagingBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		void keepAlive(std::unique_ptr<FveBuffer> stagingBuffer);
+		void onComplete(std::function<void()> callback);
+
+		// submits the open batch, if any
+		void submit();
+
+		// retires every batch the GPU has finished, without blocking
+		void poll();
+
+		// blocks until every submitted batch has finished
+		void waitIdle();
+
+		bool hasPendingWork() const { return openBatch != nullptr || !inFlight.empty(); }
+
+	private:
+		struct Batch {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::vector<std::unique_ptr<FveBuffer>> stagingBuffers;
+			std::vector<std::function<void()>> callbacks;
+		};
+
+		void retire(Batch& batch);
+
+		FveDevice& device;
+		VkCommandPool commandPool;
+
+		std::unique_ptr<Batch> openBatch;
+		std::vector<std::unique_ptr<Batch>> inFlight;
+	};
+
+}
@@ -1,9 +1,22 @@
 #pragma once
 
 #include <functional>
+#include <cstdint>
+#include <cstddef>
 
 namespace fve {
 
+	// 64-bit FNV-1a, stable across runs and platforms so it can be written to disk
+	inline uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
 	// from: https://stackoverflow.com/a/57595105
 	template<typename T, typename... Rest>
 	void hashCombine(std::size_t& seed, const T& v, const Rest&... rest) {
@@ -0,0 +1,346 @@
+#include "fve_vfs.hpp"
+#include "fve_utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif
+
+namespace fve {
+
+	FveVfs fveVfs;
+
+	static const char PACK_MAGIC[4] = { 'F', 'V', 'E', 'P' };
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// size bytes at offset stay below limit, without offset + size overflowing
+	static bool fitsRange(uint64_t offset, uint64_t size, uint64_t limit) {
+		return offset <= limit && size <= limit - offset;
+	}
+
+	static bool entryLess(const FveAssetPack::PackEntry& entry, uint64_t hash) {
+		return entry.pathHash < hash;
+	}
+
+	// ================ Asset Pack ================
+
+	FveAssetPack::FveAssetPack(const std::string& packPath) : packPath{ packPath } {
+
+		map(ENGINE_DIR + packPath);
+		try {
+			validate();
+		}
+		catch (...) {
+			unmap();
+			throw;
+		}
+
+#ifndef _WIN32
+		// the table of contents is hit on every lookup, fault it in up front
+		madvise(const_cast<char*>(mapped), static_cast<size_t>(header->tocOffset + uint64_t(header->entryCount) * sizeof(PackEntry)), MADV_WILLNEED);
+#endif
+
+		std::cout << "Mounted asset pack " << packPath << " (" << header->entryCount << " entries)" << std::endl;
+	}
+
+	FveAssetPack::~FveAssetPack() {
+		unmap();
+	}
+
+	void FveAssetPack::map(const std::string& enginePath) {
+
+#ifdef _WIN32
+		fileHandle = CreateFileA(enginePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			fileHandle = nullptr;
+			throw std::runtime_error("failed to open asset pack " + packPath);
+		}
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(fileHandle, &size)) {
+			mappedSize = static_cast<size_t>(size.QuadPart);
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		if (mappingHandle != nullptr) {
+			mapped = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+#else
+		int fd = open(enginePath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::runtime_error("failed to open asset pack " + packPath);
+		}
+
+		struct stat st;
+		mappedSize = fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+
+		void* view = mappedSize > 0 ? mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		close(fd);
+		mapped = view == MAP_FAILED ? nullptr : static_cast<const char*>(view);
+#endif
+
+		if (mapped == nullptr) {
+			unmap();
+			throw std::runtime_error("failed to map asset pack " + packPath);
+		}
+
+	}
+
+	void FveAssetPack::validate() {
+
+		// validate everything we are going to index into
+		if (mappedSize < sizeof(PackHeader)) {
+			throw std::runtime_error("asset pack " + packPath + " is truncated");
+		}
+
+		header = reinterpret_cast<const PackHeader*>(mapped);
+		if (std::memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION) {
+			throw std::runtime_error("asset pack " + packPath + " has an unsupported format");
+		}
+
+		// the sizes come from the file, so every check is written to survive values near 2^64
+		uint64_t tocSize = uint64_t(header->entryCount) * sizeof(PackEntry);
+		if (header->fileSize != mappedSize || header->tocOffset % alignof(PackEntry) != 0
+			|| !fitsRange(header->tocOffset, tocSize, mappedSize)
+			|| header->stringsOffset < header->tocOffset + tocSize || header->stringsOffset > mappedSize) {
+			throw std::runtime_error("asset pack " + packPath + " is corrupt");
+		}
+
+		entries = reinterpret_cast<const PackEntry*>(mapped + header->tocOffset);
+		strings = mapped + header->stringsOffset;
+
+		// check every entry once here so lookups can trust the table; the strings section has no
+		// recorded end, paths only have to stay inside the file
+		uint64_t stringsSize = mappedSize - header->stringsOffset;
+		for (uint32_t i = 0; i < header->entryCount; i++) {
+			const PackEntry& entry = entries[i];
+			bool valid = fitsRange(entry.pathOffset, entry.pathLength, stringsSize)
+				&& entry.offset >= header->stringsOffset && entry.offset % PACK_ALIGNMENT == 0
+				&& fitsRange(entry.offset, entry.size, mappedSize)
+				&& (i == 0 || entries[i - 1].pathHash <= entry.pathHash);
+			if (!valid) {
+				throw std::runtime_error("asset pack " + packPath + " has a corrupt entry " + std::to_string(i));
+			}
+		}
+
+	}
+
+	void FveAssetPack::unmap() {
+
+#ifdef _WIN32
+		if (mapped) UnmapViewOfFile(mapped);
+		if (mappingHandle) CloseHandle(mappingHandle);
+		if (fileHandle) CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+#else
+		if (mapped) munmap(const_cast<char*>(mapped), mappedSize);
+#endif
+		mapped = nullptr;
+		mappedSize = 0;
+		header = nullptr;
+		entries = nullptr;
+		strings = nullptr;
+
+	}
+
+	bool FveAssetPack::find(std::string_view path, FveFileData& outData) const {
+
+		uint64_t hash = fnv1a64(path.data(), path.size());
+
+		const PackEntry* end = entries + header->entryCount;
+		for (const PackEntry* it = std::lower_bound(entries, end, hash, entryLess); it != end && it->pathHash == hash; ++it) {
+
+			// bounds were checked when the pack was mounted
+			std::string_view entryPath{ strings + it->pathOffset, it->pathLength };
+			if (entryPath != path) continue;
+
+			outData = FveFileData{ mapped + it->offset, static_cast<size_t>(it->size) };
+			return true;
+		}
+
+		return false;
+	}
+
+	void FveAssetPack::build(const std::string& packPath, const std::vector<std::string>& filePaths) {
+
+		struct Source {
+			std::string path;
+			std::vector<char> bytes;
+			PackEntry entry;
+		};
+
+		std::vector<Source> sources;
+		sources.reserve(filePaths.size());
+
+		for (const auto& filePath : filePaths) {
+			Source source;
+			source.path = FveVfs::normalizePath(filePath);
+
+			FveFileData data = fveVfs.readLooseFile(source.path);
+			source.bytes.assign(data.data(), data.data() + data.size());
+
+			std::string_view extension = std::string_view(source.path).substr(source.path.find_last_of('.') + 1);
+			EntryType type = EntryType::Unknown;
+			if (extension == "obj") type = EntryType::Mesh;
+			else if (extension == "png" || extension == "jpg" || extension == "tga") type = EntryType::Texture;
+			else if (extension == "spv") type = EntryType::Shader;
+
+			source.entry = PackEntry{ fnv1a64(source.path.data(), source.path.size()), 0, source.bytes.size(), 0, static_cast<uint32_t>(source.path.size()), type, 0 };
+			sources.push_back(std::move(source));
+		}
+
+		// sorted so lookups can binary search the mapped table
+		std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) {
+			if (a.entry.pathHash != b.entry.pathHash) return a.entry.pathHash < b.entry.pathHash;
+			return a.path < b.path;
+		});
+
+		// lay the file out: header, toc, strings, then aligned blobs
+		PackHeader header{};
+		std::memcpy(header.magic, PACK_MAGIC, 4);
+		header.version = PACK_VERSION;
+		header.entryCount = static_cast<uint32_t>(sources.size());
+		header.tocOffset = alignUp(sizeof(PackHeader), alignof(PackEntry));
+		header.stringsOffset = header.tocOffset + sources.size() * sizeof(PackEntry);
+
+		uint64_t stringsSize = 0;
+		for (auto& source : sources) {
+			source.entry.pathOffset = static_cast<uint32_t>(stringsSize);
+			stringsSize += source.path.size();
+		}
+
+		uint64_t offset = alignUp(header.stringsOffset + stringsSize, PACK_ALIGNMENT);
+		for (auto& source : sources) {
+			source.entry.offset = offset;
+			offset = alignUp(offset + source.entry.size, PACK_ALIGNMENT);
+		}
+		header.fileSize = offset;
+
+		std::string enginePath = ENGINE_DIR + packPath;
+		std::ofstream out{ enginePath, std::ios::binary | std::ios::trunc };
+		if (!out.is_open()) {
+			throw std::runtime_error("failed to create asset pack " + packPath);
+		}
+
+		auto pad = [&out](uint64_t target) {
+			static const char zeros[PACK_ALIGNMENT] = {};
+			uint64_t position = static_cast<uint64_t>(out.tellp());
+			while (position < target) {
+				uint64_t count = std::min<uint64_t>(target - position, PACK_ALIGNMENT);
+				out.write(zeros, count);
+				position += count;
+			}
+		};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		pad(header.tocOffset);
+		for (auto& source : sources) {
+			out.write(reinterpret_cast<const char*>(&source.entry), sizeof(PackEntry));
+		}
+		for (auto& source : sources) {
+			out.write(source.path.data(), source.path.size());
+		}
+		for (auto& source : sources) {
+			pad(source.entry.offset);
+			out.write(source.bytes.data(), source.bytes.size());
+		}
+		pad(header.fileSize);
+
+		if (!out.good()) {
+			throw std::runtime_error("failed to write asset pack " + packPath);
+		}
+
+		std::cout << "Wrote asset pack " << packPath << ": " << sources.size() << " entries, " << header.fileSize << " bytes" << std::endl;
+	}
+
+	// ================ VFS ================
+
+	bool FveVfs::mountPack(const std::string& packPath) {
+
+		std::ifstream probe{ ENGINE_DIR + packPath, std::ios::binary };
+		if (!probe.is_open()) return false;
+		probe.close();
+
+		packs.push_back(std::make_unique<FveAssetPack>(packPath));
+		return true;
+	}
+
+	bool FveVfs::exists(const std::string& path) const {
+
+		std::string normalized = normalizePath(path);
+
+		FveFileData data;
+		for (auto it = packs.rbegin(); it != packs.rend(); ++it) {
+			if ((*it)->find(normalized, data)) return true;
+		}
+
+		std::error_code error;
+		return std::filesystem::is_regular_file(ENGINE_DIR + normalized, error);
+	}
+
+	FveFileData FveVfs::readFile(const std::string& path) const {
+
+		std::string normalized = normalizePath(path);
+
+		// newest pack wins
+		FveFileData data;
+		for (auto it = packs.rbegin(); it != packs.rend(); ++it) {
+			if ((*it)->find(normalized, data)) return data;
+		}
+
+		return readLooseFile(normalized);
+	}
+
+	FveFileData FveVfs::readLooseFile(const std::string& path) const {
+
+		std::string enginePath = ENGINE_DIR + path;
+
+		std::ifstream file{ enginePath, std::ios::ate | std::ios::binary };
+
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file " + path);
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<char> buffer(fileSize);
+
+		file.seekg(0);
+		file.read(buffer.data(), fileSize);
+		file.close();
+
+		return FveFileData{ std::move(buffer) };
+	}
+
+	std::string FveVfs::normalizePath(std::string_view path) {
+
+		std::string normalized{ path };
+		std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+		while (normalized.rfind("./", 0) == 0) {
+			normalized.erase(0, 2);
+		}
+
+		return normalized;
+	}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fve {
+
+	// Read-only bytes of a file. Either borrowed straight out of a mapped pack or owned,
+	// when the file came from disk.
+	class FveFileData {
+	public:
+		FveFileData() = default;
+		FveFileData(const char* data, size_t size) : ptr{ data }, length{ size } {}
+		explicit FveFileData(std::vector<char>&& bytes) : owned{ std::move(bytes) } {
+			ptr = owned.data();
+			length = owned.size();
+		}
+
+		FveFileData(FveFileData&& other) noexcept { *this = std::move(other); }
+		FveFileData& operator=(FveFileData&& other) noexcept {
+			bool isOwned = other.ptr == other.owned.data();
+			owned = std::move(other.owned);
+			ptr = isOwned ? owned.data() : other.ptr;
+			length = other.length;
+			other.ptr = nullptr;
+			other.length = 0;
+			return *this;
+		}
+
+		FveFileData(const FveFileData&) = delete;
+		FveFileData& operator=(const FveFileData&) = delete;
+
+		const char* data() const { return ptr; }
+		size_t size() const { return length; }
+		bool empty() const { return length == 0; }
+
+	private:
+		const char* ptr = nullptr;
+		size_t length = 0;
+		std::vector<char> owned;
+	};
+
+	// A single-file archive of assets, memory mapped on open.
+	//
+	// Layout: PackHeader | PackEntry[entryCount] sorted by (pathHash, path) | path strings | blobs.
+	// Every blob starts on a PACK_ALIGNMENT boundary, so SPIR-V and vertex data can be used in place.
+	class FveAssetPack {
+	public:
+		static constexpr uint32_t PACK_VERSION = 1;
+		static constexpr uint64_t PACK_ALIGNMENT = 64;
+
+		enum class EntryType : uint32_t { Unknown = 0, Mesh = 1, Texture = 2, Shader = 3 };
+
+		struct PackHeader {
+			char magic[4];
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+			uint64_t tocOffset;
+			uint64_t stringsOffset;
+			uint64_t fileSize;
+		};
+
+		struct PackEntry {
+			uint64_t pathHash;
+			uint64_t offset;
+			uint64_t size;
+			uint32_t pathOffset;
+			uint32_t pathLength;
+			EntryType type;
+			uint32_t reserved;
+		};
+
+		explicit FveAssetPack(const std::string& packPath);
+		~FveAssetPack();
+
+		FveAssetPack(const FveAssetPack&) = delete;
+		FveAssetPack& operator=(const FveAssetPack&) = delete;
+
+		// binary search of the table of contents; nothing is read from disk until the bytes are touched
+		bool find(std::string_view path, FveFileData& outData) const;
+
+		uint32_t entryCount() const { return header->entryCount; }
+		const std::string& getPath() const { return packPath; }
+
+		// writes a pack holding the given files (paths relative to ENGINE_DIR)
+		static void build(const std::string& packPath, const std::vector<std::string>& filePaths);
+
+	private:
+		std::string packPath;
+
+		const char* mapped = nullptr;
+		size_t mappedSize = 0;
+
+		const PackHeader* header = nullptr;
+		const PackEntry* entries = nullptr;
+		const char* strings = nullptr;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+
+		// opens and maps the whole file, releasing whatever it got before throwing
+		void map(const std::string& enginePath);
+		// checks everything lookups index into, throws on a truncated or corrupt pack
+		void validate();
+		// safe on a partly mapped pack, the destructor does not run when the constructor throws
+		void unmap();
+	};
+
+	// The one place assets are read from. Mounted packs are searched newest first,
+	// then the loose files under ENGINE_DIR.
+	class FveVfs {
+	public:
+		// returns false if the pack doesn't exist
+		bool mountPack(const std::string& packPath);
+
+		bool exists(const std::string& path) const;
+
+		// throws std::runtime_error if the file can't be found anywhere
+		FveFileData readFile(const std::string& path) const;
+
+		// always reads from disk, bypassing mounted packs (used by hot reload)
+		FveFileData readLooseFile(const std::string& path) const;
+
+		static std::string normalizePath(std::string_view path);
+
+	private:
+		std::vector<std::unique_ptr<FveAssetPack>> packs;
+	};
+
+	extern FveVfs fveVfs;
+
+}
@@ -4,12 +4,23 @@
 #include "systems/simple_render_system.hpp"
 #include "systems/point_light_system.hpp"
 #include "systems/textured_render_system.hpp"
+#include "systems/transform_system.hpp"
+#include "systems/spatial_system.hpp"
+#include "systems/culling_system.hpp"
+#include "systems/occlusion_system.hpp"
+#include "systems/gpu_culling_system.hpp"
 #include "fve_camera.hpp"
 #include "fve_buffer.hpp"
 #include "fve_memory.hpp"
 #include "fve_assets.hpp"
 #include "fve_initializers.hpp"
 #include "fve_constants.hpp"
+#include "fve_task_graph.hpp"
+#include "fve_job_system.hpp"
+#include "fve_timestep.hpp"
+#include "fve_scene.hpp"
+#include "fve_vfs.hpp"
+#include "fve_render_queue.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -24,6 +35,7 @@
 #include <cassert>
 #include <chrono>
 #include <array>
+#include <thread>
 
 namespace fve {
 
@@ -72,12 +84,31 @@ namespace fve {
 		// used to init globalSetLayout here
 
 		// ================ PREPARE ASSETS ================
+		// kicked off first so parsing and decoding overlap with pipeline creation
 		loadTextures();
+		loadMeshes();
 
 		// ================ PREPARE RENDERING SYSTEMS ================
-		SimpleRenderSystem simpleRenderSystem{ device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
+		// cull and build draws on the GPU where the device can, otherwise on the CPU
+		std::unique_ptr<GpuCullingSystem> gpuCullingSystem;
+		if (GpuCullingSystem::isSupported(device)) {
+			gpuCullingSystem = std::make_unique<GpuCullingSystem>(device);
+		}
+
+		// the CPU path's visible models, sorted by state and drawn instanced
+		FveRenderQueue renderQueue{ device };
+
+		SimpleRenderSystem simpleRenderSystem{ device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), renderQueue, gpuCullingSystem.get() };
 		PointLightSystem pointLightSystem{ device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
-		TexturedRenderSystem texturedRenderSystem{ device, renderer.getSwapChainRenderPass(), texturedSetLayout->getDescriptorSetLayout() };
+		TexturedRenderSystem texturedRenderSystem{ device, renderer.getSwapChainRenderPass(), texturedSetLayout->getDescriptorSetLayout(), renderQueue, gpuCullingSystem.get() };
+		TransformSystem transformSystem{};
+		SpatialSystem spatialSystem{};
+		CullingSystem cullingSystem{};
+		OcclusionSystem occlusionSystem{};
+
+		// the descriptor sets below need the texture views
+		fveAssets.waitForAsyncLoads(device);
+		fveAssets.reportDeduplication();
 
 		// thing
 		std::vector<VkDescriptorSet> globalDescriptorSets(FveSwapChain::MAX_FRAMES_IN_FLIGHT);
@@ -89,54 +120,191 @@ namespace fve {
 		}
 
 		std::vector<VkDescriptorSet> texturedDescriptorSets(FveSwapChain::MAX_FRAMES_IN_FLIGHT);
-		for (int i = 0; i < texturedDescriptorSets.size(); i++) {
-			auto bufferInfo = uboBuffers[i]->descriptorInfo();
-
-			VkSampler sampler = *fveAssets.createSampler(device, VK_FILTER_LINEAR, "default_sampler");
+		// the texture each textured set samples, a reload rewrites the sets that name it
+		std::vector<std::string> texturedSetTextures(texturedDescriptorSets.size(), "nixon");
+		VkSampler sampler = *fveAssets.createSampler(device, VK_FILTER_LINEAR, "default_sampler");
 
-			Material* texturedMat = fveAssets.getMaterial("texturedmaterial");
+		auto writeTexturedSet = [&](size_t i, bool overwrite) {
+			auto bufferInfo = uboBuffers[i]->descriptorInfo();
 
 			VkDescriptorImageInfo imageBufferInfo;
 			imageBufferInfo.sampler = sampler;
-			imageBufferInfo.imageView = fveAssets.getTexture("nixon")->imageView;
+			imageBufferInfo.imageView = fveAssets.getTexture(texturedSetTextures[i])->imageView;
 			imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-			FveDescriptorWriter(*texturedSetLayout, *globalPool)
-				.writeBuffer(0, &bufferInfo)
-				.writeImage(1, &imageBufferInfo)
-				.build(texturedDescriptorSets[i]);
+			FveDescriptorWriter writer{ *texturedSetLayout, *globalPool };
+			writer.writeBuffer(0, &bufferInfo).writeImage(1, &imageBufferInfo);
+			if (overwrite) writer.overwrite(texturedDescriptorSets[i]);
+			else writer.build(texturedDescriptorSets[i]);
+		};
 
+		Material* texturedMat = fveAssets.getMaterial("texturedmaterial");
+		for (size_t i = 0; i < texturedDescriptorSets.size(); i++) {
+			writeTexturedSet(i, false);
 			texturedMat->textureSet = texturedDescriptorSets[i];
 		}
 
 		// ================ PREPARE SCENE ================
 		loadGameObjects();
+
+#ifndef NDEBUG
+		// pick up edits to meshes, textures and shaders without restarting
+		fveAssets.addReloadListener([&](FveAssets::AssetType type, const std::string& assetId) {
+			// retained draws may bind the old pipeline, mesh buffers or descriptor sets
+			renderer.getFrameCommands().invalidateRetained();
+
+			// a reloaded mesh has new bounds, but the entities using it didn't move
+			if (type == FveAssets::AssetType::Mesh) spatialSystem.refreshModelBounds();
+
+			if (type != FveAssets::AssetType::Texture) return;
+
+			// the descriptor sets sampling it still point at the old image view
+			for (size_t i = 0; i < texturedDescriptorSets.size(); i++) {
+				if (texturedSetTextures[i] == assetId) writeTexturedSet(i, true);
+			}
+		});
+		fveAssets.enableHotReload();
+#endif
 		
 
 		FveCamera camera{};
 		camera.setViewTarget(glm::vec3(-1, -2, 2), glm::vec3(0.0f, 0.0f, 2.5f));
 
-		auto viewerObject = FveGameObject::createGameObject();
-		viewerObject.transform.translation.z = -2.5f;
+		TransformComponent viewerTransform{};
+		viewerTransform.translation.z = -2.5f;
 		MovementController cameraController{};
 		cameraController.init(window.getGLFWwindow(), fve::WIDTH, fve::HEIGHT);
 
+		// the camera as of the previous simulation step, rendering blends from it
+		TransformComponent previousViewerTransform = viewerTransform;
+		FveFixedTimestep timestep{ SIMULATION_RATE, MAX_SIMULATION_STEPS };
+
 		auto currentTime = std::chrono::high_resolution_clock::now();
 
 		// persistent uniforms
 		GlobalUbo ubo{};
 
+		// ================ PREPARE FRAME GRAPH ================
+		// the update systems, scheduled from what they touch; the tasks reach the frame through this
+		FrameInfo* currentFrame = nullptr;
+
+		FveTaskGraph frameGraph;
+		FveTaskGraph::Resource cameraResource = frameGraph.resource("camera");
+		FveTaskGraph::Resource cameraUniforms = frameGraph.resource("camera uniforms");
+		FveTaskGraph::Resource lightUniforms = frameGraph.resource("light uniforms");
+		FveTaskGraph::Resource uniformBuffer = frameGraph.resource("uniform buffer");
+		FveTaskGraph::Resource gpuCullingBuffers = frameGraph.resource("gpu culling buffers");
+		FveTaskGraph::Resource renderQueueResource = frameGraph.resource("render queue");
+
+		frameGraph.addTask("camera uniforms")
+			.reads(cameraResource)
+			.writes(cameraUniforms)
+			.run([&]() {
+				ubo.projection = camera.getProjection();
+				ubo.view = camera.getView();
+				ubo.inverseView = camera.getInverseView();
+			});
+
+		frameGraph.addTask("light uniforms")
+			.reads<TransformComponent, ColorComponent, PointLightComponent, InterpolationComponent>()
+			.writes(lightUniforms)
+			.run([&]() { pointLightSystem.writeUniforms(*currentFrame, ubo); });
+
+		// rebuild world matrices for whatever moved or is blending between steps
+		frameGraph.addTask("transforms")
+			.reads<ParentComponent>()
+			.writes<TransformComponent, WorldTransformComponent, InterpolationComponent>()
+			.run([&]() { transformSystem.update(world, currentFrame->alpha); });
+
+		// gives new entities their bounds
+		frameGraph.addTask("spatial")
+			.structural()
+			.run([&]() { spatialSystem.update(world); });
+
+		// flag what the camera can see, the render systems skip the rest
+		frameGraph.addTask("frustum culling")
+			.reads<TransformComponent, PointLightComponent>()
+			.writes<BoundsComponent>()
+			.reads(cameraResource)
+			.run([&]() { cullingSystem.update(world, camera); });
+
+		if (gpuCullingSystem) {
+			frameGraph.addTask("gpu culling")
+				.reads<WorldTransformComponent, ModelComponent, TextureComponent, BoundsComponent>()
+				.reads(cameraResource)
+				.writes(gpuCullingBuffers)
+				.run([&]() { gpuCullingSystem->update(*currentFrame); });
+		}
+		else {
+			frameGraph.addTask("occlusion culling")
+				.reads<OccluderComponent, WorldTransformComponent, ModelComponent>()
+				.writes<BoundsComponent>()
+				.reads(cameraResource)
+				.run([&]() { occlusionSystem.update(world, camera); });
+
+			// once visibility is settled, before the render systems record
+			frameGraph.addTask("render queue")
+				.reads<WorldTransformComponent, ModelComponent, TextureComponent, BoundsComponent>()
+				.reads(cameraResource)
+				.writes(renderQueueResource)
+				.run([&]() { renderQueue.extract(*currentFrame); });
+		}
+
+		// write the uniform changes
+		frameGraph.addTask("upload uniforms")
+			.reads(cameraUniforms)
+			.reads(lightUniforms)
+			.writes(uniformBuffer)
+			.run([&]() {
+				uboBuffers[currentFrame->frameIndex]->writeToBuffer(&ubo);
+				uboBuffers[currentFrame->frameIndex]->flush();
+			});
+
+		// F3 prints the last frame's schedule and critical path, and what drawing this frame cost
+		bool dumpKeyHeld = false;
+		bool saveKeyHeld = false;
+		// F4 switches replaying unchanged draws on and off
+		bool retainKeyHeld = false;
+
 		// game loop
 		while (!window.shouldClose()) {
 			glfwPollEvents();
+
+			// swap in any assets that changed on disk while no frame is being recorded
+			fveAssets.processReloads(device);
+			fveAssets.updateAsyncLoads(device);
 			cameraController.update(window.getGLFWwindow());
 
+			// hold the render rate down when asked to, the simulation rate doesn't depend on it
+			if (MAX_FRAME_RATE > 0.0f) {
+				auto minimumFrameTime = std::chrono::duration<float>(1.0f / MAX_FRAME_RATE);
+				std::this_thread::sleep_until(currentTime + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(minimumFrameTime));
+			}
+
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
 
-			cameraController.moveInPlaneXZ(window.getGLFWwindow(), frameTime, viewerObject);
-			camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+			// ================ SIMULATE ================
+			// whole fixed steps only, whatever is left over carries to the next frame
+			uint32_t steps = timestep.advance(frameTime);
+			for (uint32_t step = 0; step < steps; step++) {
+				float dt = timestep.getStep();
+				previousViewerTransform = viewerTransform;
+				transformSystem.beginStep(world);
+
+				cameraController.moveInPlaneXZ(window.getGLFWwindow(), dt, viewerTransform);
+				pointLightSystem.update(world, dt);
+
+				// update the sun position
+				auto rotateSun = glm::rotate(glm::mat4(1.0f), dt * 0.25f, { 0.0f, 0.0f, -1.0f });
+				ubo.sun.lightDirection = rotateSun * ubo.sun.lightDirection;
+			}
+
+			// draw the camera between the last two steps
+			float alpha = timestep.getAlpha();
+			TransformComponent renderViewerTransform = interpolateTransform(previousViewerTransform, viewerTransform, alpha);
+			camera.setViewYXZ(renderViewerTransform.translation, renderViewerTransform.rotation);
 
 			if (auto commandBuffer = renderer.beginFrame()) {
 				// ================ PREPARE ================
@@ -145,11 +313,13 @@ namespace fve {
 				FrameInfo frameInfo{
 					frameIndex,
 					frameTime,
+					alpha,
 					commandBuffer,
 					camera,
 					globalDescriptorSets[frameIndex],
 					texturedDescriptorSets[frameIndex],
-					gameObjects
+					world,
+					renderer.getFrameCommands()
 				};
 
 				// ================ INPUT ================
@@ -159,21 +329,39 @@ namespace fve {
 
 				// ================ UPDATE ================
 
-				// update the uniforms
-				ubo.projection = camera.getProjection();
-				ubo.view = camera.getView();
-				ubo.inverseView = camera.getInverseView();
-				pointLightSystem.update(frameInfo, ubo);
-
-				// update the sun position
-				auto rotateLight = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime * 0.25f, { 0.0f, 0.0f, -1.0f });
-				ubo.sun.lightDirection = rotateLight * ubo.sun.lightDirection;
-
-				// write the uniform changes
-				uboBuffers[frameIndex]->writeToBuffer(&ubo);
-				uboBuffers[frameIndex]->flush();
+				currentFrame = &frameInfo;
+				frameGraph.execute(fveJobs);
+
+				bool dumpKeyPressed = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F3) == GLFW_PRESS;
+				bool dumpFrame = dumpKeyPressed && !dumpKeyHeld;
+				if (dumpFrame) {
+					frameGraph.dump(std::cout);
+				}
+				dumpKeyHeld = dumpKeyPressed;
+
+				bool saveKeyPressed = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F5) == GLFW_PRESS;
+				if (saveKeyPressed && !saveKeyHeld) {
+					try {
+						FveScene::save(world, SCENE_PATH);
+					}
+					catch (const std::exception& e) {
+						std::cerr << e.what() << std::endl;
+					}
+				}
+				saveKeyHeld = saveKeyPressed;
+
+				bool retainKeyPressed = glfwGetKey(window.getGLFWwindow(), GLFW_KEY_F4) == GLFW_PRESS;
+				if (retainKeyPressed && !retainKeyHeld) {
+					renderQueue.setRetained(!renderQueue.isRetained());
+					std::cout << "Retained rendering " << (renderQueue.isRetained() ? "on" : "off") << std::endl;
+				}
+				retainKeyHeld = retainKeyPressed;
 
 				// ================ RENDER ================
+
+				if (gpuCullingSystem) {
+					gpuCullingSystem->recordCulling(frameInfo, renderer.getSwapChainExtent());
+				}
 				
 				// begin offscreen shadow pass
 				// render shadow casting objects
@@ -187,6 +375,25 @@ namespace fve {
 				pointLightSystem.render(frameInfo);
 
 				renderer.endSwapChainRenderPass(commandBuffer);
+
+				if (dumpFrame && !gpuCullingSystem) {
+					const RenderQueueStats& stats = renderQueue.getStats();
+					std::cout << "Render queue: " << stats.items << " items, " << stats.batches << " batches, " << stats.draws << " draws, "
+						<< stats.pipelineBinds << " pipeline binds, " << stats.descriptorBinds << " descriptor binds, "
+						<< stats.bufferBinds << " buffer binds, " << stats.secondaries << " secondaries, " << stats.replays << " replayed layers" << std::endl;
+				}
+
+				if (dumpFrame && gpuCullingSystem) {
+					const GpuCullingStats& stats = gpuCullingSystem->getStats();
+					std::cout << "GPU culling: " << stats.objects << " objects, " << stats.batches << " batches, "
+						<< stats.uploads << " rows uploaded" << std::endl;
+				}
+
+				// next frame's occlusion test reads this frame's depth
+				if (gpuCullingSystem) {
+					gpuCullingSystem->recordDepthPyramid(frameInfo, renderer.getDepthImageView());
+				}
+
 				renderer.endFrame();
 
 			}
@@ -202,43 +409,56 @@ namespace fve {
 
 	void Game::loadTextures() {
 
-		fveAssets.loadTexture(device, "textures/nixon.png", "nixon");
+		fveAssets.loadTextureAsync(device, "textures/nixon.png", "nixon");
 
 	}
 
-	void Game::loadGameObjects() {
+	void Game::loadMeshes() {
+
+		fveAssets.loadMeshAsync(device, "models/flat_vase.obj", "flat_vase_mesh");
+		fveAssets.loadMeshAsync(device, "models/smooth_vase.obj", "smooth_vase_mesh");
+		fveAssets.keepOccluderGeometry("floor_mesh");
+		fveAssets.loadMeshAsync(device, "models/quad.obj", "floor_mesh");
 
-		// LOAD MESHES
-		Mesh* flatVaseMesh = fveAssets.loadMeshFromFile(device, "models/flat_vase.obj", "flat_vase_mesh");
-		Mesh* smoothVaseMesh = fveAssets.loadMeshFromFile(device, "models/smooth_vase.obj", "smooth_vase_mesh");
-		Mesh* floorMesh = fveAssets.loadMeshFromFile(device, "models/quad.obj", "floor_mesh");
+	}
+
+	void Game::loadGameObjects() {
 
+		// meshes were loaded asynchronously by loadMeshes
 		Material* defaultMaterial = fveAssets.getMaterial("defaultmaterial");
 		Material* floorMaterial = fveAssets.getMaterial("texturedmaterial");
 
-		FveModel* flatVaseModel = fveAssets.createModel(device, flatVaseMesh, defaultMaterial, "flat_vase_mat");
-		FveModel* smoothVaseModel = fveAssets.createModel(device, smoothVaseMesh, defaultMaterial, "smooth_case_mat");
-		FveModel* floorModel = fveAssets.createModel(device, floorMesh, floorMaterial, "floor_mat");
+		FveModel* flatVaseModel = fveAssets.createModel(device, "flat_vase_mesh", defaultMaterial, "flat_vase_mat");
+		FveModel* smoothVaseModel = fveAssets.createModel(device, "smooth_vase_mesh", defaultMaterial, "smooth_case_mat");
+		FveModel* floorModel = fveAssets.createModel(device, "floor_mesh", floorMaterial, "floor_mat");
+
+		// a saved level replaces everything below, its models are looked up by the names above
+		if (fveVfs.exists(SCENE_PATH)) {
+			size_t count = FveScene::load(world, SCENE_PATH);
+			std::cout << "Loaded " << count << " entities from " << SCENE_PATH << std::endl;
+			return;
+		}
 		
 		{
-			auto flatVase = FveGameObject::createGameObject();
-			flatVase.model = flatVaseModel;
-			flatVase.transform.translation = { -0.5f, 0.5f, 0.0f };
-			flatVase.transform.scale = { 3.0f, 1.5f, 3.0f };
-			gameObjects.emplace(flatVase.getId(), std::move(flatVase));
+			Entity flatVase = world.createEntity();
+			auto& transform = world.addComponent<TransformComponent>(flatVase);
+			transform.translation = { -0.5f, 0.5f, 0.0f };
+			transform.scale = { 3.0f, 1.5f, 3.0f };
+			world.addComponent<WorldTransformComponent>(flatVase);
+			world.addComponent<ModelComponent>(flatVase, flatVaseModel);
 		}
 
 		{
-			auto smoothVase = FveGameObject::createGameObject();
-			smoothVase.model = smoothVaseModel;
-			smoothVase.transform.translation = { 0.5f, 0.5f, 0.0f };
-			smoothVase.transform.scale = { 3.0f, 1.5f, 3.0f };
-			gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
+			Entity smoothVase = world.createEntity();
+			auto& transform = world.addComponent<TransformComponent>(smoothVase);
+			transform.translation = { 0.5f, 0.5f, 0.0f };
+			transform.scale = { 3.0f, 1.5f, 3.0f };
+			world.addComponent<WorldTransformComponent>(smoothVase);
+			world.addComponent<ModelComponent>(smoothVase, smoothVaseModel);
 		}
 
 		/*{
-			auto pointLight = FveGameObject::makePointLight(0.2f);
-			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+			createPointLight(world, 0.2f);
 		}*/
 
 		// COLORFUL LIGHTS TIME
@@ -251,15 +471,18 @@ namespace fve {
 			{1.f, 1.f, 1.f}
 		};
 
+		world.reserve<TransformComponent, ColorComponent, PointLightComponent, InterpolationComponent>(lightColors.size());
 		for (int i = 0; i < lightColors.size(); i++) {
-			auto pointLight = FveGameObject::makePointLight(0.2f);
-			pointLight.color = lightColors[i];
+			Entity pointLight = createPointLight(world, 0.2f, 0.1f, lightColors[i]);
 			auto rotateLight = glm::rotate(
 				glm::mat4(1.0f),
 				(i * glm::two_pi<float>()) / lightColors.size(),
 				{0.0f, -1.0f, 0.0f});
-			pointLight.transform.translation = glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
-			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+			TransformComponent& transform = world.getComponent<TransformComponent>(pointLight);
+			transform.translation = glm::vec3(rotateLight * glm::vec4(-1.0f, -1.0f, -1.0f, 1.0f));
+
+			// start at rest rather than blending in from the origin
+			world.getComponent<InterpolationComponent>(pointLight).previous = transform;
 		}
 
 		// CREATE SOMETHING WITH A TEXTURE
@@ -296,16 +519,14 @@ namespace fve {
 
 		// TEXTURE THE FLOOR
 		{
-			auto floor = FveGameObject::createGameObject();
-			floor.model = floorModel;
-			floor.transform.translation = { 0.0f, 0.5f, 0.0f };
-			floor.transform.scale = { 3.0f, 1.0f, 3.0f };
-
-			TextureComponent texComp{"nixon"};
-
-			floor.texture = std::make_unique<TextureComponent>(texComp);
-
-			gameObjects.emplace(floor.getId(), std::move(floor));
+			Entity floor = world.createEntity();
+			auto& transform = world.addComponent<TransformComponent>(floor);
+			transform.translation = { 0.0f, 0.5f, 0.0f };
+			transform.scale = { 3.0f, 1.0f, 3.0f };
+			world.addComponent<WorldTransformComponent>(floor);
+			world.addComponent<ModelComponent>(floor, floorModel);
+			world.addComponent<TextureComponent>(floor, fveAssets.getTextureHandle("nixon"));
+			world.addComponent<OccluderComponent>(floor);
 		}
 
 	}
@@ -3,7 +3,7 @@
 #include "fve_window.hpp"
 #include "fve_device.hpp"
 #include "fve_renderer.hpp"
-#include "fve_game_object.hpp"
+#include "fve_components.hpp"
 #include "fve_descriptors.hpp"
 
 #include <vma/vk_mem_alloc.h>
@@ -31,12 +31,13 @@ namespace fve {
 		std::unique_ptr<FveDescriptorSetLayout> globalSetLayout;
 		std::unique_ptr<FveDescriptorSetLayout> texturedSetLayout;
 
-		FveGameObject::Map gameObjects;
+		FveWorld world;
 
 		Game(const Game&) = delete;
 		Game& operator=(const Game&) = delete;
 
 		void loadTextures();
+		void loadMeshes();
 		void loadGameObjects();
 	};
 
@@ -4,14 +4,29 @@
 #include "fve_memory.hpp"
 #include "fve_constants.hpp"
 #include "fve_globals.hpp"
+#include "fve_vfs.hpp"
+#include "fve_job_system.hpp"
+#include "fve_scene.hpp"
+#include "fve_render_queue.hpp"
+#include "fve_mesh_arena.hpp"
+#include "systems/transform_system.hpp"
+#include "systems/spatial_system.hpp"
+#include "systems/point_light_system.hpp"
+#include "systems/occlusion_system.hpp"
 
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
 
 void runGame() {
 
+    // prefer the packed assets when they have been built, loose files fill in the rest
+    fve::fveVfs.mountPack("assets.fvepack");
+
     fve::FveWindow window{ fve::WIDTH, fve::HEIGHT, "First Vulkan Game" };
     fve::FveDevice device{ window };
 
@@ -24,7 +39,71 @@ void runGame() {
 
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+    // usage: FveEngine --build-pack <pack> <asset>...
+    if (argc >= 3 && std::strcmp(argv[1], "--build-pack") == 0) {
+        try {
+            std::vector<std::string> files(argv + 3, argv + argc);
+            fve::FveAssetPack::build(argv[2], files);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // usage: FveEngine --bench-transforms [count]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-transforms") == 0) {
+        size_t count = argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+        bool valid = fve::TransformSystem::validateKernels();
+        fve::TransformSystem::benchmark(count);
+        return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // usage: FveEngine --bench-spatial [count]...
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-spatial") == 0) {
+        std::vector<size_t> counts{ 10000, 100000, 1000000 };
+        if (argc >= 3) {
+            counts.clear();
+            for (int i = 2; i < argc; i++) counts.push_back(std::strtoul(argv[i], nullptr, 10));
+        }
+        for (size_t count : counts) fve::SpatialSystem::benchmark(count);
+        return EXIT_SUCCESS;
+    }
+
+    // usage: FveEngine --bench-jobs [count]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-jobs") == 0) {
+        size_t count = argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+        bool valid = fve::FveJobSystem::validate();
+        fve::FveJobSystem::benchmark(count);
+        return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // usage: FveEngine --bench-scene [count]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-scene") == 0) {
+        size_t count = argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+        return fve::FveScene::benchmark(count) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // usage: FveEngine --bench-sort [count]
+    if (argc >= 2 && std::strcmp(argv[1], "--bench-sort") == 0) {
+        if (!fve::FveRenderQueue::validate() || !fve::FveRangeAllocator::validate()) return EXIT_FAILURE;
+        size_t count = argc >= 3 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+        fve::FveRenderQueue::benchmark(count);
+        return EXIT_SUCCESS;
+    }
+
+    // usage: FveEngine --test-lights
+    if (argc >= 2 && std::strcmp(argv[1], "--test-lights") == 0) {
+        return fve::PointLightSystem::validate() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // usage: FveEngine --test-occlusion
+    if (argc >= 2 && std::strcmp(argv[1], "--test-occlusion") == 0) {
+        return fve::OcclusionSystem::validate() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     try {
         runGame();
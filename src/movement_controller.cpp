@@ -27,7 +27,7 @@ namespace fve {
 		lastMouseY = ypos;*/
 	}
 
-	void MovementController::moveInPlaneXZ(GLFWwindow* window, float dt, FveGameObject& gameObject) {
+	void MovementController::moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform) {
 
 		double xpos{}, ypos{};
 		glfwGetCursorPos(window, &xpos, &ypos);
@@ -58,16 +58,16 @@ namespace fve {
 		}
 
 		if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
-			//gameObject.transform.rotation += sensitivity * dt * glm::normalize(rotate);
-			gameObject.transform.rotation += sensitivity * dt * rotate;
+			//transform.rotation += sensitivity * dt * glm::normalize(rotate);
+			transform.rotation += sensitivity * dt * rotate;
 		}
 
 		// clamp pitch
-		gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
+		transform.rotation.x = glm::clamp(transform.rotation.x, -1.5f, 1.5f);
 		// mod yaw
-		gameObject.transform.rotation.y = glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+		transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
 
-		float yaw = gameObject.transform.rotation.y;
+		float yaw = transform.rotation.y;
 		const glm::vec3 forwardDir{ sin(yaw), 0.0f, cos(yaw) };
 		const glm::vec3 rightDir{ forwardDir.z, 0.0f, -forwardDir.x };
 		const glm::vec3 upDir{ 0.0f, -1.0f, 0.0f };
@@ -84,7 +84,7 @@ namespace fve {
 		if (glfwGetKey(window, keys.sprint)) speedModifier = 5.0f;
 
 		if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
-			gameObject.transform.translation += moveSpeed * speedModifier * dt * glm::normalize(moveDir);
+			transform.translation += moveSpeed * speedModifier * dt * glm::normalize(moveDir);
 		}
 
 		// FOV changes?
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "fve_game_object.hpp"
+#include "fve_components.hpp"
 #include "fve_window.hpp"
 
 namespace fve {
@@ -35,7 +35,7 @@ namespace fve {
 
 		void update(GLFWwindow* window);
 
-		void moveInPlaneXZ(GLFWwindow* window, float dt, FveGameObject& gameObject);
+		void moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform);
 
 	};
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "culling_system.hpp"
+
+#include "fve_culling.hpp"
+#include "fve_job_system.hpp"
+
+#include <atomic>
+
+namespace fve {
+
+	// chunks smaller than this are culled inline, splitting them would cost more than the test
+	static constexpr size_t CULL_GRAIN = 4096;
+
+	// the kernels walk the components with float strides
+	static_assert(sizeof(BoundsComponent) % sizeof(float) == 0, "BoundsComponent must be a whole number of floats");
+	static_assert(sizeof(TransformComponent) % sizeof(float) == 0, "TransformComponent must be a whole number of floats");
+
+	void CullingSystem::update(FveWorld& world, const FveCamera& camera) {
+
+		frustum = Frustum::fromMatrix(camera.getProjection() * camera.getView());
+		std::atomic<uint32_t> visibleCount{ 0 };
+		std::atomic<uint32_t> culledCount{ 0 };
+
+		auto models = world.query<BoundsComponent>(Exclude<PointLightComponent>{});
+		models.eachChunk([&](size_t count, const Entity*, BoundsComponent* bounds) {
+			fveJobs.parallelFor(0, count, CULL_GRAIN, [&](size_t begin, size_t end) {
+				CullBoxInput input{ &bounds[begin].worldBounds.min.x, &bounds[begin].worldBounds.max.x, sizeof(BoundsComponent) / sizeof(float) };
+				CullOutput output{ &bounds[begin].visible, sizeof(BoundsComponent) };
+
+				size_t visible = cullBoxes(frustum, input, end - begin, output);
+				visibleCount.fetch_add(static_cast<uint32_t>(visible), std::memory_order_relaxed);
+				culledCount.fetch_add(static_cast<uint32_t>(end - begin - visible), std::memory_order_relaxed);
+			});
+		});
+
+		// billboards face the camera, so the sphere around the quad is the tight test
+		auto lights = world.query<TransformComponent, PointLightComponent, BoundsComponent>();
+		lights.eachChunk([&](size_t count, const Entity*, TransformComponent* transforms, PointLightComponent*, BoundsComponent* bounds) {
+			fveJobs.parallelFor(0, count, CULL_GRAIN, [&](size_t begin, size_t end) {
+				CullSphereInput input{ &transforms[begin].translation.x, &transforms[begin].scale.x, sizeof(TransformComponent) / sizeof(float) };
+				CullOutput output{ &bounds[begin].visible, sizeof(BoundsComponent) };
+
+				size_t visible = cullSpheres(frustum, input, end - begin, output);
+				visibleCount.fetch_add(static_cast<uint32_t>(visible), std::memory_order_relaxed);
+				culledCount.fetch_add(static_cast<uint32_t>(end - begin - visible), std::memory_order_relaxed);
+			});
+		});
+
+		stats.visible = visibleCount.load();
+		stats.culled = culledCount.load();
+
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "fve_camera.hpp"
+#include "fve_components.hpp"
+#include "fve_bounds.hpp"
+
+namespace fve {
+
+	struct CullingStats {
+		uint32_t visible = 0;
+		uint32_t culled = 0;
+	};
+
+	// Tests every entity's world bounds against the camera frustum and flags the result in its
+	// BoundsComponent, so the render systems only record what is on screen. Models are tested as
+	// boxes, point light billboards as spheres, both with the batched kernels straight off the
+	// component arrays, large chunks split over fveJobs.
+	class CullingSystem {
+	public:
+
+		// run after the spatial system, before any render system records
+		void update(FveWorld& world, const FveCamera& camera);
+
+		const CullingStats& getStats() const { return stats; }
+		const Frustum& getFrustum() const { return frustum; }
+
+	private:
+		Frustum frustum{};
+		CullingStats stats{};
+	};
+
+}
@@ -0,0 +1,624 @@
+#include "gpu_culling_system.hpp"
+
+#include "fve_assets.hpp"
+#include "fve_bounds.hpp"
+#include "fve_memory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace fve {
+
+	static_assert(sizeof(GpuObject) == 176, "GpuObject must match the std430 layout in the shaders");
+
+	// uniform block of gpu_cull.comp (std140)
+	struct GpuCullParams {
+		glm::vec4 frustumPlanes[6];
+		glm::mat4 occlusionViewProjection;
+		uint32_t objectCount;
+		uint32_t occlusionEnabled;
+		uint32_t depthWidth;
+		uint32_t depthHeight;
+		uint32_t pyramidLevels;
+	};
+
+	struct PyramidPushConstantData {
+		int32_t sourceSize[2];
+		int32_t destinationSize[2];
+	};
+
+	static constexpr uint32_t CULL_GROUP_SIZE = 64;
+	static constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+
+	GpuCullingSystem::GpuCullingSystem(FveDevice& device, uint32_t initialCapacity)
+		: device{ device }, objectCapacity{ std::max(1u, initialCapacity) }, batchCapacity{ 64 } {
+		pyramidSampler = *fveAssets.createSampler(device, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, "depth_pyramid_sampler");
+
+		createDescriptors();
+		createPipelines();
+		createFrameBuffers();
+		writeFrameDescriptors();
+	}
+
+	GpuCullingSystem::~GpuCullingSystem() {
+		destroyDepthPyramid();
+		vkDestroyPipelineLayout(device.device(), cullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device.device(), pyramidPipelineLayout, nullptr);
+	}
+
+	void GpuCullingSystem::createDescriptors() {
+
+		const uint32_t frameCount = FveSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+		descriptorPool = FveDescriptorPool::Builder(device)
+			.setMaxSets(frameCount * 3 + MAX_PYRAMID_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount * 5)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount * 2 + MAX_PYRAMID_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frameCount + MAX_PYRAMID_LEVELS)
+			.build();
+
+		cullSetLayout = FveDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+		objectSetLayout = FveDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+		pyramidSetLayout = FveDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		// sets are allocated once and only ever overwritten
+		for (auto& frame : frames) {
+			if (!descriptorPool->allocateDescriptorSet(cullSetLayout->getDescriptorSetLayout(), frame.cullSet) ||
+				!descriptorPool->allocateDescriptorSet(objectSetLayout->getDescriptorSetLayout(), frame.objectSet) ||
+				!descriptorPool->allocateDescriptorSet(pyramidSetLayout->getDescriptorSetLayout(), frame.depthSet)) {
+				throw std::runtime_error("failed to allocate GPU culling descriptor sets!");
+			}
+		}
+		for (auto& set : pyramidLevelSets) {
+			if (!descriptorPool->allocateDescriptorSet(pyramidSetLayout->getDescriptorSetLayout(), set)) {
+				throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+			}
+		}
+
+	}
+
+	void GpuCullingSystem::createPipelines() {
+
+		VkDescriptorSetLayout cullLayout = cullSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo cullLayoutInfo{};
+		cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		cullLayoutInfo.setLayoutCount = 1;
+		cullLayoutInfo.pSetLayouts = &cullLayout;
+		if (vkCreatePipelineLayout(device.device(), &cullLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkPushConstantRange pushConstantRange;
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PyramidPushConstantData);
+
+		VkDescriptorSetLayout pyramidLayout = pyramidSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pyramidLayoutInfo{};
+		pyramidLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pyramidLayoutInfo.setLayoutCount = 1;
+		pyramidLayoutInfo.pSetLayouts = &pyramidLayout;
+		pyramidLayoutInfo.pushConstantRangeCount = 1;
+		pyramidLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device.device(), &pyramidLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		cullPipeline = std::make_unique<FveComputePipeline>(device, "shaders/gpu_cull.comp.spv", cullPipelineLayout);
+		pyramidPipeline = std::make_unique<FveComputePipeline>(device, "shaders/depth_pyramid.comp.spv", pyramidPipelineLayout);
+
+	}
+
+	void GpuCullingSystem::createFrameBuffers() {
+
+		// starts out undefined, the caller has every row uploaded again
+		objectTable = std::make_unique<FveBuffer>(
+			fveAllocator, device, sizeof(GpuObject), objectCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, "gpuObjectTable");
+
+		for (auto& frame : frames) {
+			frame.params = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(GpuCullParams), 1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+				"gpuCullParams", device.properties.limits.minUniformBufferOffsetAlignment);
+			frame.params->map();
+
+			createStaging(frame, objectCapacity);
+
+			frame.batches = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(uint32_t), batchCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "gpuBatchTable");
+			frame.batches->map();
+
+			// filled by the culling pass, consumed by the indirect draws
+			frame.commands = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(VkDrawIndexedIndirectCommand), objectCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, "gpuDrawCommands");
+			frame.counts = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(uint32_t), batchCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY, "gpuDrawCounts");
+		}
+
+	}
+
+	void GpuCullingSystem::createStaging(FrameResources& frame, uint32_t capacity) {
+		frame.staging = std::make_unique<FveBuffer>(
+			fveAllocator, device, sizeof(GpuObject), capacity,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, "gpuObjectStaging");
+		frame.staging->map();
+		frame.stagingCapacity = capacity;
+	}
+
+	void GpuCullingSystem::writeFrameDescriptors() {
+
+		for (auto& frame : frames) {
+			auto paramsInfo = frame.params->descriptorInfo();
+			auto objectsInfo = objectTable->descriptorInfo();
+			auto batchesInfo = frame.batches->descriptorInfo();
+			auto commandsInfo = frame.commands->descriptorInfo();
+			auto countsInfo = frame.counts->descriptorInfo();
+
+			FveDescriptorWriter cullWriter(*cullSetLayout, *descriptorPool);
+			cullWriter
+				.writeBuffer(0, &paramsInfo)
+				.writeBuffer(1, &objectsInfo)
+				.writeBuffer(2, &batchesInfo)
+				.writeBuffer(3, &commandsInfo)
+				.writeBuffer(4, &countsInfo);
+
+			// the pyramid binding is filled in once the pyramid exists
+			VkDescriptorImageInfo pyramidInfo{};
+			if (pyramidView != VK_NULL_HANDLE) {
+				pyramidInfo.sampler = pyramidSampler;
+				pyramidInfo.imageView = pyramidView;
+				pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+				cullWriter.writeImage(5, &pyramidInfo);
+			}
+			cullWriter.overwrite(frame.cullSet);
+
+			FveDescriptorWriter(*objectSetLayout, *descriptorPool)
+				.writeBuffer(0, &objectsInfo)
+				.overwrite(frame.objectSet);
+		}
+
+	}
+
+	bool GpuCullingSystem::ensureCapacity(size_t objectCount, size_t batchCount) {
+
+		if (objectCount <= objectCapacity && batchCount <= batchCapacity) return false;
+
+		while (objectCapacity < objectCount) objectCapacity *= 2;
+		while (batchCapacity < batchCount) batchCapacity *= 2;
+
+		// the other frame may still be reading the old buffers
+		vkDeviceWaitIdle(device.device());
+		createFrameBuffers();
+		writeFrameDescriptors();
+		return true;
+
+	}
+
+	void GpuCullingSystem::createDepthPyramid(VkExtent2D extent) {
+
+		// every frame in flight samples the pyramid
+		vkDeviceWaitIdle(device.device());
+		destroyDepthPyramid();
+
+		depthExtent = extent;
+		pyramidValid = false;
+
+		VkExtent2D levelExtent = extent;
+		do {
+			levelExtent = { (levelExtent.width + 1) / 2, (levelExtent.height + 1) / 2 };
+			pyramidLevelExtents.push_back(levelExtent);
+		} while ((levelExtent.width > 1 || levelExtent.height > 1) && pyramidLevelExtents.size() < MAX_PYRAMID_LEVELS);
+		uint32_t levelCount = static_cast<uint32_t>(pyramidLevelExtents.size());
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { pyramidLevelExtents[0].width, pyramidLevelExtents[0].height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocCreateInfo{};
+		allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		VmaAllocationInfo allocInfo{};
+		device.createImageWithInfo(imageInfo, allocCreateInfo, pyramidAllocation, allocInfo, pyramidImage);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramidImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		if (vkCreateImageView(device.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid image view!");
+		}
+
+		pyramidLevelViews.resize(levelCount);
+		for (uint32_t level = 0; level < levelCount; level++) {
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			if (vkCreateImageView(device.device(), &viewInfo, nullptr, &pyramidLevelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create depth pyramid image view!");
+			}
+		}
+
+		// the pyramid lives in GENERAL, written as a storage image and sampled by the next pass
+		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramidImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		device.endSingleTimeCommands(commandBuffer);
+
+		for (uint32_t level = 1; level < levelCount; level++) {
+			VkDescriptorImageInfo sourceInfo{ pyramidSampler, pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			FveDescriptorWriter(*pyramidSetLayout, *descriptorPool)
+				.writeImage(0, &sourceInfo)
+				.writeImage(1, &destinationInfo)
+				.overwrite(pyramidLevelSets[level]);
+		}
+
+		writeFrameDescriptors();
+
+	}
+
+	void GpuCullingSystem::destroyDepthPyramid() {
+
+		for (VkImageView view : pyramidLevelViews) {
+			vkDestroyImageView(device.device(), view, nullptr);
+		}
+		pyramidLevelViews.clear();
+		pyramidLevelExtents.clear();
+
+		if (pyramidView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device.device(), pyramidView, nullptr);
+			pyramidView = VK_NULL_HANDLE;
+		}
+		if (pyramidImage != VK_NULL_HANDLE) {
+			vmaDestroyImage(fveAllocator, pyramidImage, pyramidAllocation);
+			pyramidImage = VK_NULL_HANDLE;
+			pyramidAllocation = VK_NULL_HANDLE;
+		}
+
+	}
+
+	void GpuCullingSystem::update(FrameInfo& frameInfo) {
+
+		updateCount++;
+		liveCount = 0;
+		dirtyRows.clear();
+		for (Batch& batch : batches) batch.objectCount = 0;
+
+		auto addObject = [&](Entity entity, GpuDrawList list, WorldTransformComponent& transform, ModelComponent& model, BoundsComponent& bounds) {
+			// skip models whose mesh is still uploading, the indirect path only draws indexed meshes
+			if (model.model == nullptr) return;
+			Mesh& mesh = model.model->getMesh();
+			if (!mesh.resident || !mesh.hasIndexBuffer) return;
+
+			Material* material = model.model->getMaterial().indirect;
+			auto& lookup = batchLookup[static_cast<size_t>(list)];
+			auto [it, inserted] = lookup.try_emplace(BatchKey{ &mesh, material }, static_cast<uint32_t>(batches.size()));
+			if (inserted) {
+				batches.push_back(Batch{ &mesh, material, 0, 0 });
+				auto& listBatch = listBatches[static_cast<size_t>(list)];
+				listBatch.insert(std::upper_bound(listBatch.begin(), listBatch.end(), material,
+					[&](Material* value, uint32_t batch) { return std::less<Material*>{}(value, batches[batch].material); }), it->second);
+			}
+			batches[it->second].objectCount++;
+			liveCount++;
+
+			// rows the table grows by have never been written, they go up empty
+			uint32_t index = entityIndex(entity);
+			if (index >= rows.size()) {
+				for (uint32_t added = static_cast<uint32_t>(rows.size()); added < index; added++) dirtyRows.push_back(added);
+				rows.resize(index + 1);
+				objectData.resize(index + 1);
+			}
+
+			Row& row = rows[index];
+			row.seen = updateCount;
+			GpuObject& object = objectData[index];
+			if (row.entity == entity && row.changedFrame == transform.changedFrame && object.batch == it->second &&
+				object.indexCount == mesh.indexCount && object.firstIndex == mesh.firstIndex && object.vertexOffset == mesh.vertexOffset) {
+				return;
+			}
+
+			// bounds follow the world matrix, the spatial system has synced them by now
+			row.entity = entity;
+			row.changedFrame = transform.changedFrame;
+			object.modelMatrix = transform.matrix;
+			object.normalMatrix = transform.normalMatrix;
+			object.boundsMin = glm::vec4(bounds.worldBounds.min, 1.0f);
+			object.boundsMax = glm::vec4(bounds.worldBounds.max, 1.0f);
+			object.indexCount = mesh.indexCount;
+			object.firstIndex = mesh.firstIndex;
+			object.vertexOffset = mesh.vertexOffset;
+			object.batch = it->second;
+			dirtyRows.push_back(index);
+		};
+
+		// textured objects are drawn by the textured render system
+		auto simple = frameInfo.world.query<WorldTransformComponent, ModelComponent, BoundsComponent>(Exclude<TextureComponent>{});
+		simple.each([&](Entity entity, WorldTransformComponent& transform, ModelComponent& model, BoundsComponent& bounds) {
+			addObject(entity, GpuDrawList::Simple, transform, model, bounds);
+		});
+		auto textured = frameInfo.world.query<WorldTransformComponent, ModelComponent, TextureComponent, BoundsComponent>();
+		textured.each([&](Entity entity, WorldTransformComponent& transform, ModelComponent& model, TextureComponent&, BoundsComponent& bounds) {
+			addObject(entity, GpuDrawList::Textured, transform, model, bounds);
+		});
+
+		// destroyed or no longer drawn, an empty row has no indices and is skipped by the culling pass
+		rowCount = 0;
+		for (uint32_t index = 0; index < rows.size(); index++) {
+			Row& row = rows[index];
+			if (row.entity == NULL_ENTITY) continue;
+			if (row.seen != updateCount) {
+				row = Row{};
+				objectData[index] = GpuObject{};
+				dirtyRows.push_back(index);
+				continue;
+			}
+			rowCount = index + 1;
+		}
+
+		// every batch gets a slice of the command buffer big enough for all of its objects
+		commandOffsets.resize(batches.size());
+		uint32_t commandOffset = 0;
+		stats.batches = 0;
+		for (size_t i = 0; i < batches.size(); i++) {
+			batches[i].commandOffset = commandOffset;
+			commandOffsets[i] = commandOffset;
+			commandOffset += batches[i].objectCount;
+			if (batches[i].objectCount > 0) stats.batches++;
+		}
+
+		// a row the table grew by may have been taken by a later entity
+		std::sort(dirtyRows.begin(), dirtyRows.end());
+		dirtyRows.erase(std::unique(dirtyRows.begin(), dirtyRows.end()), dirtyRows.end());
+
+		stats.objects = liveCount;
+
+	}
+
+	void GpuCullingSystem::stageRows(FrameResources& frame) {
+
+		copies.clear();
+		if (dirtyRows.empty()) return;
+
+		// the frame's fence has been waited on, nothing reads its staging buffer anymore
+		if (dirtyRows.size() > frame.stagingCapacity) {
+			uint32_t capacity = std::max(1u, frame.stagingCapacity);
+			while (capacity < dirtyRows.size()) capacity *= 2;
+			createStaging(frame, capacity);
+		}
+
+		// consecutive rows go up as one copy
+		VkDeviceSize stagingOffset = 0;
+		for (size_t first = 0; first < dirtyRows.size();) {
+			size_t last = first + 1;
+			while (last < dirtyRows.size() && dirtyRows[last] == dirtyRows[last - 1] + 1) last++;
+
+			VkDeviceSize size = (last - first) * sizeof(GpuObject);
+			frame.staging->writeToBuffer(&objectData[dirtyRows[first]], size, stagingOffset);
+			copies.push_back(VkBufferCopy{ stagingOffset, dirtyRows[first] * sizeof(GpuObject), size });
+			stagingOffset += size;
+			first = last;
+		}
+		frame.staging->flush();
+
+	}
+
+	void GpuCullingSystem::recordCulling(FrameInfo& frameInfo, VkExtent2D extent) {
+
+		if (extent.width != depthExtent.width || extent.height != depthExtent.height) {
+			createDepthPyramid(extent);
+		}
+
+		// nothing this frame has recorded uses the buffers yet, so waiting for the GPU here is safe;
+		// a new table has to be filled from scratch
+		if (ensureCapacity(rows.size(), batches.size())) {
+			dirtyRows.resize(rows.size());
+			std::iota(dirtyRows.begin(), dirtyRows.end(), 0u);
+		}
+		stats.uploads = static_cast<uint32_t>(dirtyRows.size());
+
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		stageRows(frame);
+		dirtyRows.clear();
+		if (!batches.empty()) {
+			frame.batches->writeToBuffer(commandOffsets.data(), commandOffsets.size() * sizeof(uint32_t));
+			frame.batches->flush();
+		}
+
+		// cleared rows go up even with nothing left to draw, a later frame may walk over them again
+		if (!copies.empty()) {
+			// last frame's culling pass and draws are done reading the rows about to be overwritten
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 0, nullptr);
+			vkCmdCopyBuffer(commandBuffer, frame.staging->getAllocatedBuffer().buffer, objectTable->getAllocatedBuffer().buffer,
+				static_cast<uint32_t>(copies.size()), copies.data());
+			copies.clear();
+		}
+
+		if (rowCount == 0) return;
+
+		Frustum frustum = Frustum::fromMatrix(frameInfo.camera.getProjection() * frameInfo.camera.getView());
+
+		GpuCullParams params{};
+		std::copy(frustum.planes.begin(), frustum.planes.end(), params.frustumPlanes);
+		params.occlusionViewProjection = pyramidViewProjection;
+		params.objectCount = rowCount;
+		params.occlusionEnabled = pyramidValid ? 1 : 0;
+		params.depthWidth = depthExtent.width;
+		params.depthHeight = depthExtent.height;
+		params.pyramidLevels = static_cast<uint32_t>(pyramidLevelExtents.size());
+		frame.params->writeToBuffer(&params, sizeof(GpuCullParams));
+		frame.params->flush();
+
+		vkCmdFillBuffer(commandBuffer, frame.counts->getAllocatedBuffer().buffer, 0, batches.size() * sizeof(uint32_t), 0);
+
+		// uploaded rows, cleared counts, and last frame's pyramid writes, before the culling pass and
+		// the draws read them
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (params.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		// the draws read the compacted commands and counts
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	}
+
+	void GpuCullingSystem::drawBatches(FrameInfo& frameInfo, GpuDrawList list, const Material& fallback) {
+
+		const auto& listBatch = listBatches[static_cast<size_t>(list)];
+		if (listBatch.empty()) return;
+
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, fallback.pipelineLayout, 1, 1, &frame.objectSet, 0, nullptr);
+
+		VkBuffer commands = frame.commands->getAllocatedBuffer().buffer;
+		VkBuffer counts = frame.counts->getAllocatedBuffer().buffer;
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+		for (uint32_t batchIndex : listBatch) {
+			// its mesh may be gone
+			const Batch& batch = batches[batchIndex];
+			if (batch.objectCount == 0) continue;
+
+			// the sets stay bound across pipelines with compatible layouts
+			VkPipeline pipeline = batch.material != nullptr ? batch.material->pipeline : fallback.pipeline;
+			if (pipeline != boundPipeline) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+			}
+
+			// meshes in the arena share their buffers, only bind when they change
+			VkBuffer vertexBuffer = batch.mesh->getVertexBuffer();
+			if (vertexBuffer != boundVertexBuffer) {
+				VkDeviceSize offsets[] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, batch.mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+				boundVertexBuffer = vertexBuffer;
+			}
+
+			vkCmdDrawIndexedIndirectCount(commandBuffer,
+				commands, batch.commandOffset * sizeof(VkDrawIndexedIndirectCommand),
+				counts, batchIndex * sizeof(uint32_t),
+				batch.objectCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+
+	}
+
+	void GpuCullingSystem::recordDepthPyramid(FrameInfo& frameInfo, VkImageView depthView) {
+
+		assert(pyramidImage != VK_NULL_HANDLE && "Cannot build the depth pyramid before culling created it");
+
+		FrameResources& frame = frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		// the swap chain image changes every frame, so the first level's source does too
+		VkDescriptorImageInfo depthInfo{ pyramidSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, pyramidLevelViews[0], VK_IMAGE_LAYOUT_GENERAL };
+		FveDescriptorWriter(*pyramidSetLayout, *descriptorPool)
+			.writeImage(0, &depthInfo)
+			.writeImage(1, &destinationInfo)
+			.overwrite(frame.depthSet);
+
+		// this frame's culling pass must be done reading the pyramid before it is overwritten
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		pyramidPipeline->bind(commandBuffer);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		VkExtent2D sourceExtent = depthExtent;
+		for (size_t level = 0; level < pyramidLevelExtents.size(); level++) {
+			VkExtent2D destinationExtent = pyramidLevelExtents[level];
+			VkDescriptorSet set = level == 0 ? frame.depthSet : pyramidLevelSets[level];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &set, 0, nullptr);
+
+			PyramidPushConstantData push{
+				{ int32_t(sourceExtent.width), int32_t(sourceExtent.height) },
+				{ int32_t(destinationExtent.width), int32_t(destinationExtent.height) } };
+			vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidPushConstantData), &push);
+			vkCmdDispatch(commandBuffer,
+				(destinationExtent.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				(destinationExtent.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+			// the next level reads this one; the last is picked up by next frame's culling barrier
+			if (level + 1 < pyramidLevelExtents.size()) {
+				vkCmdPipelineBarrier(commandBuffer,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					0, 1, &barrier, 0, nullptr, 0, nullptr);
+			}
+			sourceExtent = destinationExtent;
+		}
+
+		pyramidViewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+		pyramidValid = true;
+
+	}
+
+}
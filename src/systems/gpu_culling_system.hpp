@@ -0,0 +1,193 @@
+#pragma once
+
+#include "fve_device.hpp"
+#include "fve_buffer.hpp"
+#include "fve_components.hpp"
+#include "fve_descriptors.hpp"
+#include "fve_pipeline.hpp"
+#include "fve_frame_info.hpp"
+#include "fve_swap_chain.hpp"
+#include "fve_utils.hpp"
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace fve {
+
+	// which render system draws a batch
+	enum class GpuDrawList : uint32_t { Simple, Textured, Count };
+
+	// one row of the object table, laid out like GpuObject in the shaders (std430)
+	struct GpuObject {
+		glm::mat4 modelMatrix{ 1.0f };
+		glm::mat4 normalMatrix{ 1.0f };
+		glm::vec4 boundsMin{};
+		glm::vec4 boundsMax{};
+		uint32_t indexCount = 0;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		uint32_t batch = 0;
+	};
+
+	struct GpuCullingStats {
+		uint32_t objects = 0;
+		uint32_t batches = 0;
+		// object table rows copied to the GPU this frame
+		uint32_t uploads = 0;
+	};
+
+	// GPU driven culling. Every model owns the row of a device local object table at its entity
+	// index, holding its world matrices, bounds and mesh range. A row is only rewritten when its
+	// transform, mesh or batch changed, through this frame's staging buffer, so static objects cost
+	// no upload at all. Objects are grouped into one batch per mesh, material and render system. A
+	// compute pass tests each object against the frustum and against a max depth pyramid of the
+	// previous frame, and appends the survivors to their batch's slice of an indirect command
+	// buffer. The render systems then issue one vkCmdDrawIndexedIndirectCount per batch, so
+	// recording costs the same however many objects there are. The pyramid is rebuilt from the
+	// depth buffer after the main pass.
+	class GpuCullingSystem {
+	public:
+
+		GpuCullingSystem(FveDevice& device, uint32_t initialCapacity = 1024);
+		~GpuCullingSystem();
+
+		GpuCullingSystem(const GpuCullingSystem&) = delete;
+		GpuCullingSystem& operator=(const GpuCullingSystem&) = delete;
+
+		static bool isSupported(FveDevice& device) { return device.supportsIndirectCount(); }
+
+		// works out which object table rows changed and this frame's batches; touches no GPU
+		// resources, so it can run on any thread
+		void update(FrameInfo& frameInfo);
+
+		// grows the buffers if the table outgrew them, uploads the changed rows and records the culling
+		// dispatch; on the main thread, outside of the render pass, before anything else uses the buffers
+		void recordCulling(FrameInfo& frameInfo, VkExtent2D extent);
+
+		// Records one indirect draw per batch of the list, bound to the indirect variant of its models'
+		// material, or to fallback if the material has none. Every one of those layouts must match
+		// fallback's for sets 0 and 1; set 0 must already be bound, the object table goes in set 1.
+		void drawBatches(FrameInfo& frameInfo, GpuDrawList list, const Material& fallback);
+
+		// records the depth pyramid build from this frame's depth, after the render pass
+		void recordDepthPyramid(FrameInfo& frameInfo, VkImageView depthView);
+
+		VkDescriptorSetLayout getObjectSetLayout() const { return objectSetLayout->getDescriptorSetLayout(); }
+		const GpuCullingStats& getStats() const { return stats; }
+
+	private:
+		static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+		struct Batch {
+			Mesh* mesh;
+			// indirect variant of the models' material, null for the list's fallback
+			Material* material;
+			uint32_t objectCount;
+			uint32_t commandOffset;
+		};
+
+		struct BatchKey {
+			Mesh* mesh;
+			Material* material;
+			bool operator==(const BatchKey& other) const { return mesh == other.mesh && material == other.material; }
+		};
+
+		struct BatchKeyHash {
+			size_t operator()(const BatchKey& key) const {
+				size_t seed = 0;
+				hashCombine(seed, key.mesh, key.material);
+				return seed;
+			}
+		};
+
+		// what the CPU last wrote into a row of the object table
+		struct Row {
+			Entity entity = NULL_ENTITY;
+			uint64_t changedFrame = 0;
+			// last update() that drew the entity, rows left behind are cleared
+			uint64_t seen = 0;
+		};
+
+		struct FrameResources {
+			std::unique_ptr<FveBuffer> params;
+			// changed rows, copied into the object table before the culling pass
+			std::unique_ptr<FveBuffer> staging;
+			uint32_t stagingCapacity = 0;
+			std::unique_ptr<FveBuffer> batches;
+			std::unique_ptr<FveBuffer> commands;
+			std::unique_ptr<FveBuffer> counts;
+			VkDescriptorSet cullSet;
+			VkDescriptorSet objectSet;
+			VkDescriptorSet depthSet;
+		};
+
+		void createDescriptors();
+		void createPipelines();
+		void createFrameBuffers();
+		void createStaging(FrameResources& frame, uint32_t capacity);
+		void writeFrameDescriptors();
+		bool ensureCapacity(size_t objectCount, size_t batchCount);
+		void stageRows(FrameResources& frame);
+		void createDepthPyramid(VkExtent2D extent);
+		void destroyDepthPyramid();
+
+		FveDevice& device;
+
+		std::unique_ptr<FveDescriptorPool> descriptorPool;
+		std::unique_ptr<FveDescriptorSetLayout> cullSetLayout;
+		std::unique_ptr<FveDescriptorSetLayout> objectSetLayout;
+		std::unique_ptr<FveDescriptorSetLayout> pyramidSetLayout;
+
+		VkPipelineLayout cullPipelineLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		std::unique_ptr<FveComputePipeline> cullPipeline;
+		std::unique_ptr<FveComputePipeline> pyramidPipeline;
+
+		std::array<FrameResources, FveSwapChain::MAX_FRAMES_IN_FLIGHT> frames{};
+		uint32_t objectCapacity;
+		uint32_t batchCapacity;
+
+		// device local, shared by every frame in flight since frames execute in submission order
+		std::unique_ptr<FveBuffer> objectTable;
+
+		// CPU copy of the object table; every row has reached the GPU or is in dirtyRows
+		std::vector<GpuObject> objectData;
+		std::vector<Row> rows;
+		std::vector<uint32_t> dirtyRows;
+		// one past the last live row, what the culling pass walks
+		uint32_t rowCount = 0;
+		uint32_t liveCount = 0;
+		uint64_t updateCount = 0;
+
+		// this frame's uploads, reused to avoid reallocating
+		std::vector<VkBufferCopy> copies;
+
+		// batches are kept when they run empty so the batch index in a row stays valid, their
+		// object counts and command offsets are redone every frame
+		std::vector<uint32_t> commandOffsets;
+		std::vector<Batch> batches;
+		// each list's batches ordered by material, so pipeline binds only change between runs
+		std::array<std::vector<uint32_t>, static_cast<size_t>(GpuDrawList::Count)> listBatches;
+		std::array<std::unordered_map<BatchKey, uint32_t, BatchKeyHash>, static_cast<size_t>(GpuDrawList::Count)> batchLookup;
+
+		// max depth pyramid, level 0 is half the depth buffer's size
+		VkImage pyramidImage = VK_NULL_HANDLE;
+		VmaAllocation pyramidAllocation = VK_NULL_HANDLE;
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		std::vector<VkExtent2D> pyramidLevelExtents;
+		// level n reads level n - 1, level 0 reads the depth buffer through FrameResources::depthSet
+		std::array<VkDescriptorSet, MAX_PYRAMID_LEVELS> pyramidLevelSets{};
+		VkSampler pyramidSampler;
+		VkExtent2D depthExtent{ 0, 0 };
+
+		// the camera the pyramid was rendered from, occlusion is tested in that view
+		glm::mat4 pyramidViewProjection{ 1.0f };
+		bool pyramidValid = false;
+
+		GpuCullingStats stats{};
+	};
+
+}
@@ -0,0 +1,109 @@
+#include "occlusion_system.hpp"
+
+#include <iostream>
+#include <random>
+
+namespace fve {
+
+	OcclusionSystem::OcclusionSystem(uint32_t width, uint32_t height) : buffer{ width, height } {}
+
+	void OcclusionSystem::update(FveWorld& world, const FveCamera& camera) {
+
+		glm::mat4 viewProjection = camera.getProjection() * camera.getView();
+		stats = OcclusionStats{};
+
+		buffer.clear();
+
+		auto occluders = world.query<OccluderComponent, WorldTransformComponent, ModelComponent, BoundsComponent>();
+		occluders.each([&](Entity, OccluderComponent&, WorldTransformComponent& transform, ModelComponent& model, BoundsComponent& bounds) {
+			if (model.model == nullptr || !bounds.visible) return;
+
+			const Mesh& mesh = model.model->getMesh();
+			if (mesh.cpuPositions.empty()) return;
+			buffer.addOccluder(viewProjection * transform.matrix, mesh.cpuPositions, mesh.cpuIndices);
+			stats.occluders++;
+		});
+		stats.triangles = static_cast<uint32_t>(buffer.getTriangleCount());
+
+		// nothing drawn, nothing can be hidden
+		if (stats.triangles == 0) return;
+
+		buffer.rasterize(&fveJobs);
+
+		auto occludees = world.query<BoundsComponent>(Exclude<OccluderComponent>{});
+		occludees.each([&](Entity, BoundsComponent& bounds) {
+			if (!bounds.visible) return;
+
+			stats.tested++;
+			if (buffer.isOccluded(bounds.worldBounds, viewProjection)) {
+				bounds.visible = false;
+				stats.occluded++;
+			}
+		});
+
+	}
+
+	bool OcclusionSystem::validate() {
+
+		bool valid = true;
+
+		FveCamera camera;
+		camera.setPerspectiveProjection(glm::radians(90.0f), 2.0f, 0.1f, 100.0f);
+		camera.setViewDirection(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 viewProjection = camera.getProjection() * camera.getView();
+
+		// a 4x4 wall five units in front of the camera
+		std::vector<glm::vec3> wall{ { -2.0f, -2.0f, 5.0f }, { 2.0f, -2.0f, 5.0f }, { 2.0f, 2.0f, 5.0f }, { -2.0f, 2.0f, 5.0f } };
+		std::vector<uint32_t> wallIndices{ 0, 1, 2, 0, 2, 3 };
+
+		FveOcclusionBuffer occlusionBuffer{ 256, 128 };
+		occlusionBuffer.clear();
+		occlusionBuffer.addOccluder(viewProjection, wall, wallIndices);
+		occlusionBuffer.rasterize(nullptr);
+
+		struct Case {
+			const char* name;
+			Aabb bounds;
+			bool occluded;
+		};
+		const Case cases[] = {
+			{ "box behind the wall", Aabb{ { -0.5f, -0.5f, 20.0f }, { 0.5f, 0.5f, 21.0f } }, true },
+			{ "box in front of the wall", Aabb{ { -0.5f, -0.5f, 2.0f }, { 0.5f, 0.5f, 3.0f } }, false },
+			{ "box beside the wall", Aabb{ { 5.5f, -0.5f, 10.0f }, { 6.5f, 0.5f, 11.0f } }, false },
+			{ "box poking through the wall", Aabb{ { -0.5f, -0.5f, 4.0f }, { 0.5f, 0.5f, 6.0f } }, false },
+			{ "box around the camera", Aabb{ { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } }, false },
+		};
+		for (const Case& test : cases) {
+			if (occlusionBuffer.isOccluded(test.bounds, viewProjection) != test.occluded) {
+				std::cerr << "Occlusion self test: " << test.name << " should be " << (test.occluded ? "occluded" : "visible") << std::endl;
+				valid = false;
+			}
+		}
+
+		// random triangles, some crossing the near plane, must rasterize identically on both paths
+		std::mt19937 rng{ 1234 };
+		std::uniform_real_distribution<float> lateral{ -20.0f, 20.0f };
+		std::uniform_real_distribution<float> depth{ -2.0f, 60.0f };
+		std::vector<glm::vec3> triangles(300);
+		for (glm::vec3& vertex : triangles) {
+			vertex = { lateral(rng), lateral(rng), depth(rng) };
+		}
+
+		FveOcclusionBuffer simd{ 256, 128 };
+		FveOcclusionBuffer scalar{ 256, 128 };
+		scalar.setForceScalar(true);
+		for (FveOcclusionBuffer* target : { &simd, &scalar }) {
+			target->clear();
+			target->addOccluder(viewProjection, triangles, {});
+			target->rasterize(nullptr);
+		}
+		if (simd.getDepth() != scalar.getDepth()) {
+			std::cerr << "Occlusion self test: SIMD and scalar rasterizers disagree" << std::endl;
+			valid = false;
+		}
+
+		return valid;
+
+	}
+
+}
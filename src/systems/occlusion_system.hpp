@@ -0,0 +1,45 @@
+#pragma once
+
+#include "fve_camera.hpp"
+#include "fve_components.hpp"
+#include "fve_occlusion_buffer.hpp"
+#include "fve_job_system.hpp"
+
+namespace fve {
+
+	struct OcclusionStats {
+		uint32_t occluders = 0;
+		uint32_t triangles = 0;
+		uint32_t tested = 0;
+		uint32_t occluded = 0;
+	};
+
+	// Software occlusion culling. Every frame the visible entities with an OccluderComponent, whose
+	// meshes were registered with FveAssets::keepOccluderGeometry, are rasterized into a small depth
+	// buffer on the CPU, then the screen space bounds of everything else still flagged visible are
+	// tested against its depth pyramid; hidden ones are flagged invisible before the render systems
+	// record.
+	class OcclusionSystem {
+	public:
+
+		OcclusionSystem(uint32_t width = 256, uint32_t height = 128);
+
+		OcclusionSystem(const OcclusionSystem&) = delete;
+		OcclusionSystem& operator=(const OcclusionSystem&) = delete;
+
+		// run after the culling system
+		void update(FveWorld& world, const FveCamera& camera);
+
+		const OcclusionStats& getStats() const { return stats; }
+		const FveOcclusionBuffer& getBuffer() const { return buffer; }
+
+		// checks known occluded/visible cases and that the SIMD rasterizer matches the scalar one;
+		// needs no window or device, FveEngine --test-occlusion runs it
+		static bool validate();
+
+	private:
+		FveOcclusionBuffer buffer;
+		OcclusionStats stats{};
+	};
+
+}
@@ -1,5 +1,7 @@
 #include "point_light_system.hpp"
 
+#include "fve_memory.hpp"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -9,17 +11,17 @@
 #include <stdexcept>
 #include <array>
 #include <cassert>
-#include <map>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <random>
 
 namespace fve {
 
-	struct PointLightPushConstants {
-		glm::vec4 position{};
-		glm::vec4 color{};
-		float radius;
-	};
+	static constexpr uint32_t LIGHT_BINDING = 0;
 
 	PointLightSystem::PointLightSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device{ device } {
+		instanceCapacities.fill(64);
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
@@ -29,19 +31,14 @@ namespace fve {
 	}
 
 	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(PointLightPushConstants);
-
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
@@ -54,8 +51,12 @@ namespace fve {
 		PipelineConfigInfo pipelineConfig{};
 		FvePipeline::defaultPipelineConfigInfo(pipelineConfig);
 		FvePipeline::enableAlphaBlending(pipelineConfig);
+		// no mesh, the quad's corners come from gl_VertexIndex and each light is an instance
 		pipelineConfig.bindingDescriptions.clear();
 		pipelineConfig.attributeDescriptions.clear();
+		pipelineConfig.bindingDescriptions.push_back({ LIGHT_BINDING, sizeof(LightInstance), VK_VERTEX_INPUT_RATE_INSTANCE });
+		pipelineConfig.attributeDescriptions.push_back({ 0, LIGHT_BINDING, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(LightInstance, position)) });
+		pipelineConfig.attributeDescriptions.push_back({ 1, LIGHT_BINDING, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(LightInstance, color)) });
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
 		pipeline = std::make_unique<FvePipeline>(
@@ -66,45 +67,162 @@ namespace fve {
 			"pointlightmaterial");
 	}
 
-	void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
+	// where to draw the light this frame, blended between simulation steps when it is interpolated
+	static glm::vec3 renderPosition(FveWorld& world, Entity entity, const TransformComponent& transform, float alpha) {
+		const InterpolationComponent* interpolation = world.tryGetComponent<InterpolationComponent>(entity);
+		if (interpolation == nullptr) return transform.translation;
+		return glm::mix(interpolation->previous.translation, transform.translation, alpha);
+	}
+
+	void PointLightSystem::update(FveWorld& world, float dt) {
+
+		auto rotateLight = glm::rotate(glm::mat4(1.0f), dt, { 0.0f, -1.0f, 0.0f });
+
+		auto query = world.query<TransformComponent, PointLightComponent>();
+		query.each([&](Entity entity, TransformComponent& transform, PointLightComponent&) {
+			transform.setTranslation(glm::vec3(rotateLight * glm::vec4(transform.translation, 1.0f)));
+		});
+
+	}
+
+	// non negative floats order like their bits; the index in the low half breaks ties, so the same
+	// lights win every frame
+	static uint64_t distanceKey(float distanceSquared, uint32_t index) {
+		uint32_t distanceBits;
+		std::memcpy(&distanceBits, &distanceSquared, sizeof(distanceBits));
+		return (uint64_t{ distanceBits } << 32) | index;
+	}
+
+	void PointLightSystem::selectNearest(std::vector<FveRenderQueue::DrawItem>& items, size_t limit) {
 
-		auto rotateLight = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, { 0.0f, -1.0f, 0.0f });
+		auto byKey = [](const FveRenderQueue::DrawItem& a, const FveRenderQueue::DrawItem& b) { return a.key < b.key; };
+		if (items.size() > limit) {
+			std::nth_element(items.begin(), items.begin() + limit, items.end(), byKey);
+			items.resize(limit);
+		}
+		std::sort(items.begin(), items.end(), byKey);
+
+	}
 
-		int lightIndex = 0;
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
+	void PointLightSystem::writeUniforms(FrameInfo& frameInfo, GlobalUbo& ubo) {
 
-			assert(lightIndex < MAX_LIGHTS && "Too many point lights!");
+		uniformLights.clear();
+		uniformItems.clear();
 
-			// update light position
-			obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.0f));
+		glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+		auto query = frameInfo.world.query<TransformComponent, ColorComponent, PointLightComponent>();
+		query.each([&](Entity entity, TransformComponent& transform, ColorComponent& color, PointLightComponent& pointLight) {
+			glm::vec3 position = renderPosition(frameInfo.world, entity, transform, frameInfo.alpha);
+			glm::vec3 offset = cameraPosition - position;
 
-			// copy light to ubo
-			ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
-			ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			lightIndex++;
+			uint32_t index = static_cast<uint32_t>(uniformLights.size());
+			uniformItems.push_back(FveRenderQueue::DrawItem{ distanceKey(glm::dot(offset, offset), index), index });
+			uniformLights.push_back(PointLight{ glm::vec4(position, 1.0f), glm::vec4(color.color, pointLight.lightIntensity) });
+		});
+
+		// the uniforms hold MAX_LIGHTS, the nearest lights matter most
+		selectNearest(uniformItems, MAX_LIGHTS);
+		for (size_t i = 0; i < uniformItems.size(); i++) {
+			ubo.pointLights[i] = uniformLights[uniformItems[i].index];
 		}
-		ubo.numLights = lightIndex;
+		ubo.numLights = static_cast<int>(uniformItems.size());
+
+	}
+
+	bool PointLightSystem::validate() {
+
+		std::mt19937 rng{ 7 };
+		std::uniform_real_distribution<float> coordinate{ -50.0f, 50.0f };
+		bool valid = true;
+
+		for (size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ MAX_LIGHTS }, size_t{ MAX_LIGHTS + 1 }, size_t{ 5000 } }) {
+			for (int tied = 0; tied < 2; tied++) {
+				std::vector<float> distances(count);
+				std::vector<FveRenderQueue::DrawItem> items(count);
+				for (size_t i = 0; i < count; i++) {
+					// a ring of decorative lights all at the same distance, or a random scatter
+					glm::vec3 offset = tied == 1 ? glm::vec3{ 10.0f, 0.0f, 0.0f } : glm::vec3{ coordinate(rng), coordinate(rng), coordinate(rng) };
+					distances[i] = glm::dot(offset, offset);
+					items[i] = FveRenderQueue::DrawItem{ distanceKey(distances[i], static_cast<uint32_t>(i)), static_cast<uint32_t>(i) };
+				}
+
+				std::vector<uint32_t> expected(count);
+				for (size_t i = 0; i < count; i++) expected[i] = static_cast<uint32_t>(i);
+				std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return distances[a] < distances[b]; });
+				expected.resize(std::min(count, size_t{ MAX_LIGHTS }));
+
+				selectNearest(items, MAX_LIGHTS);
+
+				bool same = std::equal(items.begin(), items.end(), expected.begin(), expected.end(),
+					[](const FveRenderQueue::DrawItem& item, uint32_t index) { return item.index == index; });
+				if (!same) {
+					std::cerr << "Nearest light selection mismatch for " << count << (tied == 1 ? " tied" : " random") << " lights" << std::endl;
+					valid = false;
+				}
+			}
+		}
+
+		return valid;
+
+	}
+
+	PointLightSystem::LightInstance* PointLightSystem::mapInstances(int frameIndex, uint32_t count) {
+
+		// this frame's buffer was last read by the GPU before its fence was waited on
+		uint32_t& capacity = instanceCapacities[frameIndex];
+		std::unique_ptr<FveBuffer>& buffer = instanceBuffers[frameIndex];
+		if (buffer == nullptr || count > capacity) {
+			while (capacity < count) capacity *= 2;
+			buffer = std::make_unique<FveBuffer>(
+				fveAllocator, device, sizeof(LightInstance), capacity,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, "pointLightInstances");
+			buffer->map();
+		}
+		return static_cast<LightInstance*>(buffer->getMappedMemory());
 
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo) {
-		// sort lights
-		std::map<float, FveGameObject::id_t> sorted;
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
-
-			// calculate distance
-			auto offset = frameInfo.camera.getPosition() - obj.transform.translation;
-			float distSquared = glm::dot(offset, offset);
-			sorted[distSquared] = obj.getId();
+
+		lights.clear();
+		items.clear();
+
+		glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+		auto query = frameInfo.world.query<TransformComponent, ColorComponent, PointLightComponent, BoundsComponent>();
+		query.each([&](Entity entity, TransformComponent& transform, ColorComponent& color, PointLightComponent& pointLight, BoundsComponent& bounds) {
+
+			// culled lights still light the scene, only the billboard is skipped
+			if (!bounds.visible) return;
+
+			glm::vec3 position = renderPosition(frameInfo.world, entity, transform, frameInfo.alpha);
+			glm::vec3 offset = cameraPosition - position;
+			float distanceSquared = glm::dot(offset, offset);
+
+			// non negative floats order like their bits, inverted so the farthest light blends first
+			uint32_t depthBits;
+			std::memcpy(&depthBits, &distanceSquared, sizeof(depthBits));
+			items.push_back(FveRenderQueue::DrawItem{ ~depthBits, static_cast<uint32_t>(lights.size()) });
+			lights.push_back(LightInstance{ glm::vec4(position, transform.scale.x), glm::vec4(color.color, pointLight.lightIntensity) });
+		});
+		if (items.empty()) return;
+
+		// stable, lights at equal distances are all kept
+		FveRenderQueue::radixSort(items, scratch);
+
+		uint32_t count = static_cast<uint32_t>(items.size());
+		LightInstance* instances = mapInstances(frameInfo.frameIndex, count);
+		for (uint32_t i = 0; i < count; i++) {
+			instances[i] = lights[items[i].index];
 		}
+		instanceBuffers[frameInfo.frameIndex]->flush(count * sizeof(LightInstance));
 
-		pipeline->bind(frameInfo.commandBuffer);
+		// a secondary of its own, after the geometry the billboards blend over
+		VkCommandBuffer commandBuffer = frameInfo.commands.begin(frameInfo.commands.reserve(1));
+		if (commandBuffer == VK_NULL_HANDLE) return;
 
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+		pipeline->bind(commandBuffer);
+
+		vkCmdBindDescriptorSets(commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
 			0,
@@ -113,26 +231,14 @@ namespace fve {
 			0,
 			nullptr);
 
-		// iterate through sorted map in reverse order
-		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
-			// use object id to find the light
-			auto& obj = frameInfo.gameObjects.at(it->second);
-
-			PointLightPushConstants push{};
-			push.position = glm::vec4(obj.transform.translation, 1.0f);
-			push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			push.radius = obj.transform.scale.x;
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(PointLightPushConstants),
-				&push
-			);
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-		}
+		VkBuffer vertexBuffers[] = { instanceBuffers[frameInfo.frameIndex]->getAllocatedBuffer().buffer };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, LIGHT_BINDING, 1, vertexBuffers, offsets);
+
+		// six corners per billboard, one instance per light
+		vkCmdDraw(commandBuffer, 6, count, 0, 0);
+
+		frameInfo.commands.end(commandBuffer);
 	}
 
 }
\ No newline at end of file
@@ -1,37 +1,79 @@
 #pragma once
 
 #include "fve_device.hpp"
-#include "fve_game_object.hpp"
+#include "fve_buffer.hpp"
+#include "fve_components.hpp"
 #include "fve_pipeline.hpp"
 #include "fve_camera.hpp"
 #include "fve_frame_info.hpp"
+#include "fve_render_queue.hpp"
+#include "fve_swap_chain.hpp"
 
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace fve {
 
+	// Moves the point lights, feeds the ones nearest the camera to the uniforms and draws every
+	// billboard. The visible lights are radix sorted back to front and drawn with one instanced draw
+	// that reads them from a per-frame vertex buffer; every buffer is reused, so a frame allocates
+	// nothing once they have grown to fit.
 	class PointLightSystem {
 	public:
 
 		PointLightSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
-		void update(FrameInfo& frameInfo, GlobalUbo &ubo);
+		// moves the lights by one simulation step
+		void update(FveWorld& world, float dt);
+
+		// copies the MAX_LIGHTS lights nearest the camera, at their interpolated positions, into the
+		// uniforms; the rest only get billboards
+		void writeUniforms(FrameInfo& frameInfo, GlobalUbo& ubo);
 		void render(FrameInfo& frameInfo);
 
+		// nearest light selection against a full sort, with more lights than fit in the uniforms
+		static bool validate();
+
 	private:
+		// per instance vertex data at locations 0 and 1, laid out like the attributes in point_light.vert
+		struct LightInstance {
+			// w is the radius
+			glm::vec4 position;
+			// w is the intensity
+			glm::vec4 color;
+		};
+
 		FveDevice& device;
 
 		std::unique_ptr<FvePipeline> pipeline;
 		VkPipelineLayout pipelineLayout;
 
+		// the visible lights in query order, and their sort keys pointing into them
+		std::vector<LightInstance> lights;
+		std::vector<FveRenderQueue::DrawItem> items;
+		std::vector<FveRenderQueue::DrawItem> scratch;
+
+		// every light in query order, and the keys picking the nearest of them for the uniforms
+		std::vector<PointLight> uniformLights;
+		std::vector<FveRenderQueue::DrawItem> uniformItems;
+
+		std::array<std::unique_ptr<FveBuffer>, FveSwapChain::MAX_FRAMES_IN_FLIGHT> instanceBuffers{};
+		std::array<uint32_t, FveSwapChain::MAX_FRAMES_IN_FLIGHT> instanceCapacities{};
+
 
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+
+		// keeps the limit items with the lowest keys, lowest first
+		static void selectNearest(std::vector<FveRenderQueue::DrawItem>& items, size_t limit);
+
+		// room for count instances in the frame's buffer, grown if needed
+		LightInstance* mapInstances(int frameIndex, uint32_t count);
 	};
 
 }
\ No newline at end of file
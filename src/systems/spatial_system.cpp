@@ -0,0 +1,234 @@
+#include "spatial_system.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+namespace fve {
+
+	static_assert(FveAabbTree::NULL_NODE == FveSpatialGrid::NULL_PROXY, "BoundsComponent uses one null value for both indices");
+
+	SpatialSystem::SpatialSystem(float gridCellSize) : grid{ gridCellSize } {}
+
+	void SpatialSystem::update(FveWorld& world) {
+
+		// components can't be added while iterating, so collect the newcomers first
+		unindexed.clear();
+		world.query<WorldTransformComponent, ModelComponent>(Exclude<BoundsComponent>{}).each(
+			[&](Entity entity, WorldTransformComponent&, ModelComponent&) { unindexed.push_back(entity); });
+		world.query<TransformComponent, PointLightComponent>(Exclude<BoundsComponent>{}).each(
+			[&](Entity entity, TransformComponent&, PointLightComponent&) { unindexed.push_back(entity); });
+
+		for (Entity entity : unindexed) {
+			world.addComponent<BoundsComponent>(entity);
+		}
+
+		bool refitAll = modelBoundsChanged;
+		modelBoundsChanged = false;
+
+		auto models = world.query<WorldTransformComponent, ModelComponent, BoundsComponent>();
+		models.each([&](Entity entity, WorldTransformComponent& transform, ModelComponent& model, BoundsComponent& bounds) {
+			if (model.model == nullptr) return;
+			if (!refitAll && bounds.proxy != FveAabbTree::NULL_NODE && bounds.syncedFrame == transform.changedFrame) return;
+
+			bounds.syncedFrame = transform.changedFrame;
+			sync(entity, bounds, model.model->getMesh().bounds.transformed(transform.matrix));
+		});
+
+		// lights have no world matrix and are few, moving one inside its fat box is just a containment test
+		auto lights = world.query<TransformComponent, PointLightComponent, BoundsComponent>(Exclude<ModelComponent>{});
+		lights.each([&](Entity entity, TransformComponent& transform, PointLightComponent&, BoundsComponent& bounds) {
+			float radius = transform.scale.x;
+			sync(entity, bounds, Aabb{ transform.translation - glm::vec3(radius), transform.translation + glm::vec3(radius) });
+		});
+
+	}
+
+	void SpatialSystem::sync(Entity entity, BoundsComponent& bounds, const Aabb& worldBounds) {
+
+		bounds.worldBounds = worldBounds;
+		if (bounds.index == SpatialIndex::Grid) {
+			if (bounds.proxy == FveSpatialGrid::NULL_PROXY) bounds.proxy = grid.createProxy(worldBounds, entity);
+			else grid.moveProxy(bounds.proxy, worldBounds);
+		}
+		else {
+			if (bounds.proxy == FveAabbTree::NULL_NODE) bounds.proxy = tree.createProxy(worldBounds, entity);
+			else tree.moveProxy(bounds.proxy, worldBounds);
+		}
+
+	}
+
+	void SpatialSystem::destroyEntity(FveWorld& world, Entity entity) {
+
+		BoundsComponent* bounds = world.tryGetComponent<BoundsComponent>(entity);
+		if (bounds != nullptr && bounds->proxy != FveAabbTree::NULL_NODE) {
+			if (bounds->index == SpatialIndex::Grid) grid.destroyProxy(bounds->proxy);
+			else tree.destroyProxy(bounds->proxy);
+		}
+		world.destroyEntity(entity);
+
+	}
+
+	Entity SpatialSystem::raycast(FveWorld& world, const Ray& ray, float* distance) const {
+
+		Entity closest = NULL_ENTITY;
+		float closestDistance = ray.maxDistance;
+
+		// the tree works on fat boxes, confirm against the tight ones
+		auto hitTest = [&](int32_t, uint32_t userData) {
+			Entity entity = static_cast<Entity>(userData);
+			if (!world.isAlive(entity)) return -1.0f;
+			float hit = ray.intersect(world.getComponent<BoundsComponent>(entity).worldBounds, closestDistance);
+			if (hit >= 0.0f && hit < closestDistance) {
+				closest = entity;
+				closestDistance = hit;
+			}
+			return hit;
+		};
+		tree.raycast(ray, hitTest);
+
+		Ray clipped = ray;
+		clipped.maxDistance = closestDistance;
+		grid.raycast(clipped, hitTest);
+
+		if (distance != nullptr) *distance = closestDistance;
+		return closest;
+
+	}
+
+	void SpatialSystem::benchmark(size_t count) {
+
+		const int frames = 10;
+		const int queriesPerFrame = 64;
+
+		// roughly one object per 8 cubic units whatever the count, so the queries see similar densities
+		const float halfWorld = std::cbrt(float(count)) * 1.0f;
+		const float queryHalfSize = 4.0f;
+
+		std::mt19937 rng{ 1234 };
+		std::uniform_real_distribution<float> position{ -halfWorld, halfWorld };
+		std::uniform_real_distribution<float> halfExtent{ 0.1f, 0.5f };
+		std::uniform_real_distribution<float> velocity{ -0.1f, 0.1f };
+
+		// the rescan baseline walks the entities like the renderer did before there was an index
+		FveWorld world;
+		world.reserve<BoundsComponent>(count);
+		std::vector<glm::vec3> velocities(count);
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 center{ position(rng), position(rng), position(rng) };
+			glm::vec3 extent{ halfExtent(rng), halfExtent(rng), halfExtent(rng) };
+			world.createEntity(BoundsComponent{ SpatialIndex::Grid, Aabb{ center - extent, center + extent } });
+			velocities[i] = { velocity(rng), velocity(rng), velocity(rng) };
+		}
+
+		std::vector<Aabb> queries(size_t(frames) * queriesPerFrame);
+		for (Aabb& query : queries) {
+			glm::vec3 center{ position(rng), position(rng), position(rng) };
+			query = Aabb{ center - glm::vec3(queryHalfSize), center + glm::vec3(queryHalfSize) };
+		}
+
+		auto boundsQuery = world.query<BoundsComponent>();
+
+		// every object moves every frame, bouncing off the world edges
+		auto moveAll = [&]() {
+			boundsQuery.each([&](Entity entity, BoundsComponent& bounds) {
+				glm::vec3& v = velocities[entityIndex(entity)];
+				bounds.worldBounds.min += v;
+				bounds.worldBounds.max += v;
+				for (int axis = 0; axis < 3; axis++) {
+					if (bounds.worldBounds.min[axis] < -halfWorld || bounds.worldBounds.max[axis] > halfWorld) v[axis] = -v[axis];
+				}
+			});
+		};
+
+		struct Result {
+			double updateMs = 0.0;
+			double queryMs = 0.0;
+			size_t hits = 0;
+		};
+
+		using Clock = std::chrono::steady_clock;
+		auto milliseconds = [](Clock::duration elapsed) { return std::chrono::duration<double, std::milli>(elapsed).count(); };
+
+		// index is told about every move, then answers the frame's queries; hits are checked against the tight bounds
+		auto run = [&](auto& index, auto&& insert, auto&& move) {
+			Result result;
+			boundsQuery.each([&](Entity entity, BoundsComponent& bounds) { bounds.proxy = insert(bounds.worldBounds, entity); });
+
+			for (int frame = 0; frame < frames; frame++) {
+				moveAll();
+
+				auto start = Clock::now();
+				boundsQuery.each([&](Entity, BoundsComponent& bounds) { move(bounds.proxy, bounds.worldBounds); });
+				result.updateMs += milliseconds(Clock::now() - start);
+
+				start = Clock::now();
+				for (int q = 0; q < queriesPerFrame; q++) {
+					const Aabb& box = queries[size_t(frame) * queriesPerFrame + q];
+					index.query(box, [&](int32_t, uint32_t userData) {
+						if (world.getComponent<BoundsComponent>(userData).worldBounds.overlaps(box)) result.hits++;
+						return true;
+					});
+				}
+				result.queryMs += milliseconds(Clock::now() - start);
+			}
+			return result;
+		};
+
+		auto report = [&](const char* name, const Result& result) {
+			std::cout << "  " << name << ": update " << result.updateMs / frames << " ms, "
+				<< queriesPerFrame << " queries " << result.queryMs / frames << " ms, total "
+				<< (result.updateMs + result.queryMs) / frames << " ms/frame (" << result.hits << " hits)" << std::endl;
+		};
+
+		std::cout << "Spatial benchmark, " << count << " moving objects, " << frames << " frames x " << queriesPerFrame << " box queries" << std::endl;
+
+		// positions are replayed identically for every variant
+		std::vector<glm::vec3> initialVelocities = velocities;
+		std::vector<Aabb> initialBounds;
+		initialBounds.reserve(count);
+		boundsQuery.each([&](Entity, BoundsComponent& bounds) { initialBounds.push_back(bounds.worldBounds); });
+		auto resetScene = [&]() {
+			velocities = initialVelocities;
+			boundsQuery.each([&](Entity entity, BoundsComponent& bounds) { bounds.worldBounds = initialBounds[entityIndex(entity)]; });
+		};
+
+		{
+			Result result;
+			for (int frame = 0; frame < frames; frame++) {
+				moveAll();
+
+				auto start = Clock::now();
+				for (int q = 0; q < queriesPerFrame; q++) {
+					const Aabb& box = queries[size_t(frame) * queriesPerFrame + q];
+					boundsQuery.each([&](Entity, BoundsComponent& bounds) {
+						if (bounds.worldBounds.overlaps(box)) result.hits++;
+					});
+				}
+				result.queryMs += milliseconds(Clock::now() - start);
+			}
+			report("rescan", result);
+		}
+
+		{
+			resetScene();
+			FveSpatialGrid grid{ 2.0f };
+			Result result = run(grid,
+				[&](const Aabb& box, uint32_t userData) { return grid.createProxy(box, userData); },
+				[&](int32_t proxy, const Aabb& box) { grid.moveProxy(proxy, box); });
+			report("grid", result);
+		}
+
+		{
+			resetScene();
+			FveAabbTree tree{ 0.1f };
+			Result result = run(tree,
+				[&](const Aabb& box, uint32_t userData) { return tree.createProxy(box, userData); },
+				[&](int32_t proxy, const Aabb& box) { tree.moveProxy(proxy, box); });
+			report("tree", result);
+		}
+
+	}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "fve_components.hpp"
+#include "fve_aabb_tree.hpp"
+#include "fve_spatial_grid.hpp"
+
+#include <vector>
+
+namespace fve {
+
+	// Keeps every entity with a model or a point light in a spatial index, so renderer, picking and
+	// gameplay can ask what is inside a volume without scanning the world. Entities get a
+	// BoundsComponent the first update after they show up and go into the dynamic AABB tree unless
+	// they were created with SpatialIndex::Grid; only entities whose world matrix was rebuilt since
+	// the last update are refit, or every model after refreshModelBounds.
+	class SpatialSystem {
+	public:
+
+		explicit SpatialSystem(float gridCellSize = 1.0f);
+
+		SpatialSystem(const SpatialSystem&) = delete;
+		SpatialSystem& operator=(const SpatialSystem&) = delete;
+
+		// run after the transform system
+		void update(FveWorld& world);
+
+		// removes the entity's proxy along with the entity, destroy indexed entities through here
+		void destroyEntity(FveWorld& world, Entity entity);
+
+		// mesh bounds changed under existing models (hot reload), refit every model on the next update
+		void refreshModelBounds() { modelBoundsChanged = true; }
+
+		// f(Entity) for every indexed entity whose bounds touch volume (an Aabb, Sphere or Frustum).
+		// tree entities are matched on their fattened bounds; entities destroyed without going
+		// through destroyEntity still have a proxy, they are skipped
+		template<typename Volume, typename F>
+		void query(const FveWorld& world, const Volume& volume, F&& f) const {
+			auto report = [&](int32_t, uint32_t userData) {
+				Entity entity = static_cast<Entity>(userData);
+				if (world.isAlive(entity)) f(entity);
+				return true;
+			};
+			tree.query(volume, report);
+			grid.query(volume, report);
+		}
+
+		// closest entity whose bounds the ray hits, NULL_ENTITY if none
+		Entity raycast(FveWorld& world, const Ray& ray, float* distance = nullptr) const;
+
+		const FveAabbTree& getTree() const { return tree; }
+		const FveSpatialGrid& getGrid() const { return grid; }
+
+		// moves count objects every frame and compares box queries against the tree, the grid and a
+		// rescan of every entity's bounds
+		static void benchmark(size_t count);
+
+	private:
+		void sync(Entity entity, BoundsComponent& bounds, const Aabb& worldBounds);
+
+		FveAabbTree tree{ 0.1f };
+		FveSpatialGrid grid;
+		std::vector<Entity> unindexed;
+		bool modelBoundsChanged = false;
+	};
+
+}
@@ -1,5 +1,7 @@
 #include "textured_render_system.hpp"
 
+#include "fve_assets.hpp"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -12,18 +14,23 @@
 
 namespace fve {
 
+	// the fragment shader still declares it, so the range stays in the layout
 	struct SimplePushConstantData {
 		alignas(16) glm::mat4 modelMatrix{ 1.0f };
 		alignas(16) glm::mat4 normalMatrix{ 1.0f };
 	};
 
-	TexturedRenderSystem::TexturedRenderSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device{ device } {
+	TexturedRenderSystem::TexturedRenderSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, FveRenderQueue& renderQueue, GpuCullingSystem* gpuCulling)
+		: device{ device }, renderQueue{ renderQueue }, gpuCulling{ gpuCulling } {
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
 
 	TexturedRenderSystem::~TexturedRenderSystem() {
 		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+		if (indirectPipelineLayout != VK_NULL_HANDLE) {
+			vkDestroyPipelineLayout(device.device(), indirectPipelineLayout, nullptr);
+		}
 	}
 
 	void TexturedRenderSystem::createPipelineLayout(VkDescriptorSetLayout descriptorSetLayout) {
@@ -43,6 +50,16 @@ namespace fve {
 		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
+
+		if (gpuCulling == nullptr) return;
+
+		// same push range so the fragment shader is shared, the object table goes in set 1
+		descriptorSetLayouts.push_back(gpuCulling->getObjectSetLayout());
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &indirectPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
 	}
 
 	void TexturedRenderSystem::createPipeline(VkRenderPass renderPass) {
@@ -53,53 +70,60 @@ namespace fve {
 		FvePipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
+		FveInstanceBuffer::addVertexInput(pipelineConfig);
 		pipeline = std::make_unique<FvePipeline>(
 			device,
 			"shaders/textured_shader.vert.spv",
 			"shaders/textured_shader.frag.spv",
 			pipelineConfig,
 			"texturedmaterial");
+
+		if (gpuCulling == nullptr) return;
+
+		// the indirect shaders read the object table rather than instance attributes
+		FvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.pipelineLayout = indirectPipelineLayout;
+		indirectPipeline = std::make_unique<FvePipeline>(
+			device,
+			"shaders/textured_shader_indirect.vert.spv",
+			"shaders/textured_shader.frag.spv",
+			pipelineConfig,
+			"texturedmaterial_indirect");
+
+		// models on the base material follow it when they are culled on the GPU
+		indirectMaterial = fveAssets.getMaterial("texturedmaterial_indirect");
+		fveAssets.getMaterial("texturedmaterial")->indirect = indirectMaterial;
 	}
 
 	void TexturedRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-		pipeline->bind(frameInfo.commandBuffer);
+		if (gpuCulling != nullptr) {
+			// a handful of indirect draws, one secondary is enough
+			FrameInfo passInfo = frameInfo;
+			passInfo.commandBuffer = frameInfo.commands.begin(frameInfo.commands.reserve(1));
+			if (passInfo.commandBuffer == VK_NULL_HANDLE) return;
+			renderIndirect(passInfo);
+			frameInfo.commands.end(passInfo.commandBuffer);
+			return;
+		}
 
+		// extracted and sorted by the frame graph, binds only change between runs
+		renderQueue.record(frameInfo, RenderLayer::Textured);
+	}
+
+	void TexturedRenderSystem::renderIndirect(FrameInfo& frameInfo) {
+		// the batches bind their material's pipeline
 		vkCmdBindDescriptorSets(frameInfo.commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
+			indirectPipelineLayout,
 			0,
 			1,
 			&frameInfo.texturedDescriptorSet,
 			0,
 			nullptr);
 
-		// track mesh/material usage
-		Mesh* lastMesh = nullptr;
-		Material* lastMaterial = nullptr;
-
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-
-			// skip objects with no model or no texture
-			if (obj.model == nullptr) continue;
-			if (obj.texture == nullptr) continue;
-
-			//only bind the pipeline if it doesn't match with the already bound one
-			if (&obj.model->getMaterial() != lastMaterial) {
-
-				vkCmdBindPipeline(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.model->getMaterial().pipeline);
-				lastMaterial = &obj.model->getMaterial();
-			}
-
-
-			SimplePushConstantData push{};
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
-		}
+		// culled and compacted on the GPU, one draw per mesh and material whatever the object count
+		gpuCulling->drawBatches(frameInfo, GpuDrawList::Textured, *indirectMaterial);
 	}
 
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "fve_device.hpp"
-#include "fve_game_object.hpp"
+#include "fve_components.hpp"
 #include "fve_pipeline.hpp"
 #include "fve_camera.hpp"
 #include "fve_frame_info.hpp"
+#include "fve_render_queue.hpp"
+#include "gpu_culling_system.hpp"
 
 #include <memory>
 #include <vector>
@@ -14,7 +16,9 @@ namespace fve {
 	class TexturedRenderSystem {
 	public:
 
-		TexturedRenderSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// records its layer of the render queue; with gpuCulling the objects are drawn from its
+		// indirect batches instead
+		TexturedRenderSystem(FveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout, FveRenderQueue& renderQueue, GpuCullingSystem* gpuCulling = nullptr);
 		~TexturedRenderSystem();
 
 		void renderGameObjects(FrameInfo& frameInfo);
@@ -22,8 +26,16 @@ namespace fve {
 	private:
 		FveDevice& device;
 
+		// registers the material the render queue binds it through
 		std::unique_ptr<FvePipeline> pipeline;
 		VkPipelineLayout pipelineLayout;
+		FveRenderQueue& renderQueue;
+
+		GpuCullingSystem* gpuCulling;
+		std::unique_ptr<FvePipeline> indirectPipeline;
+		VkPipelineLayout indirectPipelineLayout = VK_NULL_HANDLE;
+		// what indirectPipeline registered, drawn with when a model's material has no indirect variant
+		Material* indirectMaterial = nullptr;
 
 
 		TexturedRenderSystem(const TexturedRenderSystem&) = delete;
@@ -31,6 +43,7 @@ namespace fve {
 
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+		void renderIndirect(FrameInfo& frameInfo);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include "transform_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+namespace fve {
+
+	// below these a chunk or level runs inline, splitting would cost more than it saves
+	static constexpr size_t ROOT_GRAIN = 2048;
+	static constexpr size_t CHILD_GRAIN = 256;
+	static constexpr size_t KERNEL_BLOCK = 256;
+
+	// the kernel reads and writes the components in place through float strides
+	static_assert(sizeof(TransformComponent) % sizeof(float) == 0, "TransformComponent must be a whole number of floats");
+	static_assert(sizeof(WorldTransformComponent) % sizeof(float) == 0, "WorldTransformComponent must be a whole number of floats");
+
+	static TransformKernelInput kernelInput(const TransformComponent* transforms) {
+		return TransformKernelInput{ &transforms->translation.x, &transforms->rotation.x, &transforms->scale.x, sizeof(TransformComponent) / sizeof(float) };
+	}
+
+	static TransformKernelOutput kernelOutput(WorldTransformComponent* worldTransforms) {
+		return TransformKernelOutput{ &worldTransforms->matrix[0][0], &worldTransforms->normalMatrix[0][0], sizeof(WorldTransformComponent) / sizeof(float) };
+	}
+
+	static std::vector<TransformComponent> randomTransforms(size_t count) {
+		std::mt19937 rng{ 1234 };
+		std::uniform_real_distribution<float> angle{ -10.0f, 10.0f };
+		std::uniform_real_distribution<float> scale{ 0.1f, 5.0f };
+		std::uniform_real_distribution<float> offset{ -100.0f, 100.0f };
+
+		std::vector<TransformComponent> transforms(count);
+		for (auto& transform : transforms) {
+			transform.translation = { offset(rng), offset(rng), offset(rng) };
+			transform.rotation = { angle(rng), angle(rng), angle(rng) };
+			transform.scale = { scale(rng), scale(rng), scale(rng) };
+		}
+		return transforms;
+	}
+
+	TransformSystem::TransformSystem() : kernel{ getTransformKernel() } {
+		std::cout << "Transform kernel: " << simdLevelName(detectSimdLevel()) << std::endl;
+#ifndef NDEBUG
+		assert(validateKernels() && "SIMD transform kernel does not match TransformComponent::mat4()");
+#endif
+	}
+
+	bool TransformSystem::validateKernels() {
+
+		const size_t count = 257;
+		std::vector<TransformComponent> transforms = randomTransforms(count);
+		std::vector<uint32_t> rows(count);
+		for (uint32_t i = 0; i < count; i++) rows[i] = i;
+
+		bool valid = true;
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse4, SimdLevel::Avx2 }) {
+			TransformKernelFn levelKernel = getTransformKernel(level);
+			if (levelKernel == nullptr) continue;
+
+			std::vector<WorldTransformComponent> results(count);
+			levelKernel(kernelInput(transforms.data()), rows.data(), count, kernelOutput(results.data()));
+
+			float maxError = 0.0f;
+			for (size_t i = 0; i < count; i++) {
+				glm::mat4 expectedMatrix = transforms[i].mat4();
+				glm::mat4 expectedNormal = glm::mat4(transforms[i].normalMatrix());
+				for (int column = 0; column < 4; column++) {
+					for (int row = 0; row < 4; row++) {
+						// relative to the magnitude so large translations don't dominate
+						float matrixError = std::abs(results[i].matrix[column][row] - expectedMatrix[column][row]) / (1.0f + std::abs(expectedMatrix[column][row]));
+						float normalError = std::abs(results[i].normalMatrix[column][row] - expectedNormal[column][row]) / (1.0f + std::abs(expectedNormal[column][row]));
+						maxError = std::max(maxError, std::max(matrixError, normalError));
+					}
+				}
+			}
+
+			if (maxError > 1e-5f) {
+				std::cerr << simdLevelName(level) << " transform kernel is off by " << maxError << std::endl;
+				valid = false;
+			}
+		}
+
+		return valid;
+
+	}
+
+	void TransformSystem::benchmark(size_t count) {
+
+		std::vector<TransformComponent> transforms = randomTransforms(count);
+		std::vector<WorldTransformComponent> results(count);
+		std::vector<uint32_t> rows(count);
+		for (uint32_t i = 0; i < count; i++) rows[i] = i;
+
+		const int iterations = 20;
+		auto report = [count, iterations](const char* name, std::chrono::steady_clock::duration elapsed) {
+			double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / (double(count) * iterations);
+			std::cout << "  " << name << ": " << nanoseconds << " ns/transform" << std::endl;
+		};
+
+		std::cout << "Transform benchmark, " << count << " transforms x " << iterations << " iterations" << std::endl;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int iteration = 0; iteration < iterations; iteration++) {
+			for (size_t i = 0; i < count; i++) {
+				results[i].matrix = transforms[i].mat4();
+				results[i].normalMatrix = transforms[i].normalMatrix();
+			}
+		}
+		report("glm reference", std::chrono::steady_clock::now() - start);
+
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse4, SimdLevel::Avx2 }) {
+			TransformKernelFn levelKernel = getTransformKernel(level);
+			if (levelKernel == nullptr) {
+				std::cout << "  " << simdLevelName(level) << ": not supported" << std::endl;
+				continue;
+			}
+
+			start = std::chrono::steady_clock::now();
+			for (int iteration = 0; iteration < iterations; iteration++) {
+				levelKernel(kernelInput(transforms.data()), rows.data(), count, kernelOutput(results.data()));
+			}
+			report(simdLevelName(level), std::chrono::steady_clock::now() - start);
+		}
+
+	}
+
+	void TransformSystem::setParent(FveWorld& world, Entity child, Entity parent) {
+
+		assert(child != parent && "An entity cannot be its own parent");
+
+#ifndef NDEBUG
+		// walk up from the new parent to make sure we aren't creating a cycle
+		for (Entity ancestor = parent; ancestor != NULL_ENTITY; ) {
+			assert(ancestor != child && "Parenting would create a cycle");
+			ParentComponent* up = world.tryGetComponent<ParentComponent>(ancestor);
+			ancestor = up != nullptr ? up->parent : NULL_ENTITY;
+		}
+#endif
+
+		if (ParentComponent* existing = world.tryGetComponent<ParentComponent>(child)) {
+			existing->parent = parent;
+		}
+		else {
+			world.addComponent<ParentComponent>(child, parent);
+		}
+
+		world.getComponent<TransformComponent>(child).markDirty();
+		levelsDirty = true;
+
+	}
+
+	void TransformSystem::clearParent(FveWorld& world, Entity child) {
+
+		if (!world.hasComponent<ParentComponent>(child)) return;
+
+		world.removeComponent<ParentComponent>(child);
+		world.getComponent<TransformComponent>(child).markDirty();
+		levelsDirty = true;
+
+	}
+
+	void TransformSystem::rebuildLevels(FveWorld& world) {
+
+		levels.clear();
+		orphans.clear();
+		hierarchyVersion = world.structureVersion<TransformComponent, WorldTransformComponent, ParentComponent>();
+
+		std::unordered_map<Entity, std::vector<Entity>> children;
+		std::vector<Entity> current;
+
+		auto query = world.query<TransformComponent, WorldTransformComponent, ParentComponent>();
+		query.each([&](Entity entity, TransformComponent&, WorldTransformComponent&, ParentComponent& parent) {
+			// a child whose parent is gone or has no transform is treated as a root
+			if (!world.hasComponent<WorldTransformComponent>(parent.parent) || !world.hasComponent<TransformComponent>(parent.parent)) {
+				orphans.push_back(entity);
+				return;
+			}
+
+			if (world.hasComponent<ParentComponent>(parent.parent)) {
+				children[parent.parent].push_back(entity);
+			}
+			else {
+				current.push_back(entity);
+			}
+		});
+
+		// children of orphans start at the top level as well
+		for (Entity orphan : orphans) {
+			auto it = children.find(orphan);
+			if (it != children.end()) current.insert(current.end(), it->second.begin(), it->second.end());
+		}
+
+		// breadth first from the direct children of roots
+		while (!current.empty()) {
+			std::vector<Entity> next;
+			for (Entity entity : current) {
+				auto it = children.find(entity);
+				if (it == children.end()) continue;
+				next.insert(next.end(), it->second.begin(), it->second.end());
+			}
+			levels.push_back(std::move(current));
+			current = std::move(next);
+		}
+
+		levelsDirty = false;
+
+	}
+
+	// the local transform to build matrices from; true if they need rebuilding even though the
+	// transform is clean, because it is mid-blend or has just finished blending
+	static bool interpolate(InterpolationComponent& interpolation, const TransformComponent& current, float alpha, TransformComponent& local) {
+		const TransformComponent& previous = interpolation.previous;
+		bool moving = previous.translation != current.translation || previous.rotation != current.rotation || previous.scale != current.scale;
+		bool rebuild = moving || interpolation.blended;
+
+		local = moving ? interpolateTransform(previous, current, alpha) : current;
+		interpolation.blended = moving && alpha < 1.0f;
+		return rebuild;
+	}
+
+	void TransformSystem::updateLocal(TransformComponent& transform, WorldTransformComponent& worldTransform, InterpolationComponent* interpolation) {
+
+		TransformComponent local = transform;
+		bool rebuild = transform.dirty;
+		if (interpolation != nullptr && interpolate(*interpolation, transform, alpha, local)) rebuild = true;
+		if (!rebuild) return;
+
+		worldTransform.matrix = local.mat4();
+		worldTransform.normalMatrix = local.normalMatrix();
+		worldTransform.changedFrame = frame;
+		transform.dirty = false;
+
+	}
+
+	void TransformSystem::beginStep(FveWorld& world) {
+
+		auto interpolated = world.query<TransformComponent, InterpolationComponent>();
+		interpolated.each([](Entity, TransformComponent& transform, InterpolationComponent& interpolation) {
+			interpolation.previous = transform;
+		});
+
+	}
+
+	void TransformSystem::update(FveWorld& world, float alpha) {
+
+		frame++;
+		this->alpha = alpha;
+
+		if (levelsDirty || world.structureVersion<TransformComponent, WorldTransformComponent, ParentComponent>() != hierarchyVersion) {
+			rebuildLevels(world);
+		}
+
+		auto roots = world.query<TransformComponent, WorldTransformComponent>(Exclude<ParentComponent, InterpolationComponent>{});
+		roots.eachChunk([&](size_t count, const Entity*, TransformComponent* transforms, WorldTransformComponent* worldTransforms) {
+			fveJobs.parallelFor(0, count, ROOT_GRAIN, [&](size_t begin, size_t end) {
+				// gather dirty rows a block at a time so every job works out of its own stack
+				uint32_t dirtyRows[KERNEL_BLOCK];
+				for (size_t block = begin; block < end; block += KERNEL_BLOCK) {
+					size_t blockEnd = std::min(end, block + KERNEL_BLOCK);
+					size_t dirtyCount = 0;
+					for (size_t row = block; row < blockEnd; row++) {
+						if (transforms[row].dirty) dirtyRows[dirtyCount++] = static_cast<uint32_t>(row);
+					}
+					if (dirtyCount == 0) continue;
+
+					kernel(kernelInput(transforms), dirtyRows, dirtyCount, kernelOutput(worldTransforms));
+
+					for (size_t i = 0; i < dirtyCount; i++) {
+						worldTransforms[dirtyRows[i]].changedFrame = frame;
+						transforms[dirtyRows[i]].dirty = false;
+					}
+				}
+			});
+		});
+
+		// blended roots go through the scalar path, they rarely come in numbers worth batching
+		auto interpolatedRoots = world.query<TransformComponent, WorldTransformComponent, InterpolationComponent>(Exclude<ParentComponent>{});
+		interpolatedRoots.eachChunk([&](size_t count, const Entity*, TransformComponent* transforms, WorldTransformComponent* worldTransforms, InterpolationComponent* interpolations) {
+			fveJobs.parallelFor(0, count, CHILD_GRAIN, [&](size_t begin, size_t end) {
+				for (size_t row = begin; row < end; row++) {
+					updateLocal(transforms[row], worldTransforms[row], &interpolations[row]);
+				}
+			});
+		});
+
+		fveJobs.parallelFor(0, orphans.size(), CHILD_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				Entity orphan = orphans[i];
+				updateLocal(world.getComponent<TransformComponent>(orphan), world.getComponent<WorldTransformComponent>(orphan), world.tryGetComponent<InterpolationComponent>(orphan));
+			}
+		});
+
+		// entities of a level are independent, their parents were all finished by the level before
+		std::atomic<bool> parentLost{ false };
+		for (auto& level : levels) {
+			fveJobs.parallelFor(0, level.size(), CHILD_GRAIN, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					Entity entity = level[i];
+					TransformComponent& transform = world.getComponent<TransformComponent>(entity);
+					WorldTransformComponent& worldTransform = world.getComponent<WorldTransformComponent>(entity);
+
+					InterpolationComponent* interpolation = world.tryGetComponent<InterpolationComponent>(entity);
+
+					// the parent was destroyed since the levels were built
+					const WorldTransformComponent* parent = world.tryGetComponent<WorldTransformComponent>(world.getComponent<ParentComponent>(entity).parent);
+					if (parent == nullptr) {
+						updateLocal(transform, worldTransform, interpolation);
+						parentLost.store(true, std::memory_order_relaxed);
+						continue;
+					}
+
+					TransformComponent local = transform;
+					bool blending = interpolation != nullptr && interpolate(*interpolation, transform, alpha, local);
+
+					// only follow the parent if it actually moved this frame
+					if (!transform.dirty && !blending && parent->changedFrame != frame) continue;
+
+					worldTransform.matrix = parent->matrix * local.mat4();
+
+					// (P * L)^-T = P^-T * L^-T, so the normal matrices compose the same way
+					worldTransform.normalMatrix = glm::mat4(glm::mat3(parent->normalMatrix) * local.normalMatrix());
+					worldTransform.changedFrame = frame;
+					transform.dirty = false;
+				}
+			});
+		}
+		if (parentLost.load()) levelsDirty = true;
+
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "fve_components.hpp"
+#include "fve_transform_kernel.hpp"
+#include "fve_job_system.hpp"
+
+#include <vector>
+
+namespace fve {
+
+	// Rebuilds cached world and normal matrices for entities whose transform changed. Roots are
+	// handled straight from their archetype arrays, children in breadth-first order so every
+	// parent is final before its children read it. Untouched entities cost a flag test. Dirty roots
+	// go through the batched SIMD kernel, children stay scalar since each one needs its parent.
+	// Large root chunks and levels are split over fveJobs. Interpolated entities are rebuilt from a
+	// blend of their last two simulation steps on every update while they move.
+	class TransformSystem {
+	public:
+
+		TransformSystem();
+
+		TransformSystem(const TransformSystem&) = delete;
+		TransformSystem& operator=(const TransformSystem&) = delete;
+
+		// snapshots interpolated transforms, call before every fixed simulation step
+		void beginStep(FveWorld& world);
+
+		// alpha blends entities with an InterpolationComponent between their last two steps
+		void update(FveWorld& world, float alpha = 1.0f);
+
+		void setParent(FveWorld& world, Entity child, Entity parent);
+		void clearParent(FveWorld& world, Entity child);
+
+		// checks every kernel this CPU can run against TransformComponent::mat4()/normalMatrix()
+		static bool validateKernels();
+
+		// prints per-transform timings of the glm reference and every available kernel
+		static void benchmark(size_t count);
+
+	private:
+		void rebuildLevels(FveWorld& world);
+		void updateLocal(TransformComponent& transform, WorldTransformComponent& worldTransform, InterpolationComponent* interpolation);
+
+		uint64_t frame = 0;
+		float alpha = 1.0f;
+
+		// batched SIMD kernel for roots, picked for this CPU
+		TransformKernelFn kernel;
+
+		// children grouped by depth, level 0 holds the direct children of roots
+		std::vector<std::vector<Entity>> levels;
+
+		// children whose parent has no world transform (or is gone), updated like roots
+		std::vector<Entity> orphans;
+
+		// set by setParent/clearParent; everything else that reshapes the hierarchy (entities created,
+		// destroyed or edited elsewhere) shows up as a new world structure version
+		bool levelsDirty = true;
+		uint64_t hierarchyVersion = 0;
+	};
+
+}